@@ -1,24 +1,23 @@
-v1 = vec.new(1, 0)
-v2 = vec.new(0, 1)
+v1 = vec2(1, 0)
+v2 = vec2(0, 1)
 
--- observe usage of getter/setter
+-- vec2 is a value type, like numbers: fields are read
+-- straight out of the value, no getter function involved
 print("v1:", v1.x, v1.y)
 print("v2:", v2.x, v2.y)
--- gets 0, 1 by doing lookup into getter function
 print("changing v2...")
-v2.x = 3
-v2[1] = 5
--- can use [0] [1] like popular
--- C++-style math vector classes
+-- values are immutable, so build a new one instead
+-- of assigning to a field
+v2 = vec2(3, 5)
 print("v1:", v1.x, v1.y)
 print("v2:", v2.x, v2.y)
--- both obj.name and obj["name"]
--- are equivalent lookup methods
--- and both will trigger the getter
--- if it can't find 'name' on the object
+-- obj.name and obj["name"] are the same lookup
 assert(v1["x"] == v1.x)
-assert(v1[0] == v1.x)
-assert(v1["x"] == v1[0])
 assert(v1["y"] == v1.y)
-assert(v1[1] == v1.y)
-assert(v1["y"] == v1[1])
+
+-- arithmetic works componentwise, '*' and '/' also
+-- take a number on either side, none of it allocates
+local v3 = (v1 + v2) * 2 - v2 / 2
+assert(v3 == vec2(6.5, 7.5))
+assert(-v1 == vec2(-1, 0))
+print("v3:", v3)
@@ -0,0 +1,90 @@
+/*
+** Runs the benchmark scripts given on the command line, e.g.
+**   ./bench vm_calls.lua vm_loops.lua
+**   ./bench -n 9 strings.lua
+** Each script runs several times (5 unless -n says otherwise), each time
+** in a fresh state with the standard libraries, and the best and median
+** CPU times are reported. A script may return a string with figures of
+** its own (e.g. throughput); the one from the fastest run is printed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+#define MAXRUNS		32
+
+
+static int cmptime (const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+
+/* time of one run, negative on error */
+static double runonce (const char *name, char *extra, size_t sz) {
+  clock_t start;
+  double t;
+  lua_State *L = luaL_newstate();
+  if (L == NULL) {
+    fprintf(stderr, "%s: cannot create state\n", name);
+    return -1;
+  }
+  luaL_openlibs(L);
+  start = clock();
+  if (luaL_dofile(L, name) != LUA_OK) {
+    fprintf(stderr, "%s: %s\n", name, lua_tostring(L, -1));
+    lua_close(L);
+    return -1;
+  }
+  t = (double)(clock() - start) / CLOCKS_PER_SEC;
+  extra[0] = '\0';
+  if (lua_type(L, -1) == LUA_TSTRING)
+    snprintf(extra, sz, "  %s", lua_tostring(L, -1));
+  lua_close(L);
+  return t;
+}
+
+
+static int runscript (const char *name, int runs) {
+  double times[MAXRUNS];
+  char extra[256], best[256];
+  double mintime = 0;
+  int i;
+  best[0] = '\0';
+  for (i = 0; i < runs; i++) {
+    if ((times[i] = runonce(name, extra, sizeof(extra))) < 0)
+      return 0;
+    if (i == 0 || times[i] < mintime) {
+      mintime = times[i];
+      strcpy(best, extra);
+    }
+  }
+  qsort(times, runs, sizeof(double), cmptime);
+  printf("%-20s best %7.3f s  median %7.3f s%s\n", name, times[0],
+         times[runs / 2], best);
+  fflush(stdout);
+  return 1;
+}
+
+
+int main (int argc, char **argv) {
+  int i = 1, runs = 5, failed = 0;
+  if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+    runs = atoi(argv[2]);
+    if (runs < 1 || runs > MAXRUNS) {
+      fprintf(stderr, "-n: expected 1 to %d runs\n", MAXRUNS);
+      return 1;
+    }
+    i = 3;
+  }
+  for (; i < argc; i++)
+    failed += !runscript(argv[i], runs);
+  return failed != 0;
+}
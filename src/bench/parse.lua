@@ -0,0 +1,68 @@
+-- parse throughput (lexer and parser, no execution) in MB/s, over three
+-- generated sources: game code with comments, a level-data table
+-- literal, and a mix of escapes, long brackets and odd whitespace
+
+local out
+local function w (s) out[#out + 1] = s end
+
+out = {}
+w("local M = {}\n")
+for i = 1, 8000 do
+  w(string.format([[
+--[==[ function %d
+  does things ]==]
+function M.update_entity_%d(self, dt)
+    local velocity = self.velocity
+    if velocity.x > %d then
+        self.position.x = self.position.x + velocity.x * dt -- integrate
+    else
+        self.state = "idle"
+    end
+    return self
+end
+
+]], i, i, i))
+end
+w("return M\n")
+local code = table.concat(out)
+
+out = {}
+w("return {\n")
+for i = 1, 8000 do
+  w(string.format("    { id = %d, name = \"entity_%d\", kind = 'sprite', " ..
+                  "pos = { x = %.3f, y = %.3f }, tags = { \"solid\", " ..
+                  "\"visible\" }, -- entry %d\n", i, i, i * 0.37, i * 1.91, i))
+  w(string.format("      script = [[local t = ... return t.x + %d]], " ..
+                  "scale = %g, flags = 0x%x },\n", i, i / 7, i))
+end
+w("}\n")
+local data = table.concat(out)
+
+out = {}
+w("local s = {}\n")
+for i = 1, 2000 do
+  w(string.format("s[#s+1] = 'a\\tb\\\\c\\'%d\\x41\\u{48}\\65\\z   \n   q'\n", i))
+  w(string.format("s[#s+1] = \"%s\\\"x\"\n", string.rep("p", i % 40)))
+  w(string.format("s[#s+1] = [==[\r\nline]]one]=]two\r\n\n\r%d]==]\n", i))
+  w("--[=[ c ] ]] ]=]s[#s+1] = [[]]\n--\n-- \r\n\t\v\f  s[#s+1]=_ab9ZZ or 'x'\n")
+  local v = string.rep("v", i % 30 + 1) .. "_" .. i
+  w(string.format("do local %s = %d s[#s+1] = %s end\n", v, i, v))
+  w(string.format("s[#s+1] = 0x%xp+1 + 3.5e-2 + .5 + %d.%d\n", i, i, i))
+end
+w("return s\n")
+local tricky = table.concat(out)
+out = nil
+
+local results = {}
+for _, src in ipairs{{"code", code}, {"data", data}, {"tricky", tricky}} do
+  local name, text = src[1], src[2]
+  local best = math.huge
+  for r = 1, 5 do
+    local t0 = os.clock()
+    assert(load(text, "=" .. name))
+    best = math.min(best, os.clock() - t0)
+  end
+  results[#results + 1] = string.format("%s %.0f MB/s", name,
+                                        #text / best / 1e6)
+end
+return table.concat(results, "  ")
@@ -0,0 +1,53 @@
+-- string interning: every short string made at run time (concatenation,
+-- string.sub, string.format) is hashed and looked up in the string
+-- table; long strings are hashed when first used as a key
+
+local laps = {}
+local t0 = os.clock()
+local function lap (name)
+  local t = os.clock()
+  laps[#laps + 1] = string.format("%s %.3f", name, t - t0)
+  t0 = t
+end
+
+-- new strings
+local keep = {}
+for i = 1, 1000000 do keep[i] = "entity_" .. i end
+lap("new")
+keep = nil
+collectgarbage()
+lap("collect")
+
+-- strings that already exist, 1 to 40 bytes long
+local buf = string.rep("abcdefghijklmnopqrstuvwxyz0123456789ABCD", 50)
+local n = 0
+for r = 1, 600 do
+  for i = 1, 1000 do
+    n = n + #buf:sub(i, i + i % 40)
+  end
+end
+lap("hit")
+
+-- short keys, as pushed by bindings, 2 to 10 bytes
+local names = {"position", "velocity", "x", "y", "update", "draw",
+               "transform", "id"}
+for r = 1, 1000000 do
+  local s = ("%s_"):format(names[r % 8 + 1])
+end
+lap("short")
+
+-- 6-byte keys, half of them new
+local fmt = string.format
+for r = 1, 1000000 do
+  local s = fmt("k%05d", r % 100000 + (r & 1) * r)
+end
+lap("6-byte")
+
+-- long strings used as keys
+local big = {}
+local prefix = string.rep("z", 100)
+for i = 1, 20000 do big[prefix .. i] = i end
+lap("long-keys")
+
+assert(n > 0)
+return table.concat(laps, " ")
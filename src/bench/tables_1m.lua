@@ -0,0 +1,58 @@
+-- hash parts of tables with a million keys: string keys (an asset-name
+-- map), sparse integer keys and object keys; queries go in a fixed
+-- pseudo-random order, so most of them miss the cache
+
+local N = 1000000
+
+local perm = {}
+for i = 1, N do perm[i] = i end
+local seed = 7
+for i = N, 2, -1 do
+  seed = (seed * 1103515245 + 12345) % 2147483648
+  local j = seed % i + 1
+  perm[i], perm[j] = perm[j], perm[i]
+end
+local names = {}
+for i = 1, N do names[i] = "asset/" .. i .. ".png" end
+
+local laps = {}
+local t0 = os.clock()
+local function lap (name)
+  local t = os.clock()
+  laps[#laps + 1] = string.format("%s %.3f", name, t - t0)
+  t0 = t
+end
+
+local m = {}
+for i = 1, N do m[names[i]] = i end
+lap("str-insert")
+local s = 0
+for r = 1, 3 do for i = 1, N do s = s + m[names[perm[i]]] end end
+lap("str-hit")
+local miss = 0
+for i = 1, N do
+  if m["nope" .. (i % 1000)] == nil then miss = miss + 1 end
+end
+lap("str-miss")
+
+local h = {}
+for i = 1, N do h[i * 2654435761 % 4294967296] = i end
+lap("int-insert")
+for r = 1, 3 do
+  for i = 1, N do s = s + h[perm[i] * 2654435761 % 4294967296] end
+end
+lap("int-hit")
+
+local objs, reg = {}, {}
+for i = 1, N do local o = {}; objs[i] = o; reg[o] = i end
+lap("obj-insert")
+for r = 1, 3 do for i = 1, N do s = s + reg[objs[perm[i]]] end end
+lap("obj-hit")
+
+local n = 0
+for _ in pairs(m) do n = n + 1 end
+lap("pairs")
+assert(miss == N and n == N)
+
+return table.concat(laps, " ") ..
+       string.format(" heap %d MB", collectgarbage("count") // 1024)
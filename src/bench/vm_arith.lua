@@ -0,0 +1,21 @@
+-- VM dispatch: integer, float and bitwise arithmetic, string concat and
+-- length
+
+local a, b = 0, 0
+for i = 1, 5000000 do
+  a = a + i * 3 - (i // 7) + (i % 11)
+  b = b ~ (i << 3) | (i >> 2) & 0xff
+end
+
+local x, y = 0.0, 1.0
+for i = 1, 5000000 do
+  x = x + i * 0.5
+  y = y - x / (i + 1) + 2 ^ -3
+end
+
+local t = {}
+for i = 1, 300000 do t[#t + 1] = "k" .. i end
+assert(#t == 300000)
+
+local u = 0
+for i = 1, 3000000 do u = u + -i + ~i end
@@ -0,0 +1,37 @@
+-- VM dispatch: calls and returns (Lua functions, closures, methods,
+-- varargs, tail calls)
+
+local function fib (n)
+  if n < 2 then return n end
+  return fib(n - 1) + fib(n - 2)
+end
+assert(fib(27) == 196418)
+
+local function counter ()
+  local c = 0
+  return function () c = c + 1; return c end
+end
+local inc = counter()
+for i = 1, 2000000 do inc() end
+assert(inc() == 2000001)
+
+local Point = {}
+Point.__index = Point
+function Point:move (dx, dy) self.x = self.x + dx; self.y = self.y + dy end
+local p = setmetatable({x = 0, y = 0}, Point)
+for i = 1, 2000000 do p:move(1, -1) end
+assert(p.x == 2000000)
+
+local function sum (...)
+  local s = 0
+  for i = 1, select("#", ...) do s = s + (select(i, ...)) end
+  return s
+end
+local s = 0
+for i = 1, 300000 do s = s + sum(i, 2, 3) end
+
+local function loop (n, acc)
+  if n == 0 then return acc end
+  return loop(n - 1, acc + 1)
+end
+assert(loop(2000000, 0) == 2000000)
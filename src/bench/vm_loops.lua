@@ -0,0 +1,23 @@
+-- VM dispatch: loops, comparisons, jumps and upvalue access
+
+local n = 0
+for i = 1, 10000000 do
+  if i % 3 == 0 then n = n + 1 elseif i % 5 == 0 then n = n - 1 end
+end
+
+local i, j = 0, 0
+while i < 5000000 do
+  i = i + 1
+  if i > j then j = j + 2 end
+end
+
+local k = 0
+repeat k = k + 1 until k >= 5000000
+
+local up = 0
+local function bump () for x = 1, 3000000 do up = up + x % 2 end end
+bump()
+assert(up == 1500000)
+
+local f = 0.0
+for x = 0.5, 3000000, 0.5 do f = f + x end
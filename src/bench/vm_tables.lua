@@ -0,0 +1,23 @@
+-- VM dispatch: table reads and writes (array part, short string keys,
+-- upvalue tables) and table constructors
+
+local t = {}
+for i = 1, 2000000 do t[i] = i * 2 end
+local acc = 0
+for j = 1, 5 do
+  for i = 1, #t do acc = acc + t[i] end
+end
+
+local o = {x = 1, y = 2, z = 3, w = 4}
+for i = 1, 5000000 do
+  o.x = o.y + o.z
+  o.w = o.x - i
+end
+
+local cfg = {scale = 2}
+local function scaled (v) return v * cfg.scale end
+local s = 0
+for i = 1, 3000000 do s = s + scaled(i) end
+
+local list
+for i = 1, 1000000 do list = {i, i + 1, next = list and list[1]} end
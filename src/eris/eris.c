@@ -48,7 +48,10 @@ typedef int bool;
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
+#include "lgc.h"
+#include "lgcmark.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lstring.h"
 #include "lzio.h"
@@ -117,6 +120,10 @@ static const lua_Unsigned kMaxComplexity = 10000;
 #define eris_newLclosure luaF_newLclosure
 #define eris_initupvals luaF_initupvals
 #define eris_findupval luaF_findupval
+/* lgc.h */
+#define eris_barrier luaC_barrier
+#define eris_objbarrier luaC_objbarrier
+#define eris_upvalbarrier luaC_upvalbarrier
 /* lmem.h */
 #define eris_reallocvector luaM_reallocvector
 /* lobject.h */
@@ -303,6 +310,13 @@ static const char *const kSettingMaxComplexity = "maxrec";
 static char const kHeader[] = { 'E', 'R', 'I', 'S' };
 #define HEADER_LENGTH sizeof(kHeader)
 
+/* Version of the data format, written after the header. Bump it whenever
+ * the meaning of persisted data changes, e.g. when a new type shifts the
+ * tags of the internal ones (LUA_TVEC2 did). Bit 7 is always set, as older
+ * versions wrote the size of lua_Number (or zero) in that byte. */
+#define FORMAT_VERSION_BIT 0x80
+static const uint8_t kFormatVersion = FORMAT_VERSION_BIT | 1;
+
 /* Floating point number used to check compatibility of loaded data. */
 static const lua_Number kHeaderNumber = (lua_Number)-1.234567890;
 
@@ -881,6 +895,27 @@ u_number(Info *info) {                                                 /* ... */
 
 /** ======================================================================== */
 
+static void
+p_vec2(Info *info) {                                              /* ... vec */
+  lua_Number x, y;
+  lua_tovec2(info->L, -1, &x, &y);
+  WRITE_VALUE((float)x, float32);
+  WRITE_VALUE((float)y, float32);
+}
+
+static void
+u_vec2(Info *info) {                                                   /* ... */
+  float x, y;
+  eris_checkstack(info->L, 1);
+  x = READ_VALUE(float32);
+  y = READ_VALUE(float32);
+  lua_pushvec2(info->L, x, y);                                     /* ... vec */
+
+  eris_assert(lua_type(info->L, -1) == LUA_TVEC2);
+}
+
+/** ======================================================================== */
+
 static void
 p_string(Info *info) {                                             /* ... str */
   size_t length;
@@ -1208,9 +1243,13 @@ p_proto(Info *info) {                                            /* ... proto */
   WRITE_VALUE(p->is_vararg, uint8_t);
   WRITE_VALUE(p->maxstacksize, uint8_t);
 
-  /* Write byte code. */
+  /* Write byte code, with any quickened instructions in generic form. */
   WRITE_VALUE(p->sizecode, int);
-  WRITE(p->code, p->sizecode, Instruction);
+  for (i = 0; i < p->sizecode; ++i) {
+    Instruction inst = p->code[i];
+    SET_OPCODE(inst, basicop(GET_OPCODE(inst)));
+    WRITE_VALUE(inst, Instruction);
+  }
 
   /* Write constants. */
   WRITE_VALUE(p->sizek, int);
@@ -1321,6 +1360,7 @@ u_proto(Info *info) {                                            /* ... proto */
     pushpath(info, "[%d]", i);
     unpersist(info);                                         /* ... proto obj */
     eris_setobj(info->L, &p->k[i], info->L->top - 1);
+    eris_barrier(info->L, p, &p->k[i]);
     lua_pop(info->L, 1);                                         /* ... proto */
     poppath(info);
   }
@@ -1336,12 +1376,14 @@ u_proto(Info *info) {                                            /* ... proto */
     Proto *cp;
     pushpath(info, "[%d]", i);
     p->p[i] = eris_newproto(info->L);
+    eris_objbarrier(info->L, p, p->p[i]);
     lua_pushlightuserdata(info->L, (void*)p->p[i]);              /* ... proto nproto */
     unpersist(info);                        /* ... proto nproto nproto/oproto */
     cp = (Proto*)lua_touserdata(info->L, -1);
     if (cp != p->p[i]) {                           /* ... proto nproto oproto */
       /* Just overwrite it, GC will clean this up. */
       p->p[i] = cp;
+      eris_objbarrier(info->L, p, cp);
     }
     lua_pop(info->L, 2);                                         /* ... proto */
     poppath(info);
@@ -1365,6 +1407,7 @@ u_proto(Info *info) {                                            /* ... proto */
   /* Read function source code. */
   unpersist(info);                                           /* ... proto str */
   copytstring(info->L, &p->source);
+  eris_objbarrier(info->L, p, p->source);
   lua_pop(info->L, 1);                                           /* ... proto */
 
   /* Read line information. */
@@ -1386,6 +1429,7 @@ u_proto(Info *info) {                                            /* ... proto */
     p->locvars[i].endpc = READ_VALUE(int);
     unpersist(info);                                         /* ... proto str */
     copytstring(info->L, &p->locvars[i].varname);
+    eris_objbarrier(info->L, p, p->locvars[i].varname);
     lua_pop(info->L, 1);                                         /* ... proto */
     poppath(info);
   }
@@ -1397,6 +1441,7 @@ u_proto(Info *info) {                                            /* ... proto */
     pushpath(info, "[%d]", i);
     unpersist(info);                                         /* ... proto str */
     copytstring(info->L, &p->upvalues[i].name);
+    eris_objbarrier(info->L, p, p->upvalues[i].name);
     lua_pop(info->L, 1);                                         /* ... proto */
     poppath(info);
   }
@@ -1586,6 +1631,7 @@ u_closure(Info *info) {                                                /* ... */
      * object, so we don't have to worry about it getting GCed. */
     pushpath(info, ".proto");
     cl->p = eris_newproto(info->L);
+    eris_objbarrier(info->L, cl, cl->p);
     /* Push the proto into which to unpersist as a parameter to u_proto. */
     lua_pushlightuserdata(info->L, cl->p);                /* ... lcl nproto */
     unpersist(info);                          /* ... lcl nproto nproto/oproto */
@@ -1597,6 +1643,7 @@ u_closure(Info *info) {                                                /* ... */
     if (p != cl->p) {                              /* ... lcl nproto oproto */
       /* Just overwrite the old one, GC will clean this up. */
       cl->p = p;
+      eris_objbarrier(info->L, cl, p);
     }
     lua_pop(info->L, 2);                                           /* ... lcl */
     eris_assert(cl->nupvalues == cl->p->sizeupvalues);
@@ -1645,6 +1692,7 @@ u_closure(Info *info) {                                                /* ... */
          * incorrectly initialized to nil before (or rather, not yet set). */
         lua_rawgeti(info->L, -1, UVTVAL);                  /* ... lcl tbl obj */
         eris_setobj(info->L, &(*uv)->u.value, info->L->top - 1);
+        eris_upvalbarrier(info->L, *uv);
         lua_pop(info->L, 1);                                   /* ... lcl tbl */
 
         lua_pushinteger(info->L, nup);                     /* ... lcl tbl nup */
@@ -2131,6 +2179,9 @@ persist_typed(Info *info, int type) {                 /* perms reftbl ... obj */
     case LUA_TNUMBER:
       p_number(info);
       break;
+    case LUA_TVEC2:
+      p_vec2(info);
+      break;
     case LUA_TSTRING:
       p_string(info);
       break;
@@ -2223,7 +2274,8 @@ persist(Info *info) {                                 /* perms reftbl ... obj */
    * just as much space and we can save ourselves work this way. */
   else if (type == LUA_TBOOLEAN ||
            type == LUA_TLIGHTUSERDATA ||
-           type == LUA_TNUMBER)
+           type == LUA_TNUMBER ||
+           type == LUA_TVEC2)
   {
     persist_typed(info, type);                        /* perms reftbl ... obj */
   }
@@ -2297,6 +2349,9 @@ unpersist(Info *info) {                                   /* perms reftbl ... */
         case LUA_TNUMBER:
           u_number(info);
           break;
+        case LUA_TVEC2:
+          u_vec2(info);
+          break;
         case LUA_TSTRING:
           u_string(info);
           break;
@@ -2408,6 +2463,7 @@ reader(lua_State *L, void *ud, size_t *sz) {
 static void
 p_header(Info *info) {
   WRITE_RAW(kHeader, HEADER_LENGTH);
+  WRITE_VALUE(kFormatVersion, uint8_t);
   WRITE_VALUE(sizeof(lua_Number), uint8_t);
   WRITE_VALUE(kHeaderNumber, lua_Number);
   WRITE_VALUE(sizeof(lua_Integer), uint8_t);
@@ -2418,20 +2474,23 @@ p_header(Info *info) {
 static void
 u_header(Info *info) {
   char header[HEADER_LENGTH];
-  uint8_t number_size;
+  uint8_t version, number_size;
   READ_RAW(header, HEADER_LENGTH);
   if (strncmp(kHeader, header, HEADER_LENGTH)) {
     luaL_error(info->L, "invalid data");
   }
-  number_size = READ_VALUE(uint8_t);
-  if (number_size == 0) {
-    /* Old 64-bit versions of eris wrote '\0' and then three random bytes. */
-    /* We skip them here for backwards compatibility. */
-    char throw_away[3];
-    READ_RAW(throw_away, 3);
-
-    number_size = READ_VALUE(uint8_t);
+  version = READ_VALUE(uint8_t);
+  if (!(version & FORMAT_VERSION_BIT)) {
+    /* Written before the format had a version; type tags have changed
+     * since, so the data would be misread. */
+    luaL_error(info->L, "incompatible data (from an older version of eris)");
+  }
+  if (version != kFormatVersion) {
+    luaL_error(info->L, "incompatible data format version (%d, expected %d)",
+               version & ~FORMAT_VERSION_BIT,
+               kFormatVersion & ~FORMAT_VERSION_BIT);
   }
+  number_size = READ_VALUE(uint8_t);
   if (number_size != sizeof(lua_Number)) {
     luaL_error(info->L, "incompatible floating point type");
   }
@@ -2563,6 +2622,60 @@ unchecked_unpersist(lua_State *L, lua_Reader reader, void *ud) {/* perms str? */
   lua_remove(L, REFTIDX);                               /* perms str? rootobj */
 }
 
+#if defined(LUA_USE_CONCURRENTMARK)
+/* Persisting works on internals directly, outside of the API, so with a
+ * concurrent marker the core lock has to be held throughout. Errors are
+ * caught and rethrown so that the lock is released before they leave. */
+typedef struct IOArgs {
+  lua_Writer writer;
+  lua_Reader reader;
+  void *ud;
+} IOArgs;
+
+static void
+f_persist(lua_State *L, void *ud) {
+  IOArgs *io = (IOArgs*)ud;
+  unchecked_persist(L, io->writer, io->ud);
+}
+
+static void
+f_unpersist(lua_State *L, void *ud) {
+  IOArgs *io = (IOArgs*)ud;
+  unchecked_unpersist(L, io->reader, io->ud);
+}
+
+static void
+lockedcall(lua_State *L, Pfunc f, IOArgs *io) {
+  int depth = luaC_holdcore(L);
+  int status = luaD_pcall(L, f, io, savestack(L, L->top), 0);
+  luaC_releasecore(L, depth);
+  if (status != LUA_OK) {
+    lua_error(L);
+  }
+}
+
+static void
+locked_persist(lua_State *L, lua_Writer writer, void *ud) {
+  IOArgs io;
+  io.writer = writer;
+  io.reader = NULL;
+  io.ud = ud;
+  lockedcall(L, f_persist, &io);
+}
+
+static void
+locked_unpersist(lua_State *L, lua_Reader reader, void *ud) {
+  IOArgs io;
+  io.writer = NULL;
+  io.reader = reader;
+  io.ud = ud;
+  lockedcall(L, f_unpersist, &io);
+}
+#else
+#define locked_persist unchecked_persist
+#define locked_unpersist unchecked_unpersist
+#endif
+
 /** ======================================================================== */
 
 static int
@@ -2591,7 +2704,7 @@ l_persist(lua_State *L) {                             /* perms? rootobj? ...? */
   eris_initbuffer(L, &buff);
   eris_bufflen(&buff) = 0; /* Not initialized by initbuffer... */
 
-  unchecked_persist(L, writer, &buff);                  /* perms buff rootobj */
+  locked_persist(L, writer, &buff);                     /* perms buff rootobj */
 
   /* Copy the buffer as the result string before removing it, to avoid the data
    * being garbage collected. */
@@ -2622,7 +2735,7 @@ l_unpersist(lua_State *L) {                               /* perms? str? ...? */
   eris_sizebuffer(&buff) = eris_bufflen(&buff);             /* perms str ...? */
   lua_settop(L, 2);                                              /* perms str */
 
-  unchecked_unpersist(L, reader, &buff);                 /* perms str rootobj */
+  locked_unpersist(L, reader, &buff);                    /* perms str rootobj */
 
   return 1;
 }
@@ -2729,7 +2842,7 @@ eris_dump(lua_State *L, lua_Writer writer, void *ud) {     /* perms? rootobj? */
   luaL_checkany(L, 2);                                       /* perms rootobj */
   lua_pushnil(L);                                        /* perms rootobj nil */
   lua_insert(L, -2);                                     /* perms nil rootobj */
-  unchecked_persist(L, writer, ud);                      /* perms nil rootobj */
+  locked_persist(L, writer, ud);                         /* perms nil rootobj */
   lua_remove(L, -2);                                         /* perms rootobj */
 }
 
@@ -2739,7 +2852,7 @@ eris_undump(lua_State *L, lua_Reader reader, void *ud) {            /* perms? */
     luaL_error(L, "too many arguments");
   }
   luaL_checktype(L, 1, LUA_TTABLE);                                  /* perms */
-  unchecked_unpersist(L, reader, ud);                        /* perms rootobj */
+  locked_unpersist(L, reader, ud);                           /* perms rootobj */
 }
 
 /** ======================================================================== */
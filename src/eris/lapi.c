@@ -20,6 +20,9 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "lgcfree.h"
+#include "lgcmark.h"
+#include "lgcprof.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -441,6 +444,16 @@ LUA_API const void *lua_topointer (lua_State *L, int idx) {
 }
 
 
+LUA_API int lua_tovec2 (lua_State *L, int idx, lua_Number *x, lua_Number *y) {
+  const TValue *o = index2addr(L, idx);
+  if (!ttisvec2(o))
+    return 0;
+  if (x) *x = cast_num(v2value(o)[0]);
+  if (y) *y = cast_num(v2value(o)[1]);
+  return 1;
+}
+
+
 
 /*
 ** push functions (C -> stack)
@@ -562,6 +575,11 @@ LUA_API void lua_pushboolean (lua_State *L, int b) {
 
 
 LUA_API void lua_pushlightuserdata (lua_State *L, void *p) {
+#if defined(LUA_NANBOXING)
+  if ((cast(l_nbits, cast(size_t, p)) & NBTAGMASK) != 0)
+    luaG_runerror(L, "pointer does not fit in a light userdata "
+                     "with LUA_NANBOXING");
+#endif
   lua_lock(L);
   setpvalue(L->top, p);
   api_incr_top(L);
@@ -578,15 +596,27 @@ LUA_API int lua_pushthread (lua_State *L) {
 }
 
 
+LUA_API void lua_pushvec2 (lua_State *L, lua_Number x, lua_Number y) {
+#if defined(LUA_NANBOXING)
+  (void)x; (void)y;
+  luaG_runerror(L, "vec2 values are not available with LUA_NANBOXING");
+#else
+  lua_lock(L);
+  setv2value(L->top, x, y);
+  api_incr_top(L);
+  lua_unlock(L);
+#endif
+}
+
+
 
 /*
 ** get functions (Lua -> stack)
 */
 
 
-static int auxgetstr (lua_State *L, const TValue *t, const char *k) {
+static int auxgetstr (lua_State *L, const TValue *t, TString *str) {
   const TValue *slot;
-  TString *str = luaS_new(L, k);
   if (luaV_fastget(L, t, str, slot, luaH_getstr)) {
     setobj2s(L, L->top, slot);
     api_incr_top(L);
@@ -604,7 +634,7 @@ static int auxgetstr (lua_State *L, const TValue *t, const char *k) {
 LUA_API int lua_getglobal (lua_State *L, const char *name) {
   Table *reg = hvalue(&G(L)->l_registry);
   lua_lock(L);
-  return auxgetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), name);
+  return auxgetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), luaS_new(L, name));
 }
 
 
@@ -620,7 +650,7 @@ LUA_API int lua_gettable (lua_State *L, int idx) {
 
 LUA_API int lua_getfield (lua_State *L, int idx, const char *k) {
   lua_lock(L);
-  return auxgetstr(L, index2addr(L, idx), k);
+  return auxgetstr(L, index2addr(L, idx), luaS_new(L, k));
 }
 
 
@@ -739,9 +769,8 @@ LUA_API int lua_getuservalue (lua_State *L, int idx) {
 /*
 ** t[k] = value at the top of the stack (where 'k' is a string)
 */
-static void auxsetstr (lua_State *L, const TValue *t, const char *k) {
+static void auxsetstr (lua_State *L, const TValue *t, TString *str) {
   const TValue *slot;
-  TString *str = luaS_new(L, k);
   api_checknelems(L, 1);
   if (luaV_fastset(L, t, str, slot, luaH_getstr, L->top - 1))
     L->top--;  /* pop value */
@@ -758,7 +787,7 @@ static void auxsetstr (lua_State *L, const TValue *t, const char *k) {
 LUA_API void lua_setglobal (lua_State *L, const char *name) {
   Table *reg = hvalue(&G(L)->l_registry);
   lua_lock(L);  /* unlock done in 'auxsetstr' */
-  auxsetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), name);
+  auxsetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), luaS_new(L, name));
 }
 
 
@@ -775,7 +804,7 @@ LUA_API void lua_settable (lua_State *L, int idx) {
 
 LUA_API void lua_setfield (lua_State *L, int idx, const char *k) {
   lua_lock(L);  /* unlock done in 'auxsetstr' */
-  auxsetstr(L, index2addr(L, idx), k);
+  auxsetstr(L, index2addr(L, idx), luaS_new(L, k));
 }
 
 
@@ -895,6 +924,77 @@ LUA_API void lua_setuservalue (lua_State *L, int idx) {
 }
 
 
+
+/*
+** pinned keys
+*/
+
+#define key2ts(k)	cast(TString *, (k))
+#define ts2key(ts)	cast(lua_Key, (ts))
+
+
+/*
+** Interns 'k' and records it in registry[LUA_RIDX_KEYS], so the string
+** is never collected and the handle can be kept across calls. Pinning
+** the same name twice returns the same key. Each entry maps the key to
+** itself: long names are not interned, so 'luaS_new' may return a new
+** copy, and the handle must be the string actually kept in the table.
+*/
+LUA_API lua_Key lua_internkey (lua_State *L, const char *k) {
+  Table *keys;
+  TString *str;
+  const TValue *slot;
+  lua_lock(L);
+  keys = hvalue(luaH_getint(hvalue(&G(L)->l_registry), LUA_RIDX_KEYS));
+  str = luaS_new(L, k);
+  slot = luaH_getstr(keys, str);
+  if (ttisstring(slot))  /* already pinned? */
+    str = tsvalue(slot);
+  else {
+    setsvalue2s(L, L->top, str);  /* anchor it while the table grows */
+    api_incr_top(L);
+    setobj2t(L, luaH_set(L, keys, L->top - 1), L->top - 1);
+    luaC_barrierback(L, keys, L->top - 1);
+    L->top--;
+  }
+  luaC_checkGC(L);
+  lua_unlock(L);
+  return ts2key(str);
+}
+
+
+/*
+** Key identity of the value at 'idx', or NULL when it is not a short
+** string. Short strings are interned, so the result compares equal to
+** a pinned key with the same contents; it is only valid as long as the
+** value itself is reachable.
+*/
+LUA_API lua_Key lua_tokey (lua_State *L, int idx) {
+  StkId o = index2addr(L, idx);
+  return ttisshrstring(o) ? ts2key(tsvalue(o)) : NULL;
+}
+
+
+LUA_API void lua_pushkey (lua_State *L, lua_Key k) {
+  lua_lock(L);
+  setsvalue2s(L, L->top, key2ts(k));
+  api_incr_top(L);
+  lua_unlock(L);
+}
+
+
+LUA_API int lua_getkey (lua_State *L, int idx, lua_Key k) {
+  lua_lock(L);
+  return auxgetstr(L, index2addr(L, idx), key2ts(k));
+}
+
+
+LUA_API void lua_setkey (lua_State *L, int idx, lua_Key k) {
+  lua_lock(L);  /* unlock done in 'auxsetstr' */
+  auxsetstr(L, index2addr(L, idx), key2ts(k));
+}
+
+
 /*
 ** 'load' and 'call' functions (run Lua code)
 */
@@ -1067,7 +1167,10 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
     case LUA_GCSTEP: {
       l_mem debt = 1;  /* =1 to signal that it did an actual step */
       lu_byte oldrunning = g->gcrunning;
+      lu_byte olddefer = g->gcdefer;
       g->gcrunning = 1;  /* allow GC to run */
+      g->gcdefer = 0;  /* explicit steps are never deferred */
+      luaC_unpark(g);
       if (data == 0) {
         luaE_setdebt(g, -GCSTEPSIZE);  /* to do a "small" step */
         luaC_step(L);
@@ -1078,7 +1181,9 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
         luaC_checkGC(L);
       }
       g->gcrunning = oldrunning;  /* restore previous state */
-      if (debt > 0 && g->gcstate == GCSpause)  /* end of cycle? */
+      g->gcdefer = olddefer;
+      /* end of cycle? (in generational mode, every step is one) */
+      if (debt > 0 && (g->gcstate == GCSpause || isgenerational(g)))
         res = 1;  /* signal it */
       break;
     }
@@ -1093,10 +1198,33 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       g->gcstepmul = data;
       break;
     }
+    case LUA_GCSETMINORMUL: {
+      res = g->genminormul;
+      g->genminormul = data;
+      break;
+    }
+    case LUA_GCSETMAJORMUL: {
+      res = g->genmajormul;
+      g->genmajormul = data;
+      break;
+    }
     case LUA_GCISRUNNING: {
       res = g->gcrunning;
       break;
     }
+    case LUA_GCDEFER: {  /* leave debt-triggered steps for 'lua_gcstepfor' */
+      res = g->gcdefer;
+      g->gcdefer = (data != 0);
+      if (!g->gcdefer)
+        luaC_unpark(g);  /* pay it as usual from now on */
+      break;
+    }
+    case LUA_GCGEN:  /* change collector to generational mode */
+    case LUA_GCINC: {  /* change collector to incremental mode */
+      res = isgenerational(g) ? LUA_GCGEN : LUA_GCINC;
+      luaC_changemode(L, what == LUA_GCGEN ? KGC_GEN : KGC_NORMAL);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -1105,6 +1233,103 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
 
 
 
+/*
+** Does collector work for at most 'usec' microseconds (the time is
+** checked between steps, so a single big step may overrun it). Meant
+** for idle time in a frame loop, usually together with LUA_GCDEFER.
+** Returns 1 if a collection cycle finished.
+*/
+LUA_API int lua_gcstepfor (lua_State *L, int usec) {
+  int res;
+  lua_lock(L);
+  res = luaC_stepfor(L, cast(lu_mem, (usec > 0) ? usec : 0));
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Starts or stops the concurrent marking thread (experimental). Must
+** be called from outside the core, i.e. by the host or a C function.
+** Returns 0 if concurrent marking is not available in this build or
+** the thread could not be started.
+*/
+LUA_API int lua_setconcurrentmark (lua_State *L, int on) {
+  if (on)
+    return luaC_startmarker(L);
+  luaC_stopmarker(L);
+  return 1;
+}
+
+
+/*
+** Starts or stops the background free thread (experimental). The
+** state's allocator must accept frees from another thread. Stopping
+** waits for everything handed over to be freed. Returns 0 if this
+** build has no background freeing or the thread could not be started.
+*/
+LUA_API int lua_setbackgroundfree (lua_State *L, int on) {
+  int res = 1;
+  lua_lock(L);
+  if (on)
+    res = luaC_startfreer(L);
+  else
+    luaC_stopfreer(L);
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Fills in 'st' and returns 1 if the state has a free thread.
+*/
+LUA_API int lua_getfreestats (lua_State *L, lua_FreeStats *st) {
+  int res;
+  lua_lock(L);
+  res = luaC_freerstats(L, st);
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Turns collector profiling on or off, or starts recording allocation
+** sites ('what' is one of LUA_GCPROF*). Returns 0 on failure.
+*/
+LUA_API int lua_gcprofile (lua_State *L, int what) {
+  int res;
+  lua_lock(L);
+  res = luaC_setprofile(L, what);
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Fills in 'p' and returns 1 if profiling is on. Times are in seconds.
+*/
+LUA_API int lua_getgcprofile (lua_State *L, lua_GCProfile *p) {
+  int res;
+  lua_lock(L);
+  res = luaC_getprofile(L, p);
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Counts live objects by type into 'c'. When allocation sites are
+** being recorded, 'f' (if not NULL) is also called for each site; it
+** must not call back into the state.
+*/
+LUA_API void lua_heapcensus (lua_State *L, lua_HeapCensus *c,
+                             lua_CensusSite f, void *ud) {
+  lua_lock(L);
+  luaC_census(L, c, f, ud);
+  lua_unlock(L);
+}
+
+
 /*
 ** miscellaneous functions
 */
@@ -1180,6 +1405,27 @@ LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud) {
 }
 
 
+/*
+** Tell 'lua_close' that the allocator releases all of the state's memory
+** in one go when the main block is freed, so objects don't need to be
+** freed individually (finalizers are still called). Refused (returning
+** 0) unless the allocator confirms it (see LUA_ALLOCBULK); with any other
+** allocator skipping the frees would leak the whole heap.
+*/
+LUA_API int lua_setbulkfree (lua_State *L, int bulk) {
+  global_State *g;
+  int res = 1;
+  lua_lock(L);
+  g = G(L);
+  if (bulk && (*g->frealloc)(g->ud, NULL, LUA_ALLOCBULK, 0) == NULL)
+    res = 0;  /* allocator frees block by block */
+  else
+    g->bulkfree = cast_byte(bulk != 0);
+  lua_unlock(L);
+  return res;
+}
+
+
 LUA_API void *lua_newuserdata (lua_State *L, size_t size) {
   Udata *u;
   lua_lock(L);
@@ -657,6 +657,38 @@ static const char *getF (lua_State *L, void *ud, size_t *size) {
 }
 
 
+typedef struct ChunkCache ChunkCache;
+
+static ChunkCache *getchunkcache (lua_State *L);
+static int loadcached (lua_State *L, ChunkCache *cc, const char *buff,
+                       size_t size, const char *name, const char *mode);
+
+
+/*
+** The cache works on whole chunks, so with it on the text file is read
+** into a string and loaded through 'loadcached'.
+*/
+static int loadfilecached (lua_State *L, ChunkCache *cc, LoadF *lf,
+                           int fnameindex, const char *mode) {
+  luaL_Buffer b;
+  size_t r, l;
+  const char *s;
+  int status;
+  luaL_buffinit(L, &b);
+  luaL_addlstring(&b, lf->buff, lf->n);
+  lf->n = 0;
+  do {
+    r = fread(luaL_prepbuffer(&b), 1, LUAL_BUFFERSIZE, lf->f);
+    luaL_addsize(&b, r);
+  } while (r == LUAL_BUFFERSIZE);
+  luaL_pushresult(&b);
+  s = lua_tolstring(L, -1, &l);
+  status = loadcached(L, cc, s, l, lua_tostring(L, fnameindex), mode);
+  lua_remove(L, -2);  /* remove source */
+  return status;
+}
+
+
 static int errfile (lua_State *L, const char *what, int fnameindex) {
   const char *serr = strerror(errno);
   const char *filename = lua_tostring(L, fnameindex) + 1;
@@ -703,6 +735,7 @@ static int skipcomment (LoadF *lf, int *cp) {
 LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
                                              const char *mode) {
   LoadF lf;
+  ChunkCache *cc;
   int status, readstatus;
   int c;
   int fnameindex = lua_gettop(L) + 1;  /* index of filename on the stack */
@@ -724,7 +757,13 @@ LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
   }
   if (c != EOF)
     lf.buff[lf.n++] = c;  /* 'c' is the first character of the stream */
-  status = lua_load(L, getF, &lf, lua_tostring(L, -1), mode);
+  /* entries are loaded as binary chunks, so the mode must allow both */
+  if (filename && c != LUA_SIGNATURE[0] &&
+      (mode == NULL || (strchr(mode, 't') && strchr(mode, 'b'))) &&
+      (cc = getchunkcache(L)) != NULL)
+    status = loadfilecached(L, cc, &lf, fnameindex, mode);
+  else
+    status = lua_load(L, getF, &lf, lua_tostring(L, -1), mode);
   readstatus = ferror(lf.f);
   if (filename) fclose(lf.f);  /* close file (even in case of errors) */
   if (readstatus) {
@@ -752,6 +791,244 @@ static const char *getS (lua_State *L, void *ud, size_t *size) {
 }
 
 
+/*
+** {------------------------------------------------------
+** Chunk cache: text files loaded by 'luaL_loadfilex' are kept as dumps
+** in a directory, one file per slot. Chunks loaded from strings are not
+** cached; they are often generated at run time and would only evict
+** the scripts. The slot is picked by the chunk name, so a script that
+** changes overwrites its own stale entry and the number of files stays
+** bounded. An entry is used only if the hash and size of the source
+** match the ones it was compiled from; an entry from another build of
+** Lua fails to undump and is replaced the same way.
+** -------------------------------------------------------
+*/
+
+#define CHUNKCACHE	"_CHUNKCACHE"  /* key in the registry */
+
+/* identifies cache entries; the dump has its own format checks */
+#define ENTRYMAGIC	"\x1b" "CHUNK" LUA_VERSION_MAJOR LUA_VERSION_MINOR
+
+struct ChunkCache {
+  luaL_ChunkCacheStats stats;
+  int slots;
+  char dir[1];  /* directory, variable length */
+};
+
+/* header of an entry, followed by the chunk name and then the dump */
+typedef struct CacheEntry {
+  char magic[sizeof(ENTRYMAGIC) - 1];
+  unsigned int srchash[2];
+  unsigned int dumphash[2];
+  size_t srcsize;
+  size_t namelen;
+  size_t dumpsize;
+} CacheEntry;
+
+
+static ChunkCache *getchunkcache (lua_State *L) {
+  ChunkCache *cc;
+  lua_getfield(L, LUA_REGISTRYINDEX, CHUNKCACHE);
+  cc = (ChunkCache *)lua_touserdata(L, -1);
+  lua_pop(L, 1);  /* the registry keeps it alive */
+  return cc;
+}
+
+
+#define rotl32(x,n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static unsigned int fmix32 (unsigned int h) {
+  h ^= h >> 16; h *= 0x85ebca6bu;
+  h ^= h >> 13; h *= 0xc2b2ae35u;
+  return h ^ (h >> 16);
+}
+
+
+/*
+** Two independent 32-bit hashes of the block; a false match needs both
+** to collide on a source of the same size.
+*/
+static void hashblock (const char *s, size_t l, unsigned int h[2]) {
+  unsigned int h1 = 0x9747b28cu ^ (unsigned int)l;
+  unsigned int h2 = 0x2f8b4e7du + (unsigned int)l;
+  for (; l >= 4; s += 4, l -= 4) {
+    unsigned int k;
+    memcpy(&k, s, 4);
+    h2 = rotl32(h2 + k, 17) * 0x27d4eb2fu;
+    k *= 0xcc9e2d51u; k = rotl32(k, 15); k *= 0x1b873593u;
+    h1 ^= k; h1 = rotl32(h1, 13) * 5 + 0xe6546b64u;
+  }
+  for (; l > 0; s++, l--) {
+    h1 = (h1 ^ (unsigned char)*s) * 0x01000193u;
+    h2 = (h2 + (unsigned char)*s) * 0x165667b1u;
+  }
+  h[0] = fmix32(h1);
+  h[1] = fmix32(h2);
+}
+
+
+static int samebytes (FILE *f, const char *s, size_t l) {
+  char buff[256];
+  while (l > 0) {
+    size_t n = (l < sizeof(buff)) ? l : sizeof(buff);
+    if (fread(buff, 1, n, f) != n || memcmp(buff, s, n) != 0)
+      return 0;
+    s += n; l -= n;
+  }
+  return 1;
+}
+
+
+/*
+** Looks for the entry described by 'e' in file 'path'. Returns 1 and
+** pushes the dump if found, 0 if there is no entry and -1 if the entry
+** is stale or damaged.
+*/
+static int readentry (lua_State *L, const char *path, const CacheEntry *e,
+                      const char *name) {
+  CacheEntry fe;
+  FILE *f = fopen(path, "rb");
+  int res = -1;
+  if (f == NULL) return 0;
+  if (fread(&fe, sizeof(fe), 1, f) == 1 &&
+      memcmp(fe.magic, e->magic, sizeof(fe.magic)) == 0 &&
+      fe.srchash[0] == e->srchash[0] && fe.srchash[1] == e->srchash[1] &&
+      fe.srcsize == e->srcsize && fe.namelen == e->namelen &&
+      fe.dumpsize <= LUAL_CHUNKCACHE_MAXDUMP &&
+      samebytes(f, name, e->namelen)) {
+    luaL_Buffer b;
+    char *p = luaL_buffinitsize(L, &b, fe.dumpsize);
+    if (fread(p, 1, fe.dumpsize, f) == fe.dumpsize) {
+      unsigned int h[2];
+      hashblock(p, fe.dumpsize, h);
+      if (h[0] == fe.dumphash[0] && h[1] == fe.dumphash[1])
+        res = 1;
+    }
+    luaL_pushresultsize(&b, fe.dumpsize);
+    if (res != 1) lua_pop(L, 1);
+  }
+  fclose(f);
+  return res;
+}
+
+
+static int dumpwriter (lua_State *L, const void *b, size_t size, void *B) {
+  (void)L;
+  luaL_addlstring((luaL_Buffer *)B, (const char *)b, size);
+  return 0;
+}
+
+
+/*
+** Dumps the function on the top of the stack into the entry at 'path'.
+** The entry is written under another name and renamed into place, so
+** a reader never sees half of it.
+*/
+static void writeentry (lua_State *L, ChunkCache *cc, const char *path,
+                        CacheEntry *e, const char *name) {
+  luaL_Buffer b;
+  const char *dump, *tmp;
+  FILE *f;
+  int ok;
+  luaL_buffinit(L, &b);
+  if (lua_dump(L, dumpwriter, &b, 0) != 0) {
+    luaL_pushresult(&b);
+    lua_pop(L, 1);
+    return;
+  }
+  luaL_pushresult(&b);
+  dump = lua_tolstring(L, -1, &e->dumpsize);
+  if (e->dumpsize > LUAL_CHUNKCACHE_MAXDUMP) {
+    lua_pop(L, 1);
+    return;
+  }
+  hashblock(dump, e->dumpsize, e->dumphash);
+  tmp = lua_pushfstring(L, "%s.tmp", path);
+  f = fopen(tmp, "wb");
+  if (f != NULL) {
+    ok = fwrite(e, sizeof(*e), 1, f) == 1 &&
+         fwrite(name, 1, e->namelen, f) == e->namelen &&
+         fwrite(dump, 1, e->dumpsize, f) == e->dumpsize;
+    ok = (fclose(f) == 0) && ok;
+    if (ok && rename(tmp, path) != 0) {
+      remove(path);  /* some systems do not rename over a file */
+      ok = (rename(tmp, path) == 0);
+    }
+    if (ok) cc->stats.writes++;
+    else remove(tmp);
+  }
+  lua_pop(L, 2);  /* dump and temporary name */
+}
+
+
+static int loadcached (lua_State *L, ChunkCache *cc, const char *buff,
+                       size_t size, const char *name, const char *mode) {
+  CacheEntry e;
+  LoadS ls;
+  unsigned int nh[2];
+  const char *path;
+  int pathidx, status, found;
+  memset(&e, 0, sizeof(e));  /* no garbage in padding */
+  memcpy(e.magic, ENTRYMAGIC, sizeof(e.magic));
+  e.namelen = strlen(name);
+  e.srcsize = size;
+  hashblock(name, e.namelen, nh);
+  path = lua_pushfstring(L, "%s/chunk%d.luac", cc->dir,
+                            (int)(nh[0] % (unsigned int)cc->slots));
+  pathidx = lua_gettop(L);
+  hashblock(buff, size, e.srchash);
+  found = readentry(L, path, &e, name);
+  if (found > 0) {
+    ls.s = lua_tolstring(L, -1, &ls.size);
+    status = lua_load(L, getS, &ls, name, "b");
+    if (status == LUA_OK) {
+      cc->stats.hits++;
+      lua_remove(L, pathidx);  /* path */
+      lua_remove(L, pathidx);  /* dump */
+      return LUA_OK;
+    }
+    lua_pop(L, 2);  /* error and dump; made by another build? */
+    found = -1;
+  }
+  cc->stats.misses++;
+  if (found < 0) cc->stats.stale++;
+  ls.s = buff;
+  ls.size = size;
+  status = lua_load(L, getS, &ls, name, mode);
+  if (status == LUA_OK)
+    writeentry(L, cc, path, &e, name);
+  lua_remove(L, pathidx);
+  return status;
+}
+
+
+LUALIB_API void luaL_setchunkcache (lua_State *L, const char *dir,
+                                    int slots) {
+  if (dir == NULL)
+    lua_pushnil(L);
+  else {
+    size_t l = strlen(dir);
+    ChunkCache *cc;
+    while (l > 1 && (dir[l - 1] == '/' || dir[l - 1] == '\\'))
+      l--;  /* trailing separators */
+    cc = (ChunkCache *)lua_newuserdata(L, sizeof(ChunkCache) + l);
+    memset(&cc->stats, 0, sizeof(cc->stats));
+    cc->slots = (slots > 0) ? slots : LUAL_CHUNKCACHE_SLOTS;
+    memcpy(cc->dir, dir, l);
+    cc->dir[l] = '\0';
+  }
+  lua_setfield(L, LUA_REGISTRYINDEX, CHUNKCACHE);
+}
+
+
+LUALIB_API const luaL_ChunkCacheStats *luaL_chunkcachestats (lua_State *L) {
+  ChunkCache *cc = getchunkcache(L);
+  return (cc != NULL) ? &cc->stats : NULL;
+}
+
+/* }------------------------------------------------------ */
+
+
 LUALIB_API int luaL_loadbufferx (lua_State *L, const char *buff, size_t size,
                                  const char *name, const char *mode) {
   LoadS ls;
@@ -830,6 +1107,13 @@ LUALIB_API const char *luaL_tolstring (lua_State *L, int idx, size_t *len) {
       case LUA_TNIL:
         lua_pushliteral(L, "nil");
         break;
+      case LUA_TVEC2: {
+        lua_Number x, y;
+        lua_tovec2(L, idx, &x, &y);
+        lua_pushfstring(L, "vec2(%f, %f)", (LUAI_UACNUMBER)x,
+                                           (LUAI_UACNUMBER)y);
+        break;
+      }
       default: {
         int tt = luaL_getmetafield(L, idx, "__name");  /* try name */
         const char *kind = (tt == LUA_TSTRING) ? lua_tostring(L, -1) :
@@ -1016,6 +1300,499 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
 }
 
 
+/*
+** {======================================================
+** Size-class pool allocator
+** =======================================================
+*/
+
+/*
+** Small blocks (up to LUAL_POOL_MAXSMALL bytes) are served from slabs
+** owned by the pool, one free list per size class. Nothing is ever
+** given back to the system until the pool is freed, but freed blocks
+** are re-used by the next allocation of the same class, which is the
+** common pattern for the strings, tables and closures Lua churns
+** through. Larger blocks go straight to realloc/free.
+**
+** Lua always tells the allocator the size of the block being freed or
+** resized ('osize'), so blocks carry no header: the size class is
+** recovered from 'osize' alone.
+*/
+
+
+/* bytes of slab memory requested from the system at a time */
+#define SLABSIZE	(16 * 1024)
+
+/* every class is a multiple of this, which keeps blocks aligned */
+#define CLASSSTEP	(LUAL_POOL_MAXSMALL / LUAL_POOL_NCLASSES)
+
+#define sizeclass(s)	(((s) - 1) / CLASSSTEP)
+#define classsize(c)	(((c) + 1) * CLASSSTEP)
+
+
+typedef union Slab {
+  union Slab *next;  /* slabs owned by the pool, for 'luaL_freepool' */
+  double d; void *p; long l;  /* ensure blocks after the header are aligned */
+  char pad[CLASSSTEP];
+} Slab;
+
+
+typedef struct FreeBlock {
+  struct FreeBlock *next;
+} FreeBlock;
+
+
+struct luaL_Pool {
+  FreeBlock *freeblocks[LUAL_POOL_NCLASSES];
+  Slab *slabs;
+  int ownedbystate;  /* free the pool once the state's last block is freed */
+  size_t adopted;  /* system blocks kept by shrinks, see 'keepblock' */
+  luaL_PoolStats stats;
+};
+
+
+/*
+** Carve a new slab into blocks of class 'c'. Returns 0 if the system
+** allocator fails.
+*/
+static int newslab (luaL_Pool *p, int c) {
+  size_t bsize = classsize(c);
+  size_t n = (SLABSIZE - sizeof(Slab)) / bsize;
+  char *mem;
+  Slab *s = (Slab *)malloc(SLABSIZE);
+  size_t i;
+  if (s == NULL) return 0;
+  s->next = p->slabs;
+  p->slabs = s;
+  mem = (char *)(s + 1);
+  for (i = 0; i < n; i++) {
+    FreeBlock *b = (FreeBlock *)(mem + i * bsize);
+    b->next = p->freeblocks[c];
+    p->freeblocks[c] = b;
+  }
+  p->stats.reserved += SLABSIZE;
+  p->stats.classes[c].slabs++;
+  return 1;
+}
+
+
+static void *smallalloc (luaL_Pool *p, size_t size) {
+  int c = (int)sizeclass(size);
+  FreeBlock *b;
+  if (p->freeblocks[c] == NULL && !newslab(p, c))
+    return NULL;
+  b = p->freeblocks[c];
+  p->freeblocks[c] = b->next;
+  p->stats.classes[c].live++;
+  p->stats.classes[c].allocs++;
+  return b;
+}
+
+
+static void smallfree (luaL_Pool *p, void *block, size_t size) {
+  int c = (int)sizeclass(size);
+  FreeBlock *b = (FreeBlock *)block;
+  b->next = p->freeblocks[c];
+  p->freeblocks[c] = b;
+  p->stats.classes[c].live--;
+}
+
+
+static void updatelive (luaL_Pool *p, size_t osize, size_t nsize) {
+  p->stats.live = p->stats.live - osize + nsize;
+  if (p->stats.live > p->stats.peak)
+    p->stats.peak = p->stats.live;
+}
+
+
+static void *largerealloc (luaL_Pool *p, void *ptr, size_t osize,
+                                                    size_t nsize) {
+  void *nb = realloc(ptr, nsize);
+  if (nb == NULL) return NULL;
+  if (ptr == NULL) {
+    p->stats.large_count++;
+    p->stats.large_allocs++;
+  }
+  p->stats.large_live = p->stats.large_live - osize + nsize;
+  return nb;
+}
+
+
+/*
+** A shrink that moves the block to a smaller class (or from the system
+** allocator into the pool) needs a new block, but Lua does not expect
+** a shrink to fail. When none can be had, 'ptr' stays where it is and
+** is accounted for as a block of its new class; it is big enough for
+** it, and will go to that class's free list when freed. A block taken
+** over from the system allocator this way lives outside any slab, so
+** 'releasepool' has to look for it.
+*/
+static void keepblock (luaL_Pool *p, size_t osize, size_t nsize) {
+  if (osize <= LUAL_POOL_MAXSMALL)
+    p->stats.classes[sizeclass(osize)].live--;
+  else {
+    p->stats.large_count--;
+    p->stats.large_live -= osize;
+    p->stats.reserved += osize;
+    p->adopted++;
+  }
+  p->stats.classes[sizeclass(nsize)].live++;
+}
+
+
+static int inslab (luaL_Pool *p, void *block) {
+  Slab *s;
+  for (s = p->slabs; s != NULL; s = s->next) {
+    if ((char *)block >= (char *)s && (char *)block < (char *)s + SLABSIZE)
+      return 1;
+  }
+  return 0;
+}
+
+
+/*
+** Free blocks taken over by 'keepblock', which by now sit in the free
+** lists (they are only looked for when there are any, as the search
+** is slow).
+*/
+static void freeadopted (luaL_Pool *p) {
+  int c;
+  for (c = 0; c < LUAL_POOL_NCLASSES && p->adopted > 0; c++) {
+    FreeBlock *b = p->freeblocks[c];
+    while (b != NULL) {
+      FreeBlock *next = b->next;
+      if (!inslab(p, b)) {
+        free(b);
+        p->adopted--;
+      }
+      b = next;
+    }
+  }
+}
+
+
+static void releasepool (luaL_Pool *p) {
+  Slab *s = p->slabs;
+  if (p->adopted > 0)
+    freeadopted(p);
+  while (s != NULL) {
+    Slab *next = s->next;
+    free(s);
+    s = next;
+  }
+  free(p);
+}
+
+
+LUALIB_API void *luaL_poolalloc (void *ud, void *ptr, size_t osize,
+                                                      size_t nsize) {
+  luaL_Pool *p = (luaL_Pool *)ud;
+  void *nb;
+  if (ptr == NULL)
+    osize = 0;  /* 'osize' is a type tag for new blocks, not a size */
+  if (nsize == 0) {  /* free */
+    if (ptr != NULL) {
+      if (osize <= LUAL_POOL_MAXSMALL)
+        smallfree(p, ptr, osize);
+      else {
+        free(ptr);
+        p->stats.large_count--;
+        p->stats.large_live -= osize;
+      }
+      updatelive(p, osize, 0);
+      if (p->ownedbystate && p->stats.live == 0)
+        releasepool(p);  /* that was the state itself going */
+    }
+    return NULL;
+  }
+  if (ptr != NULL && osize > LUAL_POOL_MAXSMALL &&
+                     nsize > LUAL_POOL_MAXSMALL) {  /* stays large */
+    nb = largerealloc(p, ptr, osize, nsize);
+    if (nb == NULL && nsize <= osize) {
+      p->stats.large_live = p->stats.large_live - osize + nsize;
+      nb = ptr;  /* 'realloc' could not shrink it; keep the old block */
+    }
+  }
+  else if (ptr != NULL && osize <= LUAL_POOL_MAXSMALL &&
+           nsize <= LUAL_POOL_MAXSMALL &&
+           sizeclass(osize) == sizeclass(nsize))
+    nb = ptr;  /* fits in the block it already has */
+  else {  /* new block, or moving between classes/the system allocator */
+    nb = (nsize <= LUAL_POOL_MAXSMALL) ? smallalloc(p, nsize)
+                                       : largerealloc(p, NULL, 0, nsize);
+    if (nb == NULL) {
+      if (ptr == NULL || nsize > osize) return NULL;
+      keepblock(p, osize, nsize);  /* a shrink must not fail */
+      nb = ptr;
+    }
+    else if (ptr != NULL) {
+      memcpy(nb, ptr, (osize < nsize) ? osize : nsize);
+      if (osize <= LUAL_POOL_MAXSMALL)
+        smallfree(p, ptr, osize);
+      else {
+        free(ptr);
+        p->stats.large_count--;
+        p->stats.large_live -= osize;
+      }
+    }
+  }
+  if (nb != NULL)
+    updatelive(p, osize, nsize);
+  return nb;
+}
+
+
+LUALIB_API luaL_Pool *luaL_newpool (void) {
+  luaL_Pool *p = (luaL_Pool *)calloc(1, sizeof(luaL_Pool));
+  int c;
+  if (p == NULL) return NULL;
+  for (c = 0; c < LUAL_POOL_NCLASSES; c++)
+    p->stats.classes[c].size = classsize(c);
+  return p;
+}
+
+
+LUALIB_API void luaL_freepool (luaL_Pool *p) {
+  if (p != NULL)
+    releasepool(p);
+}
+
+
+LUALIB_API const luaL_PoolStats *luaL_getpoolstats (luaL_Pool *p) {
+  return &p->stats;
+}
+
+
+LUALIB_API const luaL_PoolStats *luaL_poolstats (lua_State *L) {
+  void *ud;
+  if (lua_getallocf(L, &ud) != luaL_poolalloc)
+    return NULL;
+  return luaL_getpoolstats((luaL_Pool *)ud);
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Region allocator
+** =======================================================
+*/
+
+/*
+** All memory of a region state comes from one reservation of 'quota'
+** bytes of address space, handed out by bumping a pointer. Freed blocks
+** are kept on per-class free lists (as in the pool allocator) and the
+** most recent block can grow and shrink in place, but nothing else is
+** given back until the state is closed. Then the whole reservation is
+** released in one call, and because the state is marked with
+** 'lua_setbulkfree', 'lua_close' skips freeing objects one at a time.
+**
+** Running out of quota is an ordinary memory error in the state.
+*/
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+#define l_regionreserve(n)	VirtualAlloc(NULL, (n), MEM_RESERVE, PAGE_NOACCESS)
+#define l_regioncommit(p,n)  \
+	(VirtualAlloc((p), (n), MEM_COMMIT, PAGE_READWRITE) != NULL)
+#define l_regionrelease(p,n)	((void)(n), VirtualFree((p), 0, MEM_RELEASE))
+
+#elif defined(LUA_USE_POSIX)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE	0
+#endif
+
+/* anonymous mappings aren't strictly POSIX, mapping /dev/zero is */
+static void *l_regionreserve (size_t n) {
+  void *p;
+  int fd = open("/dev/zero", O_RDWR);
+  if (fd < 0) return NULL;
+  p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+  close(fd);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+#define l_regioncommit(p,n)	((void)(p), (void)(n), 1)  /* backed lazily */
+#define l_regionrelease(p,n)	munmap((p), (n))
+
+#else
+
+#define l_regionreserve(n)	malloc(n)
+#define l_regioncommit(p,n)	((void)(p), (void)(n), 1)
+#define l_regionrelease(p,n)	((void)(n), free(p))
+
+#endif
+
+
+/* memory is committed in steps of this many bytes */
+#define REGIONCOMMIT	(64 * 1024)
+
+#define regionround(s)	(((s) + CLASSSTEP - 1) & ~(size_t)(CLASSSTEP - 1))
+
+
+typedef struct Region {
+  char *base;  /* start of the reservation (where this header lives) */
+  char *top;  /* next free byte */
+  char *committed;  /* end of committed memory */
+  char *limit;  /* end of the reservation */
+  void *first;  /* first block handed out: the state's main block */
+  int *released;  /* set once the region is gone, while creating a state */
+  FreeBlock *freeblocks[LUAL_POOL_NCLASSES];
+  luaL_RegionStats stats;
+} Region;
+
+
+static void releaseregion (Region *r) {
+  char *base = r->base;
+  size_t size = (size_t)(r->limit - r->base);
+  if (r->released != NULL)
+    *r->released = 1;
+  l_regionrelease(base, size);  /* 'r' is gone after this */
+}
+
+
+static void *regionbump (Region *r, size_t size) {
+  char *block = r->top;
+  if (size > (size_t)(r->limit - r->top))
+    return NULL;  /* over quota */
+  if (r->top + size > r->committed) {
+    size_t n = (size_t)(r->top + size - r->committed);
+    n = (n + REGIONCOMMIT - 1) / REGIONCOMMIT * REGIONCOMMIT;
+    if (n > (size_t)(r->limit - r->committed))
+      n = (size_t)(r->limit - r->committed);
+    if (!l_regioncommit(r->committed, n))
+      return NULL;
+    r->committed += n;
+    r->stats.committed += n;
+  }
+  r->top += size;
+  r->stats.used = (size_t)(r->top - r->base);
+  return block;
+}
+
+
+static void *regionnew (Region *r, size_t size) {
+  if (size <= LUAL_POOL_MAXSMALL) {
+    int c = (int)sizeclass(size);
+    FreeBlock *b = r->freeblocks[c];
+    if (b != NULL) {
+      r->freeblocks[c] = b->next;
+      return b;
+    }
+  }
+  return regionbump(r, size);
+}
+
+
+static void regionfree (Region *r, void *ptr, size_t size) {
+  if ((char *)ptr + size == r->top) {  /* last block? */
+    r->top = (char *)ptr;
+    r->stats.used = (size_t)(r->top - r->base);
+  }
+  else if (size <= LUAL_POOL_MAXSMALL) {
+    FreeBlock *b = (FreeBlock *)ptr;
+    int c = (int)sizeclass(size);
+    b->next = r->freeblocks[c];
+    r->freeblocks[c] = b;
+  }
+  /* else the block is lost until the region is released */
+}
+
+
+static void *l_regionalloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  Region *r = (Region *)ud;
+  size_t ro = regionround(osize);
+  size_t rn = regionround(nsize);
+  void *nb;
+  if (ptr == NULL && nsize != 0)
+    ro = osize = 0;  /* 'osize' is a type tag for new blocks, not a size */
+  if (nsize == 0) {
+    if (ptr == NULL)  /* a free of nothing, or the LUA_ALLOCBULK query */
+      return (osize == LUA_ALLOCBULK) ? r : NULL;
+    if (ptr == r->first) {  /* main block going: the state is closing */
+      releaseregion(r);
+      return NULL;
+    }
+    regionfree(r, ptr, ro);
+    r->stats.live -= osize;
+    return NULL;
+  }
+  if (ptr != NULL && ((char *)ptr + ro == r->top)) {  /* resize in place? */
+    if (rn <= ro || rn - ro <= (size_t)(r->limit - r->top)) {
+      r->top = (char *)ptr;
+      nb = regionbump(r, rn);  /* same address, the room was checked above */
+      if (nb == NULL) {  /* couldn't commit more memory */
+        r->top = (char *)ptr + ro;
+        return NULL;
+      }
+      goto done;
+    }
+  }
+  if (ptr != NULL && rn <= ro) {
+    /* shrinking never moves the block, so it cannot fail near the quota;
+       a small block is freed later to the (smaller) class of 'rn' */
+    nb = ptr;
+    goto done;
+  }
+  nb = regionnew(r, rn);
+  if (nb == NULL)
+    return NULL;
+  if (r->first == NULL)
+    r->first = nb;
+  if (ptr != NULL) {
+    memcpy(nb, ptr, (osize < nsize) ? osize : nsize);
+    regionfree(r, ptr, ro);
+  }
+ done:
+  r->stats.live = r->stats.live - osize + nsize;
+  if (r->stats.live > r->stats.peak)
+    r->stats.peak = r->stats.live;
+  return nb;
+}
+
+
+static Region *newregion (size_t quota) {
+  size_t header = regionround(sizeof(Region));
+  size_t size = header + regionround(quota);
+  char *base = (char *)l_regionreserve(size);
+  size_t n = (header + REGIONCOMMIT - 1) / REGIONCOMMIT * REGIONCOMMIT;
+  Region *r;
+  if (base == NULL) return NULL;
+  if (n > size) n = size;
+  if (!l_regioncommit(base, n)) {
+    l_regionrelease(base, size);
+    return NULL;
+  }
+  r = (Region *)base;
+  memset(r, 0, sizeof(Region));
+  r->base = base;
+  r->top = base + header;
+  r->committed = base + n;
+  r->limit = base + size;
+  r->stats.quota = size - header;
+  r->stats.committed = n;
+  r->stats.used = header;
+  return r;
+}
+
+
+LUALIB_API const luaL_RegionStats *luaL_regionstats (lua_State *L) {
+  void *ud;
+  if (lua_getallocf(L, &ud) != l_regionalloc)
+    return NULL;
+  return &((Region *)ud)->stats;
+}
+
+/* }====================================================== */
+
+
 static int panic (lua_State *L) {
   lua_writestringerror("PANIC: unprotected error in call to Lua API (%s)\n",
                         lua_tostring(L, -1));
@@ -1030,6 +1807,48 @@ LUALIB_API lua_State *luaL_newstate (void) {
 }
 
 
+/*
+** Like 'luaL_newstate', but the state allocates from its own pool. The
+** pool is released along with the state by 'lua_close'.
+*/
+LUALIB_API lua_State *luaL_newpoolstate (void) {
+  lua_State *L;
+  luaL_Pool *p = luaL_newpool();
+  if (p == NULL) return NULL;
+  L = lua_newstate(luaL_poolalloc, p);
+  if (L == NULL) {
+    luaL_freepool(p);
+    return NULL;
+  }
+  p->ownedbystate = 1;
+  lua_atpanic(L, &panic);
+  return L;
+}
+
+
+/*
+** Creates a state living in a region of at most 'quota' bytes. Closing
+** it releases the region in one go rather than freeing every object.
+*/
+LUALIB_API lua_State *luaL_newregionstate (size_t quota) {
+  lua_State *L;
+  int released = 0;
+  Region *r = newregion(quota);
+  if (r == NULL) return NULL;
+  r->released = &released;
+  L = lua_newstate(l_regionalloc, r);
+  if (L == NULL) {
+    if (!released)  /* not already dropped by a failed 'lua_newstate'? */
+      releaseregion(r);
+    return NULL;
+  }
+  r->released = NULL;
+  lua_setbulkfree(L, 1);
+  lua_atpanic(L, &panic);
+  return L;
+}
+
+
 LUALIB_API void luaL_checkversion_ (lua_State *L, lua_Number ver, size_t sz) {
   const lua_Number *v = lua_version(L);
   if (sz != LUAL_NUMSIZES)  /* check numeric types */
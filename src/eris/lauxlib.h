@@ -90,6 +90,8 @@ LUALIB_API int (luaL_loadbufferx) (lua_State *L, const char *buff, size_t sz,
 LUALIB_API int (luaL_loadstring) (lua_State *L, const char *s);
 
 LUALIB_API lua_State *(luaL_newstate) (void);
+LUALIB_API lua_State *(luaL_newpoolstate) (void);
+LUALIB_API lua_State *(luaL_newregionstate) (size_t quota);
 
 LUALIB_API lua_Integer (luaL_len) (lua_State *L, int idx);
 
@@ -212,6 +214,102 @@ LUALIB_API void (luaL_openlib) (lua_State *L, const char *libname,
 #endif
 
 
+/*
+** {======================================================
+** Size-class pool allocator
+** =======================================================
+*/
+
+/* blocks up to this size come from the pool, larger ones from realloc */
+#define LUAL_POOL_MAXSMALL	256
+
+/* number of size classes, evenly spaced up to LUAL_POOL_MAXSMALL */
+#define LUAL_POOL_NCLASSES	16
+
+typedef struct luaL_PoolStats {
+  size_t live;  /* bytes currently allocated to the state */
+  size_t peak;  /* highest value 'live' has reached */
+  size_t reserved;  /* bytes of slab memory held by the pool */
+  size_t large_live;  /* bytes of 'live' in blocks from the system allocator */
+  size_t large_count;  /* number of those blocks */
+  size_t large_allocs;  /* total large blocks ever allocated */
+  struct {
+    size_t size;  /* block size for this class */
+    size_t live;  /* blocks in use */
+    size_t allocs;  /* total blocks ever handed out */
+    size_t slabs;  /* slabs carved into blocks of this class */
+  } classes[LUAL_POOL_NCLASSES];
+} luaL_PoolStats;
+
+typedef struct luaL_Pool luaL_Pool;
+
+LUALIB_API luaL_Pool *(luaL_newpool) (void);
+LUALIB_API void (luaL_freepool) (luaL_Pool *p);
+/* a 'lua_Alloc'; 'ud' must be a 'luaL_Pool' */
+LUALIB_API void *(luaL_poolalloc) (void *ud, void *ptr, size_t osize,
+                                                        size_t nsize);
+LUALIB_API const luaL_PoolStats *(luaL_getpoolstats) (luaL_Pool *p);
+/* NULL if 'L' doesn't allocate through 'luaL_poolalloc' */
+LUALIB_API const luaL_PoolStats *(luaL_poolstats) (lua_State *L);
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Region allocator
+** =======================================================
+*/
+
+typedef struct luaL_RegionStats {
+  size_t live;  /* bytes currently allocated to the state */
+  size_t peak;  /* highest value 'live' has reached */
+  size_t used;  /* bytes of the region handed out so far, including waste */
+  size_t committed;  /* bytes of the region backed by memory */
+  size_t quota;  /* hard limit on 'used' */
+} luaL_RegionStats;
+
+/* NULL if 'L' wasn't created by 'luaL_newregionstate' */
+LUALIB_API const luaL_RegionStats *(luaL_regionstats) (lua_State *L);
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Chunk cache
+** =======================================================
+*/
+
+/* default number of cache slots */
+#define LUAL_CHUNKCACHE_SLOTS	256
+
+/* chunks whose dump is larger than this are not cached */
+#define LUAL_CHUNKCACHE_MAXDUMP	(16 << 20)
+
+typedef struct luaL_ChunkCacheStats {
+  size_t hits;  /* loads served from the cache */
+  size_t misses;  /* loads that had to parse the source */
+  size_t stale;  /* misses that found an entry for an older source */
+  size_t writes;  /* entries written */
+} luaL_ChunkCacheStats;
+
+/*
+** Text files loaded by 'luaL_loadfilex' (so also 'loadfile', 'dofile'
+** and 'require') are cached as precompiled dumps in directory 'dir',
+** which must exist and be private to the program (its entries are
+** loaded without checks). Loads whose mode does not allow binary chunks
+** bypass the cache. 'dir' NULL turns the cache off.
+*/
+LUALIB_API void (luaL_setchunkcache) (lua_State *L, const char *dir,
+                                      int slots);
+/* NULL if the cache is off */
+LUALIB_API const luaL_ChunkCacheStats *(luaL_chunkcachestats) (lua_State *L);
+
+/* }====================================================== */
+
+
+
 /*
 ** {==================================================================
 ** "Abstraction Layer" for basic report of messages and errors
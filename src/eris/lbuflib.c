@@ -0,0 +1,980 @@
+/*
+** Typed buffers: fixed size arrays of numbers shared with C
+** See Copyright Notice in lua.h
+*/
+
+#define lbuflib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lbuflib.h"
+#include "lualib.h"
+
+
+/*
+** A buffer is a full userdata holding this header. A buffer made by
+** 'new' keeps its elements right behind the header; a slice or a view
+** points into the elements of another buffer, which it keeps alive
+** through its user value. Either way 'data' is the first element, so
+** access never needs to know which kind it is.
+*/
+typedef struct TypedBuf {
+  char *data;  /* first element */
+  size_t n;  /* number of elements */
+  int type;
+} TypedBuf;
+
+
+/*
+** Elements of a new buffer start on a BUFALIGN boundary, for SIMD loads
+** in native code. 'lua_newuserdata' only promises LUAI_MAXALIGN, so the
+** block gets BUFALIGN - 1 bytes of slack and 'data' is rounded up.
+*/
+#define BUFALIGN	16
+
+#define BUFHDRSIZE	(sizeof(TypedBuf) + BUFALIGN - 1)
+
+#define MAX_SIZET	((size_t)(~(size_t)0))
+
+#define MAXSIZE  \
+	(sizeof(size_t) < sizeof(int) ? MAX_SIZET : (size_t)(INT_MAX))
+
+
+static const char *const typenames[] = {
+  "f32", "f64", "i32", "u8", "vec2", NULL
+};
+
+static const unsigned char elemsize[] = {
+  sizeof(float), sizeof(double), sizeof(int32_t), 1, 2 * sizeof(float)
+};
+
+static const unsigned char elemalign[] = {
+  sizeof(float), sizeof(double), sizeof(int32_t), 1, sizeof(float)
+};
+
+
+/* translate a relative position: negative means back from end */
+static lua_Integer posrelat (lua_Integer pos, size_t len) {
+  if (pos >= 0) return pos;
+  else if (0u - (size_t)pos > len) return 0;
+  else return (lua_Integer)len + pos + 1;
+}
+
+
+/*
+** Reads an optional range [i, j] (same rules as 'string.sub') starting
+** at argument 'arg', as a 0-based first element and a count.
+*/
+static size_t getrange (lua_State *L, int arg, const TypedBuf *b,
+                        size_t *first) {
+  lua_Integer i = posrelat(luaL_optinteger(L, arg, 1), b->n);
+  lua_Integer j = posrelat(luaL_optinteger(L, arg + 1, -1), b->n);
+  if (i < 1) i = 1;
+  if (j > (lua_Integer)b->n) j = (lua_Integer)b->n;
+  *first = (size_t)i - 1;
+  return (i <= j) ? (size_t)(j - i) + 1 : 0;
+}
+
+
+/*
+** Every function of the library has the buffer metatable as its first
+** upvalue, so checking a buffer argument is a pointer comparison.
+*/
+static TypedBuf *testbuf (lua_State *L, int arg) {
+  TypedBuf *b = (TypedBuf *)lua_touserdata(L, arg);
+  if (b != NULL && lua_getmetatable(L, arg)) {
+    int same = lua_rawequal(L, -1, lua_upvalueindex(1));
+    lua_pop(L, 1);
+    if (same) return b;
+  }
+  return NULL;
+}
+
+
+static TypedBuf *checkbuf (lua_State *L, int arg) {
+  TypedBuf *b = testbuf(L, arg);
+  if (b == NULL)
+    luaL_argerror(L, arg, lua_pushfstring(L, "buffer expected, got %s",
+                                             luaL_typename(L, arg)));
+  return b;
+}
+
+
+static TypedBuf *newbuf (lua_State *L, int type, size_t n) {
+  size_t esize = elemsize[type];
+  TypedBuf *b;
+  if (n > (MAXSIZE - BUFHDRSIZE) / esize)
+    luaL_error(L, "buffer too large");
+  b = (TypedBuf *)lua_newuserdata(L, BUFHDRSIZE + n * esize);
+  b->data = (char *)(b + 1);
+  b->data += (BUFALIGN - (size_t)b->data % BUFALIGN) % BUFALIGN;
+  b->n = n;
+  b->type = type;
+  memset(b->data, 0, n * esize);
+  luaL_setmetatable(L, LUA_BUFFERHANDLE);
+  return b;
+}
+
+
+/*
+** New buffer sharing 'n' elements at 'data' with the buffer at index
+** 'owner'.
+*/
+static TypedBuf *newview (lua_State *L, int owner, int type, char *data,
+                          size_t n) {
+  TypedBuf *v = (TypedBuf *)lua_newuserdata(L, sizeof(TypedBuf));
+  v->data = data;
+  v->n = n;
+  v->type = type;
+  luaL_setmetatable(L, LUA_BUFFERHANDLE);
+  lua_pushvalue(L, owner);
+  lua_setuservalue(L, -2);  /* keep the elements alive */
+  return v;
+}
+
+
+static void pushelem (lua_State *L, const TypedBuf *b, size_t k) {
+  const char *p = b->data + k * elemsize[b->type];
+  switch (b->type) {
+    case LUA_BUFF32: lua_pushnumber(L, (lua_Number)*(const float *)p); break;
+    case LUA_BUFF64: lua_pushnumber(L, (lua_Number)*(const double *)p); break;
+    case LUA_BUFI32: lua_pushinteger(L, *(const int32_t *)p); break;
+    case LUA_BUFU8: lua_pushinteger(L, *(const unsigned char *)p); break;
+    default: {
+      const float *v = (const float *)p;
+      lua_pushvec2(L, (lua_Number)v[0], (lua_Number)v[1]);
+      break;
+    }
+  }
+}
+
+
+/*
+** Stores the value at 'idx' into element 'k'. Integers wrap around to
+** the width of the element, like a C cast.
+*/
+static void setelem (lua_State *L, TypedBuf *b, size_t k, int idx) {
+  char *p = b->data + k * elemsize[b->type];
+  int ok;
+  switch (b->type) {
+    case LUA_BUFF32: case LUA_BUFF64: {
+      lua_Number x = lua_tonumberx(L, idx, &ok);
+      if (!ok) break;
+      if (b->type == LUA_BUFF32) *(float *)p = (float)x;
+      else *(double *)p = (double)x;
+      return;
+    }
+    case LUA_BUFI32: case LUA_BUFU8: {
+      lua_Integer x = lua_tointegerx(L, idx, &ok);
+      if (!ok) break;
+      if (b->type == LUA_BUFI32) *(int32_t *)p = (int32_t)(uint32_t)x;
+      else *(unsigned char *)p = (unsigned char)x;
+      return;
+    }
+    default: {
+      lua_Number x, y;
+      if (!lua_tovec2(L, idx, &x, &y)) break;
+      ((float *)p)[0] = (float)x;
+      ((float *)p)[1] = (float)y;
+      return;
+    }
+  }
+  if (lua_type(L, idx) == LUA_TNUMBER)
+    luaL_error(L, "number has no integer representation");
+  luaL_error(L, "cannot store %s in a %s buffer", luaL_typename(L, idx),
+                typenames[b->type]);
+}
+
+
+/* copies elements 1..n of the table at 'idx' into 'b', from 'first' */
+static void settable (lua_State *L, TypedBuf *b, size_t first, int idx,
+                      size_t n) {
+  size_t k;
+  for (k = 0; k < n; k++) {
+    lua_geti(L, idx, (lua_Integer)k + 1);
+    setelem(L, b, first + k, -1);
+    lua_pop(L, 1);
+  }
+}
+
+
+static int buf_new (lua_State *L) {
+  int type = luaL_checkoption(L, 1, NULL, typenames);
+  if (lua_istable(L, 2)) {
+    size_t n = (size_t)luaL_len(L, 2);
+    settable(L, newbuf(L, type, n), 0, 2, n);
+  }
+  else {
+    lua_Integer n = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "invalid size");
+    newbuf(L, type, (size_t)n);
+  }
+  return 1;
+}
+
+
+static int buf_type (lua_State *L) {
+  TypedBuf *b = testbuf(L, 1);
+  luaL_checkany(L, 1);
+  if (b == NULL)
+    lua_pushnil(L);
+  else
+    lua_pushstring(L, typenames[b->type]);
+  return 1;
+}
+
+
+static int buf_slice (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  size_t first;
+  size_t n = getrange(L, 2, b, &first);
+  newview(L, 1, b->type, b->data + first * elemsize[b->type], n);
+  return 1;
+}
+
+
+/* the same memory seen through another element type */
+static int buf_view (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  int type = luaL_checkoption(L, 2, NULL, typenames);
+  size_t bytes = b->n * elemsize[b->type];
+  luaL_argcheck(L, bytes % elemsize[type] == 0, 2,
+                   "size is not a multiple of the element size");
+  luaL_argcheck(L, (size_t)b->data % elemalign[type] == 0, 2,
+                   "elements are not aligned for this type");
+  newview(L, 1, type, b->data, bytes / elemsize[type]);
+  return 1;
+}
+
+
+static int buf_fill (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  size_t first, esize = elemsize[b->type];
+  size_t n = getrange(L, 3, b, &first);
+  luaL_checkany(L, 2);
+  if (n > 0) {  /* store once, then copy in doubling runs */
+    char *p = b->data + first * esize;
+    size_t done = esize, total = n * esize;
+    setelem(L, b, first, 2);
+    while (done < total) {
+      size_t c = (done < total - done) ? done : total - done;
+      memcpy(p + done, p, c);
+      done += c;
+    }
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* copies a buffer of the same type or a table, starting at element 'at' */
+static int buf_set (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  TypedBuf *src = testbuf(L, 2);
+  lua_Integer at = luaL_optinteger(L, 3, 1);
+  size_t n;
+  if (src != NULL) {
+    luaL_argcheck(L, src->type == b->type, 2, "buffer of another type");
+    n = src->n;
+  }
+  else {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    n = (size_t)luaL_len(L, 2);
+  }
+  luaL_argcheck(L, at >= 1 && (size_t)(at - 1) <= b->n &&
+                   n <= b->n - (size_t)(at - 1), 3, "out of range");
+  if (src != NULL)
+    memmove(b->data + (size_t)(at - 1) * elemsize[b->type], src->data,
+            n * elemsize[b->type]);
+  else
+    settable(L, b, (size_t)(at - 1), 2, n);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int buf_totable (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  size_t first, k;
+  size_t n = getrange(L, 2, b, &first);
+  luaL_argcheck(L, n < (size_t)INT_MAX, 2, "too many elements");
+  lua_createtable(L, (int)n, 0);
+  for (k = 0; k < n; k++) {
+    pushelem(L, b, first + k);
+    lua_rawseti(L, -2, (lua_Integer)k + 1);
+  }
+  return 1;
+}
+
+
+/*
+** {======================================================
+** Kernels: whole-buffer arithmetic in native (SSE2 where available)
+** code. Float kernels treat a vec2 buffer as its 2*n floats.
+** =======================================================
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BUF_SSE2
+#include <emmintrin.h>
+#endif
+
+
+/* number of floats in a float buffer (f32 or vec2) */
+#define numfloats(b)	((b)->type == LUA_BUFVEC2 ? 2 * (b)->n : (b)->n)
+
+
+static TypedBuf *checkfloatbuf (lua_State *L, int arg) {
+  TypedBuf *b = checkbuf(L, arg);
+  if (b->type != LUA_BUFF32 && b->type != LUA_BUFF64 &&
+      b->type != LUA_BUFVEC2)
+    luaL_argerror(L, arg, "f32, f64 or vec2 buffer expected");
+  return b;
+}
+
+
+static TypedBuf *checkvec2buf (lua_State *L, int arg) {
+  TypedBuf *b = checkbuf(L, arg);
+  luaL_argcheck(L, b->type == LUA_BUFVEC2, arg, "vec2 buffer expected");
+  return b;
+}
+
+
+static void axpy_f32 (float *y, const float *x, float a, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                    _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+#endif
+  for (; i < n; i++)
+    y[i] += a * x[i];
+}
+
+
+static void axpy_f64 (double *y, const double *x, double a, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128d va = _mm_set1_pd(a);
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+                                    _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+#endif
+  for (; i < n; i++)
+    y[i] += a * x[i];
+}
+
+
+static void scale_f32 (float *y, float a, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(y + i), va));
+#endif
+  for (; i < n; i++)
+    y[i] *= a;
+}
+
+
+static void scale_f64 (double *y, double a, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128d va = _mm_set1_pd(a);
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(y + i, _mm_mul_pd(_mm_loadu_pd(y + i), va));
+#endif
+  for (; i < n; i++)
+    y[i] *= a;
+}
+
+
+/*
+** y:axpy(a, x): y[i] = y[i] + a * x[i]. With x omitted this scales y
+** by a instead, so 'vel:axpy(0.98)' applies drag.
+*/
+static int buf_axpy (lua_State *L) {
+  TypedBuf *y = checkfloatbuf(L, 1);
+  lua_Number a = luaL_checknumber(L, 2);
+  TypedBuf *x = lua_isnoneornil(L, 3) ? NULL : checkbuf(L, 3);
+  if (x != NULL)
+    luaL_argcheck(L, x->type == y->type && x->n == y->n, 3,
+                     "buffer of the same type and length expected");
+  if (y->type == LUA_BUFF64) {
+    if (x != NULL)
+      axpy_f64((double *)y->data, (const double *)x->data, (double)a, y->n);
+    else
+      scale_f64((double *)y->data, (double)a, y->n);
+  }
+  else {
+    if (x != NULL)
+      axpy_f32((float *)y->data, (const float *)x->data, (float)a,
+               numfloats(y));
+    else
+      scale_f32((float *)y->data, (float)a, numfloats(y));
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/*
+** SSE2 'min' and 'max' give their second operand when either one is a
+** NaN, so with the element second a NaN stays as it is, like in the
+** scalar loop.
+*/
+static void clamp_f32 (float *p, float lo, float hi, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(p + i, _mm_min_ps(vhi, _mm_max_ps(vlo,
+                                                    _mm_loadu_ps(p + i))));
+#endif
+  for (; i < n; i++)
+    p[i] = (p[i] < lo) ? lo : (p[i] > hi) ? hi : p[i];
+}
+
+
+static void clamp_f64 (double *p, double lo, double hi, size_t n) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128d vlo = _mm_set1_pd(lo), vhi = _mm_set1_pd(hi);
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(p + i, _mm_min_pd(vhi, _mm_max_pd(vlo,
+                                                    _mm_loadu_pd(p + i))));
+#endif
+  for (; i < n; i++)
+    p[i] = (p[i] < lo) ? lo : (p[i] > hi) ? hi : p[i];
+}
+
+
+static int buf_clamp (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  size_t i;
+  switch (b->type) {
+    case LUA_BUFF64: {
+      lua_Number lo = luaL_checknumber(L, 2), hi = luaL_checknumber(L, 3);
+      luaL_argcheck(L, lo <= hi, 3, "interval is empty");
+      clamp_f64((double *)b->data, (double)lo, (double)hi, b->n);
+      break;
+    }
+    case LUA_BUFI32: {
+      lua_Integer lo = luaL_checkinteger(L, 2), hi = luaL_checkinteger(L, 3);
+      int32_t *p = (int32_t *)b->data;
+      luaL_argcheck(L, lo <= hi, 3, "interval is empty");
+      if (lo < INT32_MIN) lo = INT32_MIN;  /* bounds outside the type */
+      if (hi > INT32_MAX) hi = INT32_MAX;
+      for (i = 0; i < b->n; i++)
+        p[i] = (p[i] < lo) ? (int32_t)lo : (p[i] > hi) ? (int32_t)hi : p[i];
+      break;
+    }
+    case LUA_BUFU8: {
+      lua_Integer lo = luaL_checkinteger(L, 2), hi = luaL_checkinteger(L, 3);
+      unsigned char *p = (unsigned char *)b->data;
+      luaL_argcheck(L, lo <= hi, 3, "interval is empty");
+      if (lo < 0) lo = 0;
+      if (hi > UCHAR_MAX) hi = UCHAR_MAX;
+      for (i = 0; i < b->n; i++)
+        p[i] = (p[i] < lo) ? (unsigned char)lo
+             : (p[i] > hi) ? (unsigned char)hi : p[i];
+      break;
+    }
+    default: {  /* f32 and vec2 */
+      lua_Number lo = luaL_checknumber(L, 2), hi = luaL_checknumber(L, 3);
+      luaL_argcheck(L, lo <= hi, 3, "interval is empty");
+      clamp_f32((float *)b->data, (float)lo, (float)hi, numfloats(b));
+      break;
+    }
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/*
+** Minimum or maximum of the floats in 'p', kept per lane i%4 so that a
+** caller can split out the components of vec2 elements (x in lanes 0
+** and 2, y in lanes 1 and 3). NaNs are skipped: the accumulator goes
+** second, so it is what 'min' and 'max' give for a NaN element.
+*/
+static void reduce_f32 (const float *p, size_t n, int ismax, float r[4]) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128 acc = _mm_set1_ps((float)(ismax ? -HUGE_VAL : HUGE_VAL));
+  if (ismax)
+    for (; i + 4 <= n; i += 4) acc = _mm_max_ps(_mm_loadu_ps(p + i), acc);
+  else
+    for (; i + 4 <= n; i += 4) acc = _mm_min_ps(_mm_loadu_ps(p + i), acc);
+  _mm_storeu_ps(r, acc);
+#else
+  r[0] = r[1] = r[2] = r[3] = (float)(ismax ? -HUGE_VAL : HUGE_VAL);
+#endif
+  for (; i < n; i++) {
+    float *a = &r[i & 3];
+    if (ismax ? p[i] > *a : p[i] < *a) *a = p[i];
+  }
+}
+
+
+static void reduce_f64 (const double *p, size_t n, int ismax, double r[2]) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128d acc = _mm_set1_pd(ismax ? -HUGE_VAL : HUGE_VAL);
+  if (ismax)
+    for (; i + 2 <= n; i += 2) acc = _mm_max_pd(_mm_loadu_pd(p + i), acc);
+  else
+    for (; i + 2 <= n; i += 2) acc = _mm_min_pd(_mm_loadu_pd(p + i), acc);
+  _mm_storeu_pd(r, acc);
+#else
+  r[0] = r[1] = ismax ? -HUGE_VAL : HUGE_VAL;
+#endif
+  for (; i < n; i++) {
+    double *a = &r[i & 1];
+    if (ismax ? p[i] > *a : p[i] < *a) *a = p[i];
+  }
+}
+
+
+#define pick(ismax,a,b)	((ismax) ? ((a) > (b) ? (a) : (b)) \
+                                 : ((a) < (b) ? (a) : (b)))
+
+
+/* float 'i' of a float buffer */
+#define floatat(b,i)	((b)->type == LUA_BUFF64 ? ((double *)(b)->data)[i] \
+                                 : (double)((float *)(b)->data)[i])
+
+
+/*
+** Pushes 'r', the bound of floats first, first + step, ... of 'b'. The
+** reductions skip NaNs, so 'r' is still the starting infinity when all
+** of them are NaN; the result is then the first of them.
+*/
+static void pushbound (lua_State *L, const TypedBuf *b, int ismax, double r,
+                       size_t first, size_t step) {
+  if (r == (ismax ? -HUGE_VAL : HUGE_VAL)) {
+    size_t i, n = (b->type == LUA_BUFF64) ? b->n : numfloats(b);
+    for (i = first; i < n && floatat(b, i) != floatat(b, i); i += step) ;
+    if (i >= n) r = floatat(b, first);
+  }
+  lua_pushnumber(L, (lua_Number)r);
+}
+
+
+/*
+** Smallest or largest element, nil for an empty buffer. A vec2 buffer
+** gives the x and y bounds as two numbers. NaNs are left out, unless
+** there is nothing else (then the bound is NaN).
+*/
+static int minmax (lua_State *L, int ismax) {
+  TypedBuf *b = checkbuf(L, 1);
+  size_t i;
+  if (b->n == 0) {
+    lua_pushnil(L);
+    return 1;
+  }
+  switch (b->type) {
+    case LUA_BUFF32: case LUA_BUFVEC2: {
+      float r[4];
+      reduce_f32((const float *)b->data, numfloats(b), ismax, r);
+      if (b->type == LUA_BUFVEC2) {
+        pushbound(L, b, ismax, pick(ismax, r[0], r[2]), 0, 2);
+        pushbound(L, b, ismax, pick(ismax, r[1], r[3]), 1, 2);
+        return 2;
+      }
+      r[0] = pick(ismax, r[0], r[1]);
+      r[2] = pick(ismax, r[2], r[3]);
+      pushbound(L, b, ismax, pick(ismax, r[0], r[2]), 0, 1);
+      break;
+    }
+    case LUA_BUFF64: {
+      double r[2];
+      reduce_f64((const double *)b->data, b->n, ismax, r);
+      pushbound(L, b, ismax, pick(ismax, r[0], r[1]), 0, 1);
+      break;
+    }
+    case LUA_BUFI32: {
+      const int32_t *p = (const int32_t *)b->data;
+      int32_t r = p[0];
+      for (i = 1; i < b->n; i++) r = pick(ismax, r, p[i]);
+      lua_pushinteger(L, r);
+      break;
+    }
+    default: {
+      const unsigned char *p = (const unsigned char *)b->data;
+      unsigned char r = p[0];
+      for (i = 1; i < b->n; i++) r = pick(ismax, r, p[i]);
+      lua_pushinteger(L, r);
+      break;
+    }
+  }
+  return 1;
+}
+
+
+static int buf_min (lua_State *L) {
+  return minmax(L, 0);
+}
+
+
+static int buf_max (lua_State *L) {
+  return minmax(L, 1);
+}
+
+
+/*
+** Lengths of 'n' vec2 elements at 'v' into 'len'. With 'normalize' set
+** the vectors are also divided by their lengths (zero vectors are left
+** alone); 'len' can be NULL then.
+*/
+static void lengths (float *v, float *len, size_t n, int normalize) {
+  size_t i = 0;
+#if defined(BUF_SSE2)
+  __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    __m128 a = _mm_loadu_ps(v + 2 * i);  /* x0 y0 x1 y1 */
+    __m128 b = _mm_loadu_ps(v + 2 * i + 4);  /* x2 y2 x3 y3 */
+    __m128 a2 = _mm_mul_ps(a, a), b2 = _mm_mul_ps(b, b);
+    __m128 l = _mm_sqrt_ps(_mm_add_ps(
+                 _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0)),
+                 _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3, 1, 3, 1))));
+    if (len != NULL)
+      _mm_storeu_ps(len + i, l);
+    if (normalize) {
+      /* 1/l where l > 0, 1 elsewhere */
+      __m128 nz = _mm_cmpgt_ps(l, zero);
+      __m128 s = _mm_or_ps(_mm_and_ps(nz, _mm_div_ps(one, l)),
+                           _mm_andnot_ps(nz, one));
+      _mm_storeu_ps(v + 2 * i, _mm_mul_ps(a, _mm_unpacklo_ps(s, s)));
+      _mm_storeu_ps(v + 2 * i + 4, _mm_mul_ps(b, _mm_unpackhi_ps(s, s)));
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    float *p = v + 2 * i;
+    float l = (float)sqrt((double)(p[0] * p[0] + p[1] * p[1]));
+    if (len != NULL)
+      len[i] = l;
+    if (normalize && l > 0.0f) {
+      float s = 1.0f / l;
+      p[0] *= s;
+      p[1] *= s;
+    }
+  }
+}
+
+
+/* v:lengths([out]): lengths of the vectors, into a new or given f32 buffer */
+static int buf_lengths (lua_State *L) {
+  TypedBuf *v = checkvec2buf(L, 1);
+  TypedBuf *out;
+  if (lua_isnoneornil(L, 2))
+    out = newbuf(L, LUA_BUFF32, v->n);
+  else {
+    out = checkbuf(L, 2);
+    luaL_argcheck(L, out->type == LUA_BUFF32 && out->n == v->n, 2,
+                     "f32 buffer of the same length expected");
+    lua_settop(L, 2);
+  }
+  lengths((float *)v->data, (float *)out->data, v->n, 0);
+  return 1;
+}
+
+
+static int buf_normalize (lua_State *L) {
+  TypedBuf *v = checkvec2buf(L, 1);
+  lengths((float *)v->data, NULL, v->n, 1);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/*
+** Keys that order as unsigned integers the way the elements order as
+** numbers: flip the sign bit of integers and of positive floats, and
+** all bits of negative floats. NaNs of either sign get the largest key,
+** so they go last.
+*/
+static void sortkeys (const TypedBuf *b, uint64_t *key) {
+  size_t i;
+  for (i = 0; i < b->n; i++) {
+    const char *p = b->data + i * elemsize[b->type];
+    switch (b->type) {
+      case LUA_BUFF32: {
+        uint32_t u;
+        memcpy(&u, p, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u) key[i] = 0xffffffffu;
+        else key[i] = (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+        break;
+      }
+      case LUA_BUFF64: {
+        uint64_t u;
+        memcpy(&u, p, sizeof(u));
+        if ((u << 1) > ((uint64_t)0x7ff << 53)) key[i] = ~(uint64_t)0;
+        else key[i] = (u >> 63) ? ~u : (u | ((uint64_t)1 << 63));
+        break;
+      }
+      case LUA_BUFI32:
+        key[i] = *(const uint32_t *)p ^ 0x80000000u;
+        break;
+      default:
+        key[i] = *(const unsigned char *)p;
+        break;
+    }
+  }
+}
+
+
+/*
+** Stable LSD radix sort of 'idx' by 'key', one byte per pass, skipping
+** passes where every key has the same byte. 'tkey' and 'tidx' are
+** scratch space; returns whichever index array ends up sorted.
+*/
+static uint32_t *radixsort (uint64_t *key, uint32_t *idx, uint64_t *tkey,
+                            uint32_t *tidx, size_t n, int nbytes) {
+  size_t count[256];
+  int pass;
+  for (pass = 0; pass < nbytes; pass++) {
+    int shift = 8 * pass;
+    size_t i, sum = 0;
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+      count[(key[i] >> shift) & 0xff]++;
+    if (count[(key[0] >> shift) & 0xff] == n)
+      continue;
+    for (i = 0; i < 256; i++) {
+      size_t c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+    for (i = 0; i < n; i++) {
+      size_t d = count[(key[i] >> shift) & 0xff]++;
+      tkey[d] = key[i];
+      tidx[d] = idx[i];
+    }
+    { uint64_t *k = key; key = tkey; tkey = k; }
+    { uint32_t *x = idx; idx = tidx; tidx = x; }
+  }
+  return idx;
+}
+
+
+/* reorders the elements of 'b' so that element i is old element idx[i] */
+static void permute (TypedBuf *b, const uint32_t *idx, char *tmp) {
+  size_t esize = elemsize[b->type], i;
+  memcpy(tmp, b->data, b->n * esize);
+  switch (esize) {
+    case 1:
+      for (i = 0; i < b->n; i++) b->data[i] = tmp[idx[i]];
+      break;
+    case 4:
+      for (i = 0; i < b->n; i++)
+        memcpy(b->data + 4 * i, tmp + 4 * (size_t)idx[i], 4);
+      break;
+    default:
+      for (i = 0; i < b->n; i++)
+        memcpy(b->data + 8 * i, tmp + 8 * (size_t)idx[i], 8);
+      break;
+  }
+}
+
+
+/*
+** buffer.sort(keys, ...): sorts 'keys' in ascending order and moves the
+** elements of the other buffers (of any type, same length, not sharing
+** memory) along with them, so parallel arrays stay in step. The sort is
+** stable.
+*/
+static int buf_sort (lua_State *L) {
+  TypedBuf *keys = checkbuf(L, 1);
+  int top = lua_gettop(L), i, j;
+  size_t n = keys->n;
+  static const unsigned char keybytes[] = {4, 8, 4, 1};
+  luaL_argcheck(L, keys->type != LUA_BUFVEC2, 1, "vec2 buffers have no order");
+  for (i = 2; i <= top; i++) {
+    TypedBuf *b = checkbuf(L, i);
+    luaL_argcheck(L, b->n == n, i, "buffer of the same length expected");
+  }
+  for (i = 1; i <= top; i++) {  /* no two buffers may overlap */
+    TypedBuf *a = (TypedBuf *)lua_touserdata(L, i);
+    for (j = i + 1; j <= top; j++) {
+      TypedBuf *b = (TypedBuf *)lua_touserdata(L, j);
+      if (a->data < b->data + b->n * elemsize[b->type] &&
+          b->data < a->data + a->n * elemsize[a->type] && n > 0)
+        luaL_argerror(L, j, "buffer shares memory with another argument");
+    }
+  }
+  if (n > 1) {
+    uint64_t *key, *tkey;
+    uint32_t *idx, *tidx;
+    size_t k;
+    if (n > MAXSIZE / (2 * sizeof(uint64_t) + 2 * sizeof(uint32_t)))
+      luaL_error(L, "buffer too large to sort");
+    key = (uint64_t *)lua_newuserdata(L, n * (2 * sizeof(uint64_t) +
+                                              2 * sizeof(uint32_t)));
+    tkey = key + n;
+    idx = (uint32_t *)(tkey + n);
+    tidx = idx + n;
+    sortkeys(keys, key);
+    for (k = 0; k < n; k++)
+      idx[k] = (uint32_t)k;
+    idx = radixsort(key, idx, tkey, tidx, n, keybytes[keys->type]);
+    for (i = 1; i <= top; i++)  /* 'key' is free again, use it as 'tmp' */
+      permute((TypedBuf *)lua_touserdata(L, i), idx, (char *)key);
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** Integer keys read and write elements, anything else looks up a
+** function of the library, so 'b:slice(2)' works. Reading past the end
+** gives nil (which 'ipairs' relies on) while writing there is an error,
+** since buffers never grow.
+*/
+static int buf_index (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  if (lua_type(L, 2) == LUA_TNUMBER) {
+    int isint;
+    lua_Integer i = lua_tointegerx(L, 2, &isint);
+    if (isint && (lua_Unsigned)i - 1u < (lua_Unsigned)b->n)
+      pushelem(L, b, (size_t)(i - 1));
+    else
+      lua_pushnil(L);
+  }
+  else {
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(2));
+  }
+  return 1;
+}
+
+
+static int buf_newindex (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  lua_Integer i = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, (lua_Unsigned)i - 1u < (lua_Unsigned)b->n, 2,
+                   "index out of range");
+  setelem(L, b, (size_t)(i - 1), 3);
+  return 0;
+}
+
+
+static int buf_len (lua_State *L) {
+  lua_pushinteger(L, (lua_Integer)checkbuf(L, 1)->n);
+  return 1;
+}
+
+
+static int buf_tostring (lua_State *L) {
+  TypedBuf *b = checkbuf(L, 1);
+  lua_pushfstring(L, "buffer(%s, %I): %p", typenames[b->type],
+                     (LUAI_UACINT)b->n, (void *)b);
+  return 1;
+}
+
+
+static const luaL_Reg buflib[] = {
+  {"new", buf_new},
+  {"type", buf_type},
+  {"slice", buf_slice},
+  {"view", buf_view},
+  {"fill", buf_fill},
+  {"set", buf_set},
+  {"totable", buf_totable},
+  {"axpy", buf_axpy},
+  {"clamp", buf_clamp},
+  {"min", buf_min},
+  {"max", buf_max},
+  {"lengths", buf_lengths},
+  {"normalize", buf_normalize},
+  {"sort", buf_sort},
+  {NULL, NULL}
+};
+
+
+static const luaL_Reg bufmeta[] = {
+  {"__index", buf_index},
+  {"__newindex", buf_newindex},
+  {"__len", buf_len},
+  {"__tostring", buf_tostring},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_buffer (lua_State *L) {
+  luaL_newlibtable(L, buflib);
+  luaL_newmetatable(L, LUA_BUFFERHANDLE);
+  /* library functions get (metatable) and metamethods get (metatable,
+     library) as upvalues */
+  lua_pushvalue(L, -2);
+  lua_pushvalue(L, -2);
+  luaL_setfuncs(L, buflib, 1);
+  lua_pop(L, 1);
+  lua_pushvalue(L, -1);
+  lua_pushvalue(L, -3);
+  luaL_setfuncs(L, bufmeta, 2);
+  lua_pushboolean(L, 0);  /* elements are shared by pointer, don't persist */
+  lua_setfield(L, -2, "__persist");
+  lua_pushliteral(L, LUA_BUFFERHANDLE);  /* keep the metamethods private */
+  lua_setfield(L, -2, "__metatable");
+  lua_pop(L, 1);
+  return 1;
+}
+
+
+/*
+** {======================================================
+** C API
+** =======================================================
+*/
+
+LUALIB_API void *luaL_newtypedbuf (lua_State *L, int type, size_t n) {
+  lua_assert(0 <= type && type < LUA_NUMBUFTYPES);
+  if (luaL_getmetatable(L, LUA_BUFFERHANDLE) == LUA_TNIL)
+    luaL_error(L, "buffer library is not open");
+  lua_pop(L, 1);
+  return newbuf(L, type, n)->data;
+}
+
+
+LUALIB_API void *luaL_totypedbuf (lua_State *L, int idx, int *type,
+                                  size_t *n) {
+  TypedBuf *b = (TypedBuf *)luaL_testudata(L, idx, LUA_BUFFERHANDLE);
+  if (b == NULL)
+    return NULL;
+  if (type) *type = b->type;
+  if (n) *n = b->n;
+  return b->data;
+}
+
+
+LUALIB_API void *luaL_checktypedbuf (lua_State *L, int arg, int type,
+                                     size_t *n) {
+  int t;
+  void *p = luaL_totypedbuf(L, arg, &t, n);
+  if (p == NULL)
+    luaL_argerror(L, arg, lua_pushfstring(L, "buffer expected, got %s",
+                                             luaL_typename(L, arg)));
+  else if (type >= 0 && t != type)
+    luaL_argerror(L, arg, lua_pushfstring(L, "%s buffer expected, got %s",
+                                             typenames[type], typenames[t]));
+  return p;
+}
+
+/* }====================================================== */
@@ -0,0 +1,45 @@
+/*
+** Typed buffers: fixed size arrays of numbers shared with C
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lbuflib_h
+#define lbuflib_h
+
+#include "lua.h"
+
+
+/* element types */
+#define LUA_BUFF32	0	/* float */
+#define LUA_BUFF64	1	/* double */
+#define LUA_BUFI32	2	/* 32-bit signed integer */
+#define LUA_BUFU8	3	/* unsigned char */
+#define LUA_BUFVEC2	4	/* pair of floats */
+
+#define LUA_NUMBUFTYPES	5
+
+
+/* registry name of the metatable shared by all buffers */
+#define LUA_BUFFERHANDLE	"buffer"
+
+
+/*
+** Elements are stored contiguously in native format, so the pointers
+** returned below can be handed to C code (or a GPU upload) as they are.
+** They stay valid as long as the buffer is reachable; buffers never
+** grow or move.
+*/
+
+/* pushes a new zero-filled buffer and returns its first element */
+LUALIB_API void *(luaL_newtypedbuf) (lua_State *L, int type, size_t n);
+
+/* elements of the buffer at 'idx', NULL if the value is not a buffer */
+LUALIB_API void *(luaL_totypedbuf) (lua_State *L, int idx, int *type,
+                                    size_t *n);
+
+/* like 'luaL_totypedbuf', but raises an error unless the argument is a
+** buffer of element type 'type' (-1 accepts any type) */
+LUALIB_API void *(luaL_checktypedbuf) (lua_State *L, int arg, int type,
+                                       size_t *n);
+
+#endif
@@ -399,6 +399,20 @@ static int db_gethook (lua_State *L) {
 }
 
 
+/*
+** debug.icstats([reset]): hits and misses of the inline caches of
+** table field accesses (hits only with LUAI_ICSTATS); a true argument
+** resets both afterwards
+*/
+static int db_icstats (lua_State *L) {
+  size_t hits, misses;
+  lua_icstats(L, &hits, &misses, lua_toboolean(L, 1));
+  lua_pushinteger(L, (lua_Integer)hits);
+  lua_pushinteger(L, (lua_Integer)misses);
+  return 2;
+}
+
+
 static int db_debug (lua_State *L) {
   for (;;) {
     char buffer[250];
@@ -433,6 +447,7 @@ static const luaL_Reg dblib[] = {
   {"getuservalue", db_getuservalue},
   {"gethook", db_gethook},
   {"getinfo", db_getinfo},
+  {"icstats", db_icstats},
   {"getlocal", db_getlocal},
   {"getregistry", db_getregistry},
   {"getmetatable", db_getmetatable},
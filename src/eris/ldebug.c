@@ -107,6 +107,20 @@ LUA_API int lua_gethookcount (lua_State *L) {
 }
 
 
+/*
+** Counters of the inline caches of table field accesses (see 'ICache')
+** since the state was created or the last reset. Hits stay at zero
+** unless Lua was built with LUAI_ICSTATS.
+*/
+LUA_API void lua_icstats (lua_State *L, size_t *hits, size_t *misses,
+                                        int reset) {
+  global_State *g = G(L);
+  if (hits) *hits = cast(size_t, g->ichits);
+  if (misses) *misses = cast(size_t, g->icmisses);
+  if (reset) g->ichits = g->icmisses = 0;
+}
+
+
 LUA_API int lua_getstack (lua_State *L, int level, lua_Debug *ar) {
   int status;
   CallInfo *ci;
@@ -494,11 +508,12 @@ static const char *funcnamefromcode (lua_State *L, CallInfo *ci,
   Proto *p = ci_func(ci)->p;  /* calling function */
   int pc = currentpc(ci);  /* calling instruction index */
   Instruction i = p->code[pc];  /* calling instruction */
+  OpCode op = basicop(GET_OPCODE(i));  /* quickened ops as generic */
   if (ci->callstatus & CIST_HOOKED) {  /* was it called inside a hook? */
     *name = "?";
     return "hook";
   }
-  switch (GET_OPCODE(i)) {
+  switch (op) {
     case OP_CALL:
     case OP_TAILCALL:
       return getobjname(p, pc, GETARG_A(i), name);  /* get function name */
@@ -516,7 +531,7 @@ static const char *funcnamefromcode (lua_State *L, CallInfo *ci,
     case OP_ADD: case OP_SUB: case OP_MUL: case OP_MOD:
     case OP_POW: case OP_DIV: case OP_IDIV: case OP_BAND:
     case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR: {
-      int offset = cast_int(GET_OPCODE(i)) - cast_int(OP_ADD);  /* ORDER OP */
+      int offset = cast_int(op) - cast_int(OP_ADD);  /* ORDER OP */
       tm = cast(TMS, offset + cast_int(TM_ADD));  /* ORDER TM */
       break;
     }
@@ -15,6 +15,7 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
 
@@ -87,9 +88,18 @@ static void DumpString (const TString *s, DumpState *D) {
 }
 
 
+/*
+** Code the interpreter has quickened is dumped in its generic form, as
+** the specialized opcodes are a property of a run, not of the function
+*/
 static void DumpCode (const Proto *f, DumpState *D) {
+  int i;
   DumpInt(f->sizecode, D);
-  DumpVector(f->code, f->sizecode, D);
+  for (i = 0; i < f->sizecode; i++) {
+    Instruction inst = f->code[i];
+    SET_OPCODE(inst, basicop(GET_OPCODE(inst)));
+    DumpVar(inst, D);
+  }
 }
 
 
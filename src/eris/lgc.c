@@ -18,6 +18,9 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "lgcfree.h"
+#include "lgcmark.h"
+#include "lgcprof.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -26,6 +29,53 @@
 #include "ltm.h"
 
 
+/*
+** 'l_gcclock' gives a monotonic time in microseconds, with a fraction
+** for finer clocks, used to bound the work done by 'luaC_stepfor' and
+** to time steps for profiling (and exported as 'luaC_clock' for the
+** collector's helper threads)
+*/
+#if !defined(l_gcclock)	/* { */
+
+#if defined(LUA_USE_POSIX)	/* { */
+
+#include <time.h>
+
+static double l_gcclock (void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return cast(double, ts.tv_sec) * 1e6 + cast(double, ts.tv_nsec) / 1e3;
+}
+
+#elif defined(_WIN32)	/* }{ */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static double l_gcclock (void) {
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return cast(double, count.QuadPart) * 1e6 / cast(double, freq.QuadPart);
+}
+
+#else				/* }{ */
+
+#include <time.h>
+
+/* ISO C only has processor time; good enough as a fallback */
+#define l_gcclock()	(cast(double, clock()) * 1e6 / CLOCKS_PER_SEC)
+
+#endif				/* } */
+
+#endif				/* } */
+
+
+double luaC_clock (void) {
+  return l_gcclock();
+}
+
+
 /*
 ** internal state for collector while inside the atomic phase. The
 ** collector should never be in this state while running regular code.
@@ -60,10 +110,10 @@
 
 
 /*
-** 'makewhite' erases all color bits then sets only the current white
-** bit
+** 'makewhite' erases all color bits (and the old bit) then sets only
+** the current white bit
 */
-#define maskcolors	(~(bitmask(BLACKBIT) | WHITEBITS))
+#define maskcolors	(~(bit2mask(BLACKBIT, OLDBIT) | WHITEBITS))
 #define makewhite(g,x)	\
  (x->marked = cast_byte((x->marked & maskcolors) | luaC_white(g)))
 
@@ -212,6 +262,8 @@ GCObject *luaC_newobj (lua_State *L, int tt, size_t sz) {
   o->tt = tt;
   o->next = g->allgc;
   g->allgc = o;
+  if (luaC_tracking(g))
+    luaC_profalloc(L, o);
   return o;
 }
 
@@ -376,7 +428,7 @@ static void traverseweakvalue (global_State *g, Table *h) {
   }
   if (g->gcstate == GCSpropagate)
     linkgclist(h, g->grayagain);  /* must retraverse it in atomic phase */
-  else if (hasclears)
+  else if (hasclears || isgenerational(g))  /* (gray tables must be kept) */
     linkgclist(h, g->weak);  /* has to be cleared later */
 }
 
@@ -424,7 +476,7 @@ static int traverseephemeron (global_State *g, Table *h) {
     linkgclist(h, g->grayagain);  /* must retraverse it in atomic phase */
   else if (hasww)  /* table has white->white entries? */
     linkgclist(h, g->ephemeron);  /* have to propagate again */
-  else if (hasclears)  /* table has white keys? */
+  else if (hasclears || isgenerational(g))  /* table has white keys? */
     linkgclist(h, g->allweak);  /* may have to clean white keys */
   return marked;
 }
@@ -545,8 +597,10 @@ static lu_mem traversethread (global_State *g, lua_State *th) {
       g->twups = th;
     }
   }
-  else if (g->gckind != KGC_EMERGENCY)
-    luaD_shrinkstack(th); /* do not change stack in emergency cycle */
+  /* do not change stack in emergency cycle, nor under a running thread
+     from the marker thread */
+  else if (g->gckind != KGC_EMERGENCY && !g->gcmarking)
+    luaD_shrinkstack(th);
   return (sizeof(lua_State) + sizeof(TValue) * th->stacksize +
           sizeof(CallInfo) * th->nci);
 }
@@ -605,6 +659,21 @@ static void propagateall (global_State *g) {
 }
 
 
+/*
+** In generational mode weak tables stay gray between collections (they
+** are old, so nothing else would revisit them); keep them in 'grayagain'
+** to be traversed again in the next atomic phase.
+*/
+static void keepweaklist (global_State *g, GCObject *l) {
+  while (l != NULL) {
+    Table *h = gco2t(l);
+    l = h->gclist;
+    lua_assert(isgray(h));
+    linkgclist(h, g->grayagain);
+  }
+}
+
+
 static void convergeephemerons (global_State *g) {
   int changed;
   do {
@@ -643,8 +712,9 @@ static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
     for (n = gnode(h, 0); n < limit; n++) {
       if (!ttisnil(gval(n)) && (iscleared(g, gkey(n)))) {
         setnilvalue(gval(n));  /* remove value ... */
-        removeentry(n);  /* and remove entry from table */
       }
+      if (ttisnil(gval(n)))  /* is entry empty? */
+        removeentry(n);  /* remove entry from table */
     }
   }
 }
@@ -667,8 +737,9 @@ static void clearvalues (global_State *g, GCObject *l, GCObject *f) {
     for (n = gnode(h, 0); n < limit; n++) {
       if (!ttisnil(gval(n)) && iscleared(g, gval(n))) {
         setnilvalue(gval(n));  /* remove value ... */
-        removeentry(n);  /* and remove entry from table */
       }
+      if (ttisnil(gval(n)))  /* is entry empty? */
+        removeentry(n);  /* remove entry from table */
     }
   }
 }
@@ -694,6 +765,8 @@ static void freeLclosure (lua_State *L, LClosure *cl) {
 
 
 static void freeobj (lua_State *L, GCObject *o) {
+  if (luaC_tracking(G(L)))
+    luaC_proffree(G(L), o);
   switch (o->tt) {
     case LUA_TPROTO: luaF_freeproto(L, gco2p(o)); break;
     case LUA_TLCL: {
@@ -728,13 +801,28 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count);
 ** sweep at most 'count' elements from a list of GCObjects erasing dead
 ** objects, where a dead object is one marked with the old (non current)
 ** white; change all non-dead objects back to white, preparing for next
-** collection cycle. Return where to continue the traversal or NULL if
-** list is finished.
+** collection cycle. In generational mode, survivors keep their color
+** and become old instead, and the sweep stops at the first old object
+** (all objects after it are old too). Return where to continue the
+** traversal or NULL if list is finished.
 */
 static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
   global_State *g = G(L);
   int ow = otherwhite(g);
-  int white = luaC_white(g);  /* current white */
+  int toclear, toset;  /* bits to clear and to set in all live objects */
+  int tostop;  /* stop sweep when this is true */
+  int deferred;
+  if (isgenerational(g)) {  /* generational mode? */
+    toclear = ~0;  /* clear nothing */
+    toset = bitmask(OLDBIT);  /* set the old bit of all surviving objects */
+    tostop = bitmask(OLDBIT);  /* do not sweep old generation */
+  }
+  else {  /* normal mode */
+    toclear = maskcolors;  /* clear all color bits + old bit */
+    toset = luaC_white(g);  /* make object white */
+    tostop = 0;  /* do not stop */
+  }
+  deferred = luaC_beginfree(g);  /* hand frees to the free thread? */
   while (*p != NULL && count-- > 0) {
     GCObject *curr = *p;
     int marked = curr->marked;
@@ -742,12 +830,18 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
       *p = curr->next;  /* remove 'curr' from list */
       freeobj(L, curr);  /* erase 'curr' */
     }
-    else {  /* change mark to 'white' */
-      curr->marked = cast_byte((marked & maskcolors) | white);
+    else {
+      if (testbits(marked, tostop)) {
+        p = NULL;  /* stop sweeping this list */
+        break;
+      }
+      curr->marked = cast_byte((marked & toclear) | toset);
       p = &curr->next;  /* go to next element */
     }
   }
-  return (*p == NULL) ? NULL : p;
+  if (deferred)
+    luaC_endfree(g);
+  return (p == NULL || *p == NULL) ? NULL : p;
 }
 
 
@@ -777,7 +871,8 @@ static GCObject **sweeptolive (lua_State *L, GCObject **p) {
 static void checkSizes (lua_State *L, global_State *g) {
   if (g->gckind != KGC_EMERGENCY) {
     l_mem olddebt = g->GCdebt;
-    if (g->strt.nuse < g->strt.size / 4)  /* string table too big? */
+    /* string table too big? (leave room for a 4x growth step) */
+    if (g->strt.nuse < g->strt.size / 8 && g->strt.size > MINSTRTABSIZE)
       luaS_resize(L, g->strt.size / 2);  /* shrink it a little */
     g->GCestimate += g->GCdebt - olddebt;  /* update estimate */
   }
@@ -791,6 +886,7 @@ static GCObject *udata2finalize (global_State *g) {
   o->next = g->allgc;  /* return it to 'allgc' list */
   g->allgc = o;
   resetbit(o->marked, FINALIZEDBIT);  /* object is "normal" again */
+  resetoldbit(o);  /* see MOVE OLD rule */
   if (issweepphase(g))
     makewhite(g, o);  /* "sweep" object */
   return o;
@@ -916,6 +1012,7 @@ void luaC_checkfinalizer (lua_State *L, GCObject *o, Table *mt) {
     o->next = g->finobj;  /* link it in 'finobj' list */
     g->finobj = o;
     l_setbit(o->marked, FINALIZEDBIT);  /* mark it as such */
+    resetoldbit(o);  /* see MOVE OLD rule */
   }
 }
 
@@ -945,6 +1042,7 @@ static void setpause (global_State *g) {
             : MAX_LMEM;  /* overflow; truncate to maximum */
   debt = gettotalbytes(g) - threshold;
   luaE_setdebt(g, debt);
+  g->GCparked = 0;
 }
 
 
@@ -969,6 +1067,8 @@ void luaC_freeallobjects (lua_State *L) {
   lua_assert(g->finobj == NULL);
   callallpendingfinalizers(L);
   lua_assert(g->tobefnz == NULL);
+  if (g->bulkfree)  /* allocator will release everything at once? */
+    return;  /* no need to free objects one by one */
   g->currentwhite = WHITEBITS; /* this "white" makes all objects look dead */
   g->gckind = KGC_NORMAL;
   sweepwholelist(L, &g->finobj);
@@ -983,6 +1083,7 @@ static l_mem atomic (lua_State *L) {
   l_mem work;
   GCObject *origweak, *origall;
   GCObject *grayagain = g->grayagain;  /* save original list */
+  g->grayagain = NULL;  /* (it is rebuilt by the traversal below) */
   lua_assert(g->ephemeron == NULL && g->weak == NULL);
   lua_assert(!iswhite(g->mainthread));
   g->gcstate = GCSinsideatomic;
@@ -1019,6 +1120,12 @@ static l_mem atomic (lua_State *L) {
   clearvalues(g, g->weak, origweak);
   clearvalues(g, g->allweak, origall);
   luaS_clearcache(g);
+  if (isgenerational(g)) {  /* weak tables must survive to next cycle */
+    keepweaklist(g, g->weak);
+    keepweaklist(g, g->allweak);
+    keepweaklist(g, g->ephemeron);
+    g->weak = g->allweak = g->ephemeron = NULL;
+  }
   g->currentwhite = cast_byte(otherwhite(g));  /* flip current white */
   work += g->GCmemtrav;  /* complete counting */
   return work;  /* estimate of memory marked by 'atomic' */
@@ -1041,7 +1148,7 @@ static lu_mem sweepstep (lua_State *L, global_State *g,
 }
 
 
-static lu_mem singlestep (lua_State *L) {
+static lu_mem dostep (lua_State *L) {
   global_State *g = G(L);
   switch (g->gcstate) {
     case GCSpause: {
@@ -1052,8 +1159,10 @@ static lu_mem singlestep (lua_State *L) {
     }
     case GCSpropagate: {
       g->GCmemtrav = 0;
-      lua_assert(g->gray);
-      propagatemark(g);
+      /* a minor collection may start with nothing new to traverse */
+      lua_assert(g->gray || isgenerational(g));
+      if (g->gray)
+        propagatemark(g);
        if (g->gray == NULL)  /* no more gray objects? */
         g->gcstate = GCSatomic;  /* finish propagate phase */
       return g->GCmemtrav;  /* memory traversed in this step */
@@ -1076,8 +1185,10 @@ static lu_mem singlestep (lua_State *L) {
       return sweepstep(L, g, GCSswpend, NULL);
     }
     case GCSswpend: {  /* finish sweeps */
-      makewhite(g, g->mainthread);  /* sweep main thread */
+      if (!isgenerational(g))  /* main thread stays gray in 'grayagain' */
+        makewhite(g, g->mainthread);  /* sweep main thread */
       checkSizes(L, g);
+      luaC_flushfree(g);  /* hand over the last deferred frees */
       g->gcstate = GCScallfin;
       return 0;
     }
@@ -1096,6 +1207,28 @@ static lu_mem singlestep (lua_State *L) {
 }
 
 
+/*
+** While profiling, each step is timed and the time is credited to the
+** state it started in; the collector step it is part of records it
+** when it ends ('profflush').
+*/
+static lu_mem singlestep (lua_State *L) {
+  global_State *g = G(L);
+  if (g->profile == NULL)
+    return dostep(L);
+  else {
+    int state = g->gcstate;
+    double start = l_gcclock();
+    lu_mem work = dostep(L);
+    luaC_profphase(g, state, l_gcclock() - start);
+    return work;
+  }
+}
+
+
+#define profflush(g)	{ if ((g)->profile) luaC_profflush(g); }
+
+
 /*
 ** advances the garbage collector until it reaches a state allowed
 ** by 'statemask'
@@ -1123,15 +1256,138 @@ static l_mem getdebt (global_State *g) {
 }
 
 /*
-** performs a basic GC step when collector is running
+** Set debt for the next minor collection, which will happen when
+** memory grows 'genminormul'% over what was in use after the last
+** major collection.
 */
-void luaC_step (lua_State *L) {
+static l_mem minorallowance (global_State *g) {
+  l_mem minor = cast(l_mem, (g->GCmajorbase / 100) * g->genminormul);
+  return (minor > GCSTEPSIZE) ? minor : GCSTEPSIZE;
+}
+
+
+static void setminordebt (global_State *g) {
+  luaE_setdebt(g, -minorallowance(g));
+  g->GCparked = 0;
+}
+
+
+/*
+** Does a minor collection: only young objects are traversed and swept.
+** The collector stays in the propagate phase between collections, so
+** that black (old) objects keep their marks and barriers keep catching
+** young objects stored into them. When memory in use has grown more
+** than 'genmajormul'% since the last major collection, old garbage
+** has accumulated enough to do a major (full) collection instead.
+*/
+static void generationalcollection (lua_State *L) {
   global_State *g = G(L);
-  l_mem debt = getdebt(g);  /* GC deficit (be paid now) */
+  lu_mem majorbase = g->GCmajorbase;
+  lu_mem majorinc = (majorbase / 100) * g->genmajormul;
+  lua_assert(g->gcstate == GCSpropagate);
+  if (gettotalbytes(g) > majorbase + majorinc)
+    luaC_fullgc(L, 0);  /* major collection (resets 'GCmajorbase') */
+  else {
+    double start = l_gcclock();
+    luaC_runtilstate(L, bitmask(GCSpause));  /* run complete minor cycle */
+    g->gcstate = GCSpropagate;  /* skip restart */
+    setminordebt(g);
+    g->GCminortime = cast(lu_mem, l_gcclock() - start) + 1;
+  }
+  lua_assert(g->gcstate == GCSpropagate);
+}
+
+
+/*
+** Traverses gray objects for at most 'usec' microseconds, or until
+** 'stop(ud)' returns true, leaving the atomic phase to the next step. This is
+** the concurrent marker's share of the work: it runs on the marker
+** thread, with the core lock held, while the mutator is outside the
+** core, so the usual barriers keep the invariant. Stacks are not
+** shrunk here, as the mutator may have Lua frames pointing into them.
+** The work done is discounted from the debt, as in 'luaC_stepfor'.
+*/
+void luaC_propagatefor (global_State *g, lu_mem usec,
+                        int (*stop) (void *ud), void *ud) {
+  double start = l_gcclock();
+  lu_mem work = 0;
+  g->gcmarking = 1;
+  while (g->gcstate == GCSpropagate && g->gray != NULL && !stop(ud)) {
+    g->GCmemtrav = 0;
+    propagatemark(g);
+    work += g->GCmemtrav;
+    if (l_gcclock() - start >= usec)
+      break;
+  }
+  g->gcmarking = 0;
+  luaE_setdebt(g, g->GCdebt - cast(l_mem, work / g->gcstepmul) * STEPMULADJ);
+  if (g->profile != NULL) {
+    luaC_profphase(g, GCSpropagate, l_gcclock() - start);
+    luaC_profflush(g);
+  }
+}
+
+
+/* debt as it would be without parking */
+#define realdebt(g)	((g)->GCdebt + (g)->GCparked)
+
+
+/*
+** Puts the parked debt back into 'GCdebt', for code that pays it
+** (idle-time and explicit steps) or when steps stop being deferred.
+*/
+void luaC_unpark (global_State *g) {
+  if (g->GCparked != 0) {
+    luaE_setdebt(g, realdebt(g));
+    g->GCparked = 0;
+  }
+}
+
+
+/*
+** performs a basic GC step when collector is running. While steps are
+** deferred ('gcdefer'), the debt is left for 'luaC_stepfor' to pay;
+** as a safety valve, debt is not allowed to grow beyond half the memory
+** in use, and only the excess over that is paid by a (small) step.
+** The debt below the valve is parked in 'GCparked', so that allocation
+** does not call in here again until the valve is reached.
+** With a concurrent marker, propagation is handed over to the marker
+** thread under the same safety valve, and the debt is parked the same
+** way, so that allocation checks back only every GCSTEPSIZE bytes; the
+** atomic phase is always done here, once the gray list is empty.
+*/
+static void step (lua_State *L) {
+  global_State *g = G(L);
+  l_mem kept = 0;  /* debt left for 'luaC_stepfor' */
+  l_mem debt;
   if (!g->gcrunning) {  /* not running? */
     luaE_setdebt(g, -GCSTEPSIZE * 10);  /* avoid being called too often */
     return;
   }
+  if (g->marker != NULL && g->gckind == KGC_NORMAL &&
+      g->gcstate == GCSpropagate && g->gray != NULL &&
+      realdebt(g) <= cast(l_mem, gettotalbytes(g)) - realdebt(g)) {
+    luaC_wakemarker(L);  /* let the marker thread do the propagation */
+    debt = realdebt(g);
+    g->GCparked = debt + GCSTEPSIZE;
+    luaE_setdebt(g, -GCSTEPSIZE);  /* park it until the next valve check */
+    return;
+  }
+  if (g->gcdefer) {
+    debt = realdebt(g);
+    kept = gettotalbytes(g) - debt;
+    g->GCparked = kept;
+    luaE_setdebt(g, debt - kept);  /* park what the valve allows */
+    if (debt <= kept)
+      return;  /* keep the debt for an idle-time step */
+  }
+  else
+    luaC_unpark(g);  /* debt parked while the marker was working */
+  debt = getdebt(g);  /* GC deficit (be paid now) */
+  if (isgenerational(g)) {
+    generationalcollection(L);
+    return;
+  }
   do {  /* repeat until pause or enough "credit" (negative debt) */
     lu_mem work = singlestep(L);  /* perform one single step */
     debt -= work;
@@ -1141,11 +1397,67 @@ void luaC_step (lua_State *L) {
   else {
     debt = (debt / g->gcstepmul) * STEPMULADJ;  /* convert 'work units' to Kb */
     luaE_setdebt(g, debt);
+    g->GCparked = kept;  /* (0 unless deferred) */
     runafewfinalizers(L);
   }
 }
 
 
+void luaC_step (lua_State *L) {
+  step(L);
+  profflush(G(L));
+}
+
+
+/*
+** Performs incremental steps until 'usec' microseconds have passed or
+** the current cycle finishes, and discounts the work done from the
+** debt, so that allocation triggers that much less work later. A new
+** cycle is only started if one is due, and none while the collector is
+** stopped. Collections cannot be split in generational mode, so a
+** minor collection is done there only once at least half the allowance
+** for it has been allocated and if the last one fit in 'usec'; major
+** collections are left to allocation. Returns 1 if a cycle was
+** finished.
+*/
+static int stepfor (lua_State *L, lu_mem usec) {
+  global_State *g = G(L);
+  double start = l_gcclock();
+  l_mem work = 0;
+  if (!g->gcrunning)
+    return 0;
+  luaC_unpark(g);  /* idle time is when parked debt is paid */
+  if (isgenerational(g)) {
+    lu_mem majorbase = g->GCmajorbase;
+    if (g->GCdebt < -minorallowance(g) / 2 ||
+        g->GCminortime > usec ||
+        gettotalbytes(g) > majorbase + (majorbase / 100) * g->genmajormul)
+      return 0;  /* too early, or it would not fit in the budget */
+    generationalcollection(L);
+    return 1;
+  }
+  if (g->gcstate == GCSpause && g->GCdebt <= 0)
+    return 0;  /* no cycle due yet */
+  do {
+    work += singlestep(L);
+    if (g->gcstate == GCSpause) {  /* finished the cycle? */
+      setpause(g);
+      return 1;
+    }
+  } while (l_gcclock() - start < usec);
+  luaE_setdebt(g, g->GCdebt - (work / g->gcstepmul) * STEPMULADJ);
+  runafewfinalizers(L);
+  return 0;
+}
+
+
+int luaC_stepfor (lua_State *L, lu_mem usec) {
+  int done = stepfor(L, usec);
+  profflush(G(L));
+  return done;
+}
+
+
 /*
 ** Performs a full GC cycle; if 'isemergency', set a flag to avoid
 ** some operations which could change the interpreter state in some
@@ -1153,12 +1465,15 @@ void luaC_step (lua_State *L) {
 ** Before running the collection, check 'keepinvariant'; if it is true,
 ** there may be some objects marked as black, so the collector has
 ** to sweep all objects to turn them back to white (as white has not
-** changed, nothing will be collected).
+** changed, nothing will be collected). In generational mode this is a
+** major collection; it runs as a regular one and then leaves the
+** collector back in the propagate phase, with every object young.
 */
 void luaC_fullgc (lua_State *L, int isemergency) {
   global_State *g = G(L);
-  lua_assert(g->gckind == KGC_NORMAL);
-  if (isemergency) g->gckind = KGC_EMERGENCY;  /* set flag */
+  int origkind = g->gckind;
+  lua_assert(origkind != KGC_EMERGENCY);
+  g->gckind = isemergency ? KGC_EMERGENCY : KGC_NORMAL;
   if (keepinvariant(g)) {  /* black objects? */
     entersweep(L); /* sweep everything to turn them back to white */
   }
@@ -1169,8 +1484,47 @@ void luaC_fullgc (lua_State *L, int isemergency) {
   /* estimate must be correct after a full GC cycle */
   lua_assert(g->GCestimate == gettotalbytes(g));
   luaC_runtilstate(L, bitmask(GCSpause));  /* finish collection */
-  g->gckind = KGC_NORMAL;
-  setpause(g);
+  if (origkind == KGC_GEN) {  /* generational mode? */
+    /* generational mode must be kept in propagate phase */
+    luaC_runtilstate(L, bitmask(GCSpropagate));
+    g->gckind = KGC_GEN;
+    g->GCmajorbase = gettotalbytes(g);
+    setminordebt(g);
+  }
+  else {
+    g->gckind = KGC_NORMAL;
+    setpause(g);
+  }
+  profflush(g);
+}
+
+
+/*
+** Changes the collector between incremental (KGC_NORMAL) and
+** generational (KGC_GEN) modes.
+*/
+void luaC_changemode (lua_State *L, int mode) {
+  global_State *g = G(L);
+  if (mode == g->gckind)
+    return;  /* nothing to change */
+  if (mode == KGC_GEN) {
+    /* start in propagate phase; the first minor collection completes
+       whatever marking is in progress and makes all survivors old */
+    luaC_runtilstate(L, bitmask(GCSpropagate));
+    g->GCmajorbase = gettotalbytes(g);
+    g->gckind = KGC_GEN;
+    setminordebt(g);
+  }
+  else {
+    lua_assert(mode == KGC_NORMAL);
+    g->gckind = KGC_NORMAL;
+    /* sweep all objects to turn old (black) ones back to white; as
+       white has not changed, nothing will be collected */
+    entersweep(L);
+    g->GCestimate = gettotalbytes(g);
+    luaC_runtilstate(L, bitmask(GCSpause));
+    setpause(g);
+  }
 }
 
 /* }====================================================== */
@@ -0,0 +1,357 @@
+/*
+** Background freeing of dead objects
+** See Copyright Notice in lua.h
+*/
+
+#define lgcfree_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+
+#include <string.h>
+
+#include "lua.h"
+
+#include "lgc.h"
+#include "lgcfree.h"
+#include "lstate.h"
+
+
+#if defined(LUA_USE_BACKGROUNDFREE)	/* { */
+
+#include "lgcthread.h"
+
+/*
+** While a list is swept, the state's allocator is replaced by one that
+** queues frees into batches instead of doing them; anything else goes
+** straight through. Full batches are handed to the free thread. The
+** memory is accounted as freed at once, so the collector's pacing is
+** unchanged. Handing a batch to a busy thread is cheap, but waking an
+** idle one is not, so batch sizes adapt: a batch that has to wake the
+** thread doubles the size, so that wake-ups get rarer, and one that
+** finds it still busy halves it, so that memory keeps going back at a
+** steady rate. If too
+** much memory is waiting (more than a quarter of the heap, and at
+** least LUAI_FREEBACKLOG), frees are done inline until the thread
+** catches up. Emergency collections also
+** free inline, as they need the memory now.
+*/
+
+#if !defined(LUAI_MINFREEBATCH)
+#define LUAI_MINFREEBATCH	32
+#endif
+
+#if !defined(LUAI_MAXFREEBATCH)
+#define LUAI_MAXFREEBATCH	4096
+#endif
+
+#if !defined(LUAI_FREEBACKLOG)
+#define LUAI_FREEBACKLOG	(1024 * 1024)
+#endif
+
+
+typedef struct FreeBlock {
+  void *block;
+  size_t osize;
+} FreeBlock;
+
+
+typedef struct FreeBatch {
+  struct FreeBatch *next;
+  size_t bytes;  /* total size of the blocks */
+  int n;  /* number of blocks */
+  FreeBlock blocks[LUAI_MAXFREEBATCH];
+} FreeBatch;
+
+
+typedef struct GCFreer {
+  l_mutex lock;
+  l_cond wake;  /* signalled when a batch is queued */
+  l_thread thread;
+  global_State *g;
+  lua_Alloc frealloc;  /* the state's own allocator */
+  void *ud;
+  /* used only by the collector */
+  FreeBatch *current;  /* batch being filled */
+  FreeBatch *spare;  /* empty batches ready for reuse */
+  int batchsize;  /* current batch size, in blocks */
+  int throttled;  /* true while frees are done inline */
+  /* shared, protected by 'lock' */
+  FreeBatch *queue;  /* batches waiting to be freed, oldest first */
+  FreeBatch **queuetail;
+  FreeBatch *done;  /* batches freed by the thread, to be reused */
+  size_t pending;  /* bytes queued but not freed yet */
+  int sleeping;  /* true while the thread waits for work */
+  int stop;  /* true when the thread must exit */
+  lua_FreeStats stats;
+} GCFreer;
+
+
+/* called with the lock held */
+static int behind (GCFreer *f) {
+  size_t limit = gettotalbytes(f->g) / 4;
+  return (f->pending > limit && f->pending > LUAI_FREEBACKLOG);
+}
+
+
+static void freebatch (GCFreer *f, FreeBatch *b) {
+  int i;
+  for (i = 0; i < b->n; i++)
+    (*f->frealloc)(f->ud, b->blocks[i].block, b->blocks[i].osize, 0);
+}
+
+
+static void freerloop (GCFreer *f) {
+  l_mutexlock(&f->lock);
+  for (;;) {
+    FreeBatch *b;
+    double start;
+    while (f->queue == NULL && !f->stop) {
+      f->sleeping = 1;
+      l_condwait(&f->wake, &f->lock);
+      f->sleeping = 0;
+    }
+    if ((b = f->queue) == NULL)
+      break;  /* stopping, and nothing left to free */
+    if ((f->queue = b->next) == NULL)
+      f->queuetail = &f->queue;
+    l_mutexunlock(&f->lock);
+    start = luaC_clock();
+    freebatch(f, b);
+    l_mutexlock(&f->lock);
+    f->stats.freetime += (luaC_clock() - start) / 1e6;
+    f->pending -= b->bytes;
+    b->next = f->done;
+    f->done = b;
+  }
+  l_mutexunlock(&f->lock);
+}
+
+
+l_threadfunc(freermain, ud) {
+  freerloop((GCFreer *)ud);
+  l_threadreturn;
+}
+
+
+static void handoff (GCFreer *f) {
+  FreeBatch *b = f->current;
+  double start = luaC_clock();
+  int wake;
+  f->current = NULL;
+  l_mutexlock(&f->lock);
+  wake = f->sleeping;
+  b->next = NULL;
+  *f->queuetail = b;
+  f->queuetail = &b->next;
+  f->pending += b->bytes;
+  f->stats.blocks += b->n;
+  f->stats.bytes += b->bytes;
+  f->stats.batches++;
+  f->throttled = behind(f);
+  if (f->done != NULL) {  /* take back the emptied batches */
+    FreeBatch *last = f->done;
+    while (last->next != NULL) last = last->next;
+    last->next = f->spare;
+    f->spare = f->done;
+    f->done = NULL;
+  }
+  if (wake)
+    l_condsignal(&f->wake);
+  l_mutexunlock(&f->lock);
+  if (wake)
+    f->batchsize = (f->batchsize * 2 > LUAI_MAXFREEBATCH)
+                 ? LUAI_MAXFREEBATCH : f->batchsize * 2;
+  else
+    f->batchsize = (f->batchsize / 2 < LUAI_MINFREEBATCH)
+                 ? LUAI_MINFREEBATCH : f->batchsize / 2;
+  f->stats.handofftime += (luaC_clock() - start) / 1e6;
+}
+
+
+static FreeBatch *getbatch (GCFreer *f) {
+  FreeBatch *b = f->spare;
+  if (b != NULL)
+    f->spare = b->next;
+  else {
+    b = (FreeBatch *)(*f->frealloc)(f->ud, NULL, 0, sizeof(FreeBatch));
+    if (b == NULL) return NULL;
+  }
+  b->n = 0;
+  b->bytes = 0;
+  return b;
+}
+
+
+/*
+** Allocator installed while sweeping.
+*/
+static void *deferalloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  GCFreer *f = (GCFreer *)ud;
+  FreeBatch *b;
+  if (nsize != 0 || ptr == NULL)
+    return (*f->frealloc)(f->ud, ptr, osize, nsize);
+  if (f->throttled || (f->current == NULL &&
+                       (f->current = getbatch(f)) == NULL)) {
+    f->stats.direct++;
+    return (*f->frealloc)(f->ud, ptr, osize, 0);
+  }
+  b = f->current;
+  b->blocks[b->n].block = ptr;
+  b->blocks[b->n].osize = osize;
+  b->n++;
+  b->bytes += osize;
+  if (b->n >= f->batchsize)
+    handoff(f);
+  return NULL;
+}
+
+
+int luaC_beginfree (global_State *g) {
+  GCFreer *f = g->freer;
+  if (f == NULL || g->gckind == KGC_EMERGENCY)
+    return 0;
+  lua_assert(g->frealloc == f->frealloc && g->ud == f->ud);
+  g->frealloc = deferalloc;
+  g->ud = f;
+  return 1;
+}
+
+
+void luaC_endfree (global_State *g) {
+  GCFreer *f = g->freer;
+  g->frealloc = f->frealloc;
+  g->ud = f->ud;
+}
+
+
+void luaC_flushfree (global_State *g) {
+  GCFreer *f = g->freer;
+  if (f == NULL) return;
+  if (f->current != NULL && f->current->n > 0)
+    handoff(f);
+  if (f->throttled) {  /* check whether the thread caught up */
+    l_mutexlock(&f->lock);
+    f->throttled = behind(f);
+    l_mutexunlock(&f->lock);
+  }
+}
+
+
+/*
+** Like the marker, the freer and its batches come straight from the
+** allocator, outside the GC accounting.
+*/
+int luaC_startfreer (lua_State *L) {
+  global_State *g = G(L);
+  GCFreer *f;
+  if (g->freer != NULL) return 1;  /* already running */
+  f = (GCFreer *)(*g->frealloc)(g->ud, NULL, 0, sizeof(GCFreer));
+  if (f == NULL) return 0;
+  memset(f, 0, sizeof(GCFreer));
+  f->g = g;
+  f->frealloc = g->frealloc;
+  f->ud = g->ud;
+  f->batchsize = LUAI_MINFREEBATCH;
+  f->queuetail = &f->queue;
+  if (l_mutexinit(&f->lock)) {
+    if (l_condinit(&f->wake)) {
+      if (l_threadstart(&f->thread, freermain, f)) {
+        g->freer = f;
+        return 1;
+      }
+      l_condfree(&f->wake);
+    }
+    l_mutexfree(&f->lock);
+  }
+  (*g->frealloc)(g->ud, f, sizeof(GCFreer), 0);
+  return 0;
+}
+
+
+/*
+** Waits for the thread to free everything it was given. Must not be
+** called while sweeping, i.e. from inside the collector.
+*/
+void luaC_stopfreer (lua_State *L) {
+  global_State *g = G(L);
+  GCFreer *f = g->freer;
+  if (f == NULL) return;
+  lua_assert(g->frealloc == f->frealloc);
+  if (f->current != NULL && f->current->n > 0)
+    handoff(f);
+  l_mutexlock(&f->lock);
+  f->stop = 1;
+  l_condsignal(&f->wake);
+  l_mutexunlock(&f->lock);
+  l_threadjoin(f->thread);
+  g->freer = NULL;
+  if (f->current != NULL) {
+    f->current->next = f->spare;
+    f->spare = f->current;
+  }
+  if (f->done != NULL) {
+    FreeBatch *last = f->done;
+    while (last->next != NULL) last = last->next;
+    last->next = f->spare;
+    f->spare = f->done;
+  }
+  while (f->spare != NULL) {
+    FreeBatch *b = f->spare;
+    f->spare = b->next;
+    (*g->frealloc)(g->ud, b, sizeof(FreeBatch), 0);
+  }
+  l_condfree(&f->wake);
+  l_mutexfree(&f->lock);
+  (*g->frealloc)(g->ud, f, sizeof(GCFreer), 0);
+}
+
+
+int luaC_freerstats (lua_State *L, lua_FreeStats *st) {
+  GCFreer *f = G(L)->freer;
+  if (f == NULL) return 0;
+  l_mutexlock(&f->lock);
+  *st = f->stats;
+  st->pending = f->pending;
+  l_mutexunlock(&f->lock);
+  st->batchsize = f->batchsize;
+  return 1;
+}
+
+#else				/* }{ */
+
+int luaC_startfreer (lua_State *L) {
+  UNUSED(L);
+  return 0;  /* not supported in this build */
+}
+
+
+void luaC_stopfreer (lua_State *L) {
+  UNUSED(L);
+}
+
+
+int luaC_freerstats (lua_State *L, lua_FreeStats *st) {
+  UNUSED(L); UNUSED(st);
+  return 0;
+}
+
+
+int luaC_beginfree (global_State *g) {
+  UNUSED(g);
+  return 0;
+}
+
+
+void luaC_endfree (global_State *g) {
+  UNUSED(g);
+}
+
+
+void luaC_flushfree (global_State *g) {
+  UNUSED(g);
+}
+
+#endif				/* } */
+
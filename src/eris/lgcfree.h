@@ -0,0 +1,31 @@
+/*
+** Background freeing of dead objects
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lgcfree_h
+#define lgcfree_h
+
+
+#include "lobject.h"
+#include "lstate.h"
+
+
+/*
+** Experimental: when Lua is built with LUA_USE_BACKGROUNDFREE, the
+** sweep phase can hand the memory of dead objects to a helper thread to
+** be freed there. Objects are still unlinked and finalized by the
+** collector as usual; only the calls to the allocator move. The
+** allocator must accept frees from another thread.
+*/
+LUAI_FUNC int luaC_startfreer (lua_State *L);
+LUAI_FUNC void luaC_stopfreer (lua_State *L);
+LUAI_FUNC int luaC_freerstats (lua_State *L, lua_FreeStats *st);
+
+/* bracket a sweep; frees in between are deferred */
+LUAI_FUNC int luaC_beginfree (global_State *g);
+LUAI_FUNC void luaC_endfree (global_State *g);
+/* hand over what is left at the end of the sweep phase */
+LUAI_FUNC void luaC_flushfree (global_State *g);
+
+#endif
@@ -0,0 +1,211 @@
+/*
+** Concurrent marking thread
+** See Copyright Notice in lua.h
+*/
+
+#define lgcmark_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+
+#include "lua.h"
+
+#include "lgc.h"
+#include "lgcmark.h"
+#include "lstate.h"
+
+
+#if defined(LUA_USE_CONCURRENTMARK)	/* { */
+
+#include "lgcthread.h"
+
+/*
+** The marker thread and the mutator share one lock, which the mutator
+** holds whenever it is inside the core ('lua_lock'). The
+** marker only runs while it holds that lock, so it never sees a
+** half-done change and all mutations it races with are made outside
+** the core, through the API, which already goes through the write
+** barriers. Once the gray list is empty the mutator finishes the cycle
+** with the atomic phase, as usual, which re-traverses everything that
+** may have changed behind the marker's back.
+*/
+
+/* time slice for the marker, in microseconds */
+#if !defined(LUAI_MARKSLICE)
+#define LUAI_MARKSLICE	200
+#endif
+
+
+
+typedef struct GCMarker {
+  l_mutex lock;  /* the core lock */
+  l_cond wake;  /* signalled when there is marking to do */
+  l_thread thread;
+  global_State *g;
+  int depth;  /* nesting of 'lua_lock' calls (mutator only) */
+  int pending;  /* true if the mutator asked for marking */
+  int stop;  /* true when the thread must exit */
+  l_atomic waiting;  /* hint: mutator is waiting to enter the core */
+} GCMarker;
+
+
+/*
+** Outside of 'luaC_holdcore' the core lock does not nest, but errors
+** thrown from inside an API call can unwind past its 'lua_unlock', so
+** the mutator keeps its own count.
+*/
+void luaC_lockcore (lua_State *L) {
+  GCMarker *m = G(L)->marker;
+  if (m != NULL && m->depth++ == 0 && !l_mutextry(&m->lock)) {
+    l_atomicset(&m->waiting, 1);  /* ask the marker to cut its slice short */
+    l_mutexlock(&m->lock);
+    l_atomicset(&m->waiting, 0);
+  }
+}
+
+
+void luaC_unlockcore (lua_State *L) {
+  GCMarker *m = G(L)->marker;
+  if (m != NULL && --m->depth == 0)
+    l_mutexunlock(&m->lock);
+}
+
+
+/*
+** Keeps the marker out while code outside the API works on internals
+** (eris). 'luaC_releasecore' takes the depth returned here and resets
+** the count, in case an error unwound through nested API calls.
+*/
+int luaC_holdcore (lua_State *L) {
+  GCMarker *m = G(L)->marker;
+  int depth = (m != NULL) ? m->depth : 0;
+  lua_lock(L);
+  return depth;
+}
+
+
+void luaC_releasecore (lua_State *L, int depth) {
+  GCMarker *m = G(L)->marker;
+  if (m != NULL)
+    m->depth = depth + 1;
+  lua_unlock(L);
+}
+
+
+static int hasmarking (global_State *g) {
+  return (g->gckind == KGC_NORMAL && g->gcstate == GCSpropagate &&
+          g->gray != NULL);
+}
+
+
+static int mutatorwaits (void *ud) {
+  return l_atomicget(&((GCMarker *)ud)->waiting);
+}
+
+
+static void markerloop (GCMarker *m) {
+  global_State *g = m->g;
+  l_mutexlock(&m->lock);
+  while (!m->stop) {
+    if (m->pending && hasmarking(g)) {
+      luaC_propagatefor(g, LUAI_MARKSLICE, mutatorwaits, m);
+      l_mutexunlock(&m->lock);
+      do {  /* let a waiting mutator in before the next slice */
+        l_yield();
+      } while (mutatorwaits(m));
+      l_mutexlock(&m->lock);
+    }
+    else {
+      m->pending = 0;
+      l_condwait(&m->wake, &m->lock);
+    }
+  }
+  l_mutexunlock(&m->lock);
+}
+
+
+l_threadfunc(markermain, ud) {
+  markerloop((GCMarker *)ud);
+  l_threadreturn;
+}
+
+
+/*
+** The marker is allocated straight from the allocator, outside the
+** GC accounting, so that failing to start it is not a memory error.
+*/
+int luaC_startmarker (lua_State *L) {
+  global_State *g = G(L);
+  GCMarker *m;
+  if (g->marker != NULL) return 1;  /* already running */
+  m = (GCMarker *)(*g->frealloc)(g->ud, NULL, 0, sizeof(GCMarker));
+  if (m == NULL) return 0;
+  m->g = g;
+  m->depth = m->pending = m->stop = 0;
+  l_atomicset(&m->waiting, 0);
+  if (l_mutexinit(&m->lock)) {
+    if (l_condinit(&m->wake)) {
+      if (l_threadstart(&m->thread, markermain, m)) {
+        g->marker = m;
+        return 1;
+      }
+      l_condfree(&m->wake);
+    }
+    l_mutexfree(&m->lock);
+  }
+  (*g->frealloc)(g->ud, m, sizeof(GCMarker), 0);
+  return 0;
+}
+
+
+/*
+** Must be called from outside the core (by the host or from a C
+** function), as the lock goes away with the marker. Marking left
+** unfinished is simply continued by the mutator.
+*/
+void luaC_stopmarker (lua_State *L) {
+  global_State *g = G(L);
+  GCMarker *m = g->marker;
+  if (m == NULL) return;
+  lua_assert(m->depth == 0);
+  l_mutexlock(&m->lock);
+  m->stop = 1;
+  l_condsignal(&m->wake);
+  l_mutexunlock(&m->lock);
+  l_threadjoin(m->thread);
+  g->marker = NULL;
+  l_condfree(&m->wake);
+  l_mutexfree(&m->lock);
+  (*g->frealloc)(g->ud, m, sizeof(GCMarker), 0);
+}
+
+
+/* called from 'luaC_step', with the core lock held */
+void luaC_wakemarker (lua_State *L) {
+  GCMarker *m = G(L)->marker;
+  if (!m->pending) {
+    m->pending = 1;
+    l_condsignal(&m->wake);
+  }
+}
+
+#else				/* }{ */
+
+int luaC_startmarker (lua_State *L) {
+  UNUSED(L);
+  return 0;  /* not supported in this build */
+}
+
+
+void luaC_stopmarker (lua_State *L) {
+  UNUSED(L);
+}
+
+
+void luaC_wakemarker (lua_State *L) {
+  UNUSED(L);
+}
+
+#endif				/* } */
+
@@ -0,0 +1,29 @@
+/*
+** Concurrent marking thread
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lgcmark_h
+#define lgcmark_h
+
+
+#include "lobject.h"
+#include "lstate.h"
+
+
+/*
+** Experimental: when Lua is built with LUA_USE_CONCURRENTMARK, the
+** propagation part of the mark phase can be done by a helper thread
+** while the host runs outside the Lua core. 'luaC_startmarker' returns
+** 0 if that is not supported or the thread could not be created.
+*/
+LUAI_FUNC int luaC_startmarker (lua_State *L);
+LUAI_FUNC void luaC_stopmarker (lua_State *L);
+LUAI_FUNC void luaC_wakemarker (lua_State *L);
+
+#if defined(LUA_USE_CONCURRENTMARK)
+LUAI_FUNC int luaC_holdcore (lua_State *L);
+LUAI_FUNC void luaC_releasecore (lua_State *L, int depth);
+#endif
+
+#endif
@@ -0,0 +1,479 @@
+/*
+** Collector profiling and heap census
+** See Copyright Notice in lua.h
+*/
+
+#define lgcprof_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lfunc.h"
+#include "lgc.h"
+#include "lgcprof.h"
+#include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
+
+
+/*
+** While profiling is on, the collector times every single step and
+** adds it to the phase it ran in; at the end of each collector step
+** (a 'luaC_step' or similar call) the time gathered for each phase is
+** recorded as one sample. When tracking, every new object is mapped to
+** the Lua function that was running when it was created (the closest
+** Lua caller, for objects made by C functions), so that a census can
+** break the heap down by allocation site. Like the other collector
+** helpers, the profile lives outside the GC accounting.
+*/
+
+
+/*
+** {======================================================
+** Pointer maps (open addressing, linear probing)
+** =======================================================
+*/
+
+typedef struct MapEntry {
+  const void *key;  /* NULL for a free slot */
+  int value;
+} MapEntry;
+
+
+typedef struct PtrMap {
+  MapEntry *e;
+  size_t size;  /* always 0 or a power of 2 */
+  size_t n;
+} PtrMap;
+
+
+#define maphash(k,m)	((cast(size_t, k) >> 4) & ((m)->size - 1))
+
+
+static void mapfree (global_State *g, PtrMap *m) {
+  if (m->e != NULL)
+    (*g->frealloc)(g->ud, m->e, m->size * sizeof(MapEntry), 0);
+  m->e = NULL;
+  m->size = m->n = 0;
+}
+
+
+static MapEntry *mapfind (PtrMap *m, const void *key) {
+  size_t i;
+  if (m->size == 0) return NULL;
+  for (i = maphash(key, m); m->e[i].key != NULL; i = (i + 1) & (m->size - 1)) {
+    if (m->e[i].key == key)
+      return &m->e[i];
+  }
+  return NULL;
+}
+
+
+static int mapset (global_State *g, PtrMap *m, const void *key, int value);
+
+static int mapgrow (global_State *g, PtrMap *m) {
+  PtrMap old = *m;
+  size_t i;
+  size_t size = (old.size == 0) ? 64 : old.size * 2;
+  m->e = (MapEntry *)(*g->frealloc)(g->ud, NULL, 0, size * sizeof(MapEntry));
+  if (m->e == NULL) {
+    *m = old;
+    return 0;
+  }
+  memset(m->e, 0, size * sizeof(MapEntry));
+  m->size = size;
+  m->n = 0;
+  for (i = 0; i < old.size; i++) {
+    if (old.e[i].key != NULL)
+      mapset(g, m, old.e[i].key, old.e[i].value);
+  }
+  mapfree(g, &old);
+  return 1;
+}
+
+
+/* returns 0 if the map could not grow */
+static int mapset (global_State *g, PtrMap *m, const void *key, int value) {
+  size_t i;
+  if ((m->n + 1) * 4 > m->size * 3 && !mapgrow(g, m))
+    return 0;
+  for (i = maphash(key, m); m->e[i].key != NULL; i = (i + 1) & (m->size - 1)) {
+    if (m->e[i].key == key) {
+      m->e[i].value = value;
+      return 1;
+    }
+  }
+  m->e[i].key = key;
+  m->e[i].value = value;
+  m->n++;
+  return 1;
+}
+
+
+/* removes 'e', moving back entries of its probe chain to fill the gap */
+static void mapremove (PtrMap *m, MapEntry *e) {
+  size_t i = cast(size_t, e - m->e);
+  size_t j = i;
+  for (;;) {
+    size_t h;
+    m->e[i].key = NULL;
+    do {
+      j = (j + 1) & (m->size - 1);
+      if (m->e[j].key == NULL) {
+        m->n--;
+        return;
+      }
+      h = maphash(m->e[j].key, m);
+      /* leave it if its home slot is cyclically in (i, j] */
+    } while ((i <= j) ? (i < h && h <= j) : (i < h || h <= j));
+    m->e[i] = m->e[j];
+    i = j;
+  }
+}
+
+/* }====================================================== */
+
+
+typedef struct GCSite {
+  char name[LUA_IDSIZE + 16];  /* "source:line" of the function */
+  int nexthash;  /* next site with the same name hash, or -1 */
+  size_t count;  /* census scratch */
+  size_t bytes;
+} GCSite;
+
+
+#define HOSTSITE	0  /* objects created from C with no Lua caller */
+
+
+typedef struct GCProfile {
+  lua_GCProfile stats;
+  double acc[LUA_GCPHASES];  /* time in each phase since the last flush */
+  int touched;  /* bit mask of the phases in 'acc' */
+  int track;  /* record allocation sites? */
+  GCSite *sites;
+  int nsites;
+  int sizesites;
+  PtrMap names;  /* name hash -> first site with that hash */
+  PtrMap protos;  /* Proto -> site */
+  PtrMap objs;  /* object -> site */
+} GCProfile;
+
+
+static void freesites (global_State *g, GCProfile *pr) {
+  if (pr->sites != NULL)
+    (*g->frealloc)(g->ud, pr->sites, pr->sizesites * sizeof(GCSite), 0);
+  pr->sites = NULL;
+  pr->nsites = pr->sizesites = 0;
+  mapfree(g, &pr->names);
+  mapfree(g, &pr->protos);
+  mapfree(g, &pr->objs);
+}
+
+
+/* returns the index of the site called 'name', creating it if needed */
+static int getsite (global_State *g, GCProfile *pr, const char *name) {
+  size_t l = strlen(name);
+  const void *h = cast(const void *,
+                       cast(size_t, luaS_hash(name, l, 0)) | 1);  /* not NULL */
+  MapEntry *e = mapfind(&pr->names, h);
+  int i;
+  for (i = (e != NULL) ? e->value : -1; i >= 0; i = pr->sites[i].nexthash) {
+    if (strcmp(pr->sites[i].name, name) == 0)
+      return i;
+  }
+  if (pr->nsites == pr->sizesites) {
+    int size = (pr->sizesites == 0) ? 64 : pr->sizesites * 2;
+    GCSite *s = (GCSite *)(*g->frealloc)(g->ud, pr->sites,
+                                         pr->sizesites * sizeof(GCSite),
+                                         size * sizeof(GCSite));
+    if (s == NULL) return -1;
+    pr->sites = s;
+    pr->sizesites = size;
+  }
+  i = pr->nsites;
+  memcpy(pr->sites[i].name, name, l + 1);
+  pr->sites[i].nexthash = (e != NULL) ? e->value : -1;
+  if (!mapset(g, &pr->names, h, i))
+    return -1;
+  pr->nsites++;
+  return i;
+}
+
+
+static int protosite (global_State *g, GCProfile *pr, const Proto *p) {
+  MapEntry *e = mapfind(&pr->protos, p);
+  char name[LUA_IDSIZE + 16];
+  size_t l;
+  int site;
+  if (e != NULL)
+    return e->value;
+  if (p->source != NULL)
+    luaO_chunkid(name, getstr(p->source), LUA_IDSIZE);
+  else
+    strcpy(name, "?");
+  l = strlen(name);
+  if (p->linedefined == 0)
+    strcpy(name + l, ": main chunk");
+  else
+    sprintf(name + l, ":%d", p->linedefined);
+  site = getsite(g, pr, name);
+  if (site >= 0 && !mapset(g, &pr->protos, p, site))
+    return -1;
+  return site;
+}
+
+
+void luaC_profalloc (lua_State *L, GCObject *o) {
+  global_State *g = G(L);
+  GCProfile *pr = g->profile;
+  CallInfo *ci = L->ci;
+  int site = HOSTSITE;
+  while (ci != &L->base_ci && !isLua(ci))
+    ci = ci->previous;  /* find the closest Lua function */
+  if (ci != &L->base_ci)
+    site = protosite(g, pr, clLvalue(ci->func)->p);
+  if (site >= 0)
+    mapset(g, &pr->objs, o, site);  /* untracked if the map is full */
+}
+
+
+void luaC_proffree (global_State *g, GCObject *o) {
+  GCProfile *pr = g->profile;
+  MapEntry *e = mapfind(&pr->objs, o);
+  if (e != NULL)
+    mapremove(&pr->objs, e);
+  if (o->tt == LUA_TPROTO && (e = mapfind(&pr->protos, o)) != NULL)
+    mapremove(&pr->protos, e);  /* its site stays, under its name */
+}
+
+
+int luaC_proftracking (global_State *g) {
+  return g->profile->track;
+}
+
+
+/*
+** {======================================================
+** Step timing
+** =======================================================
+*/
+
+static int statephase (int state) {
+  switch (state) {
+    case GCSatomic: return LUA_GCPATOMIC;
+    case GCSswpallgc: case GCSswpfinobj:
+    case GCSswptobefnz: case GCSswpend: return LUA_GCPSWEEP;
+    case GCScallfin: return LUA_GCPFINALIZE;
+    default: return LUA_GCPPROPAGATE;  /* propagate, or marking roots */
+  }
+}
+
+
+void luaC_profphase (global_State *g, int state, double usec) {
+  GCProfile *pr = g->profile;
+  int phase = statephase(state);
+  pr->acc[phase] += usec;
+  pr->touched |= (1 << phase);
+}
+
+
+static int histbin (double usec) {
+  int bin = 0;
+  while (usec >= 1.0 && bin < LUA_GCHISTBINS - 1) {
+    usec /= 2;
+    bin++;
+  }
+  return bin;
+}
+
+
+void luaC_profflush (global_State *g) {
+  GCProfile *pr = g->profile;
+  int i;
+  for (i = 0; i < LUA_GCPHASES; i++) {
+    if (pr->touched & (1 << i)) {
+      lua_GCPhaseStats *ps = &pr->stats.phase[i];
+      double sec = pr->acc[i] / 1e6;
+      ps->steps++;
+      ps->total += sec;
+      if (sec > ps->max) ps->max = sec;
+      ps->hist[histbin(pr->acc[i])]++;
+      pr->acc[i] = 0;
+    }
+  }
+  pr->touched = 0;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Census
+** =======================================================
+*/
+
+static int objkind (GCObject *o) {
+  switch (o->tt) {
+    case LUA_TTABLE: return LUA_CENSUSTABLE;
+    case LUA_TSHRSTR: case LUA_TLNGSTR: return LUA_CENSUSSTRING;
+    case LUA_TLCL: return LUA_CENSUSLFUNC;
+    case LUA_TCCL: return LUA_CENSUSCFUNC;
+    case LUA_TUSERDATA: return LUA_CENSUSUSERDATA;
+    case LUA_TPROTO: return LUA_CENSUSPROTO;
+    default: lua_assert(o->tt == LUA_TTHREAD); return LUA_CENSUSTHREAD;
+  }
+}
+
+
+/* memory owned by 'o' (upvalues, shared between closures, are left out) */
+static size_t objsize (GCObject *o) {
+  switch (o->tt) {
+    case LUA_TTABLE: {
+      Table *h = gco2t(o);
+      return sizeof(Table) + sizeof(TValue) * h->sizearray +
+                             sizeof(Node) * allocsizenode(h);
+    }
+    case LUA_TSHRSTR: return sizelstring(gco2ts(o)->shrlen);
+    case LUA_TLNGSTR: return sizelstring(gco2ts(o)->u.lnglen);
+    case LUA_TLCL: return sizeLclosure(gco2lcl(o)->nupvalues);
+    case LUA_TCCL: return sizeCclosure(gco2ccl(o)->nupvalues);
+    case LUA_TUSERDATA: return sizeudata(gco2u(o));
+    case LUA_TPROTO: {
+      Proto *f = gco2p(o);
+      return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
+                             sizeof(Proto *) * f->sizep +
+                             sizeof(TValue) * f->sizek +
+                             sizeof(int) * f->sizelineinfo +
+                             sizeof(LocVar) * f->sizelocvars +
+                             sizeof(Upvaldesc) * f->sizeupvalues;
+    }
+    default: {
+      lua_State *th = gco2th(o);
+      lua_assert(o->tt == LUA_TTHREAD);
+      return LUA_EXTRASPACE + sizeof(lua_State) +
+             sizeof(TValue) * th->stacksize + sizeof(CallInfo) * th->nci;
+    }
+  }
+}
+
+
+static void censuslist (global_State *g, GCObject *o, lua_HeapCensus *c,
+                        size_t *untracked) {
+  GCProfile *pr = g->profile;
+  int track = (pr != NULL && pr->track);
+  for (; o != NULL; o = o->next) {
+    int kind;
+    size_t size;
+    if (isdead(g, o))
+      continue;  /* garbage not swept yet */
+    kind = objkind(o);
+    size = objsize(o);
+    c->count[kind]++;
+    c->bytes[kind] += size;
+    if (track) {
+      MapEntry *e = mapfind(&pr->objs, o);
+      if (e != NULL) {
+        pr->sites[e->value].count++;
+        pr->sites[e->value].bytes += size;
+      }
+      else {
+        untracked[0]++;
+        untracked[1] += size;
+      }
+    }
+  }
+}
+
+
+/*
+** Counts live objects by kind and, when tracking, by allocation site.
+** 'f' is called with the state locked and must not use it.
+*/
+void luaC_census (lua_State *L, lua_HeapCensus *c, lua_CensusSite f,
+                  void *ud) {
+  global_State *g = G(L);
+  GCProfile *pr = g->profile;
+  size_t untracked[2] = {0, 0};  /* count, bytes */
+  int i;
+  memset(c, 0, sizeof(lua_HeapCensus));
+  if (pr != NULL) {
+    for (i = 0; i < pr->nsites; i++)
+      pr->sites[i].count = pr->sites[i].bytes = 0;
+  }
+  censuslist(g, g->allgc, c, untracked);
+  censuslist(g, g->finobj, c, untracked);
+  censuslist(g, g->tobefnz, c, untracked);
+  censuslist(g, g->fixedgc, c, untracked);
+  if (f == NULL || pr == NULL || !pr->track)
+    return;
+  for (i = 0; i < pr->nsites; i++) {
+    if (pr->sites[i].count > 0)
+      f(ud, pr->sites[i].name, pr->sites[i].count, pr->sites[i].bytes);
+  }
+  if (untracked[0] > 0)  /* objects from before tracking started */
+    f(ud, "?", untracked[0], untracked[1]);
+}
+
+/* }====================================================== */
+
+
+static void freeprofile (global_State *g) {
+  GCProfile *pr = g->profile;
+  if (pr == NULL) return;
+  freesites(g, pr);
+  g->profile = NULL;
+  (*g->frealloc)(g->ud, pr, sizeof(GCProfile), 0);
+}
+
+
+/*
+** 'what' is one of LUA_GCPROF*. Returns 0 if the profile could not be
+** created.
+*/
+int luaC_setprofile (lua_State *L, int what) {
+  global_State *g = G(L);
+  GCProfile *pr = g->profile;
+  if (what == LUA_GCPROFOFF) {
+    freeprofile(g);
+    return 1;
+  }
+  if (what == LUA_GCPROFRESET) {
+    if (pr != NULL)
+      memset(&pr->stats, 0, sizeof(lua_GCProfile));
+    return 1;
+  }
+  if (pr == NULL) {
+    pr = (GCProfile *)(*g->frealloc)(g->ud, NULL, 0, sizeof(GCProfile));
+    if (pr == NULL) return 0;
+    memset(pr, 0, sizeof(GCProfile));
+    g->profile = pr;
+  }
+  if (what == LUA_GCPROFTRACK && !pr->track) {
+    if (getsite(g, pr, "[C]") != HOSTSITE) {
+      freesites(g, pr);
+      return 0;
+    }
+    pr->track = 1;
+  }
+  else if (what == LUA_GCPROFON && pr->track) {
+    freesites(g, pr);
+    pr->track = 0;
+  }
+  return 1;
+}
+
+
+int luaC_getprofile (lua_State *L, lua_GCProfile *p) {
+  GCProfile *pr = G(L)->profile;
+  if (pr == NULL) return 0;
+  *p = pr->stats;
+  return 1;
+}
+
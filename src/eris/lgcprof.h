@@ -0,0 +1,27 @@
+/*
+** Collector profiling and heap census
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lgcprof_h
+#define lgcprof_h
+
+
+#include "lobject.h"
+#include "lstate.h"
+
+
+/* true if allocation sites are being recorded */
+#define luaC_tracking(g)	((g)->profile != NULL && luaC_proftracking(g))
+
+LUAI_FUNC int luaC_setprofile (lua_State *L, int what);
+LUAI_FUNC int luaC_getprofile (lua_State *L, lua_GCProfile *p);
+LUAI_FUNC int luaC_proftracking (global_State *g);
+LUAI_FUNC void luaC_profphase (global_State *g, int state, double usec);
+LUAI_FUNC void luaC_profflush (global_State *g);
+LUAI_FUNC void luaC_profalloc (lua_State *L, GCObject *o);
+LUAI_FUNC void luaC_proffree (global_State *g, GCObject *o);
+LUAI_FUNC void luaC_census (lua_State *L, lua_HeapCensus *c,
+                            lua_CensusSite f, void *ud);
+
+#endif
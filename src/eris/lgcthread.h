@@ -0,0 +1,88 @@
+/*
+** Thread primitives for the collector's helper threads
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lgcthread_h
+#define lgcthread_h
+
+
+/*
+** Only included by the helper threads (lgcmark.c, lgcfree.c), which are
+** compiled in on request. Helper threads are declared with
+** 'l_threadfunc' and started with 'l_threadstart'. Flags read by one
+** thread without the lock while another sets them are 'l_atomic', read
+** with 'l_atomicget' and written with 'l_atomicset'.
+*/
+
+#if defined(_WIN32)	/* { */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef CRITICAL_SECTION l_mutex;
+typedef CONDITION_VARIABLE l_cond;
+typedef HANDLE l_thread;
+
+#define l_mutexinit(m)	(InitializeCriticalSection(m), 1)
+#define l_mutexfree(m)	DeleteCriticalSection(m)
+#define l_mutexlock(m)	EnterCriticalSection(m)
+#define l_mutextry(m)	TryEnterCriticalSection(m)
+#define l_mutexunlock(m)	LeaveCriticalSection(m)
+#define l_condinit(c)	(InitializeConditionVariable(c), 1)
+#define l_condfree(c)	((void)0)
+#define l_condwait(c,m)	SleepConditionVariableCS(c, m, INFINITE)
+#define l_condsignal(c)	WakeConditionVariable(c)
+#define l_yield()	SwitchToThread()
+
+#define l_threadfunc(f,ud)	static DWORD WINAPI f (LPVOID ud)
+#define l_threadreturn	return 0
+#define l_threadstart(t,f,ud)	\
+	((*(t) = CreateThread(NULL, 0, f, ud, 0, NULL)) != NULL)
+#define l_threadjoin(t)	(WaitForSingleObject(t, INFINITE), CloseHandle(t))
+
+typedef volatile LONG l_atomic;
+
+#define l_atomicget(a)	InterlockedCompareExchange((a), 0, 0)
+#define l_atomicset(a,v)	InterlockedExchange((a), (v))
+
+#else				/* }{ */
+
+#include <pthread.h>
+#include <sched.h>
+
+typedef pthread_mutex_t l_mutex;
+typedef pthread_cond_t l_cond;
+typedef pthread_t l_thread;
+
+#define l_mutexinit(m)	(pthread_mutex_init(m, NULL) == 0)
+#define l_mutexfree(m)	pthread_mutex_destroy(m)
+#define l_mutexlock(m)	pthread_mutex_lock(m)
+#define l_mutextry(m)	(pthread_mutex_trylock(m) == 0)
+#define l_mutexunlock(m)	pthread_mutex_unlock(m)
+#define l_condinit(c)	(pthread_cond_init(c, NULL) == 0)
+#define l_condfree(c)	pthread_cond_destroy(c)
+#define l_condwait(c,m)	pthread_cond_wait(c, m)
+#define l_condsignal(c)	pthread_cond_signal(c)
+#define l_yield()	sched_yield()
+
+#define l_threadfunc(f,ud)	static void *f (void *ud)
+#define l_threadreturn	return NULL
+#define l_threadstart(t,f,ud)	(pthread_create(t, NULL, f, ud) == 0)
+#define l_threadjoin(t)	pthread_join(t, NULL)
+
+#if defined(__GNUC__)
+typedef int l_atomic;
+
+#define l_atomicget(a)	__atomic_load_n((a), __ATOMIC_ACQUIRE)
+#define l_atomicset(a,v)	__atomic_store_n((a), (v), __ATOMIC_RELEASE)
+#else
+typedef volatile int l_atomic;  /* best effort */
+
+#define l_atomicget(a)	(*(a))
+#define l_atomicset(a,v)	(*(a) = (v))
+#endif
+
+#endif				/* } */
+
+#endif
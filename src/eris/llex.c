@@ -54,19 +54,166 @@ static const char *const luaX_tokens [] = {
 static l_noret lexerror (LexState *ls, const char *msg, int token);
 
 
-static void save (LexState *ls, int c) {
+/* makes room in the token buffer for 'n' more characters */
+static void growbuffer (LexState *ls, size_t n) {
   Mbuffer *b = ls->buff;
-  if (luaZ_bufflen(b) + 1 > luaZ_sizebuffer(b)) {
-    size_t newsize;
-    if (luaZ_sizebuffer(b) >= MAX_SIZE/2)
+  size_t newsize = luaZ_sizebuffer(b);
+  do {
+    if (newsize >= MAX_SIZE/2)
       lexerror(ls, "lexical element too long", 0);
-    newsize = luaZ_sizebuffer(b) * 2;
-    luaZ_resizebuffer(ls->L, b, newsize);
-  }
+    newsize *= 2;
+  } while (newsize - luaZ_bufflen(b) < n);
+  luaZ_resizebuffer(ls->L, b, newsize);
+}
+
+
+static void save (LexState *ls, int c) {
+  Mbuffer *b = ls->buff;
+  if (luaZ_bufflen(b) + 1 > luaZ_sizebuffer(b))
+    growbuffer(ls, 1);
   b->buffer[luaZ_bufflen(b)++] = cast(char, c);
 }
 
 
+/*
+** {======================================================
+** Runs: the scanners below measure how many of the characters that
+** are already in the input buffer, after the current one, belong to
+** a run (spaces, a name, the body of a string or comment). The run
+** is then skipped or saved in one go instead of a 'next' per
+** character. Runs stop at the end of the buffer; the character-wise
+** code takes over there and reads the next block.
+** =======================================================
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEX_SSE2
+#include <emmintrin.h>
+
+#define CHUNK	16  /* bytes examined at a time */
+
+#define loadchunk(p)	_mm_loadu_si128(cast(const __m128i *, (p)))
+#define eqbyte(c,b)	_mm_cmpeq_epi8((c), _mm_set1_epi8(cast(char, b)))
+/* bytes in ['lo', 'hi'] (signed compare; both bounds are ASCII) */
+#define inrange(c,lo,hi)  _mm_and_si128( \
+	_mm_cmpgt_epi8((c), _mm_set1_epi8(cast(char, (lo) - 1))), \
+	_mm_cmplt_epi8((c), _mm_set1_epi8(cast(char, (hi) + 1))))
+#define bytemask(v)	cast(unsigned int, _mm_movemask_epi8(v))
+
+#if defined(__GNUC__)
+#define firstbit(m)	__builtin_ctz(m)
+#else
+static int firstbit (unsigned int m) {
+  int i = 0;
+  while ((m & 1u) == 0) { m >>= 1; i++; }
+  return i;
+}
+#endif
+
+#endif
+
+
+#define ishspace(c)	((c) == ' ' || (c) == '\t' || (c) == '\v' || (c) == '\f')
+
+/* length of the run of spaces (but not newlines) at 'p' */
+static size_t spanspaces (const char *p, size_t n) {
+  size_t i = 0;
+#if defined(LEX_SSE2)
+  for (; i + CHUNK <= n; i += CHUNK) {
+    __m128i c = loadchunk(p + i);
+    unsigned int m = bytemask(_mm_or_si128(
+                       _mm_or_si128(eqbyte(c, ' '), eqbyte(c, '\t')),
+                       _mm_or_si128(eqbyte(c, '\v'), eqbyte(c, '\f'))));
+    if (m != 0xffff) return i + firstbit(~m);
+  }
+#endif
+  while (i < n && ishspace(p[i])) i++;
+  return i;
+}
+
+
+/*
+** length of the run of name characters at 'p'; the vector loop only
+** knows ASCII names, anything else is left to 'lislalnum'
+*/
+static size_t spanname (const char *p, size_t n) {
+  size_t i = 0;
+#if defined(LEX_SSE2)
+  for (; i + CHUNK <= n; i += CHUNK) {
+    __m128i c = loadchunk(p + i);
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    unsigned int m = bytemask(_mm_or_si128(
+                       _mm_or_si128(inrange(lower, 'a', 'z'),
+                                    inrange(c, '0', '9')),
+                       eqbyte(c, '_')));
+    if (m != 0xffff) return i + firstbit(~m);
+  }
+#endif
+  while (i < n && lislalnum(cast_uchar(p[i]))) i++;
+  return i;
+}
+
+
+/* length of the run at 'p' free of 'a', 'b', 'c' and 'd' */
+static size_t spanuntil (const char *p, size_t n, int a, int b, int c,
+                                                   int d) {
+  size_t i = 0;
+#if defined(LEX_SSE2)
+  __m128i va = _mm_set1_epi8(cast(char, a));
+  __m128i vb = _mm_set1_epi8(cast(char, b));
+  __m128i vc = _mm_set1_epi8(cast(char, c));
+  __m128i vd = _mm_set1_epi8(cast(char, d));
+  for (; i + CHUNK <= n; i += CHUNK) {
+    __m128i x = loadchunk(p + i);
+    __m128i ab = _mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb));
+    __m128i cd = _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vd));
+    unsigned int m = bytemask(_mm_or_si128(ab, cd));
+    if (m != 0) return i + firstbit(m);
+  }
+#endif
+  for (; i < n; i++) {
+    int ch = p[i];
+    if (ch == a || ch == b || ch == c || ch == d) break;
+  }
+  return i;
+}
+
+
+/* length of the run of decimal digits at 'p' (numerals are short) */
+static size_t spandigits (const char *p, size_t n) {
+  size_t i = 0;
+  while (i < n && lisdigit(cast_uchar(p[i]))) i++;
+  return i;
+}
+
+
+/* arguments for the scanners: the unread part of the input buffer */
+#define unread(ls)	(ls)->z->p, (ls)->z->n
+
+
+/* skips the current character and the 'k' after it */
+static void skiprun (LexState *ls, size_t k) {
+  ls->z->p += k;
+  ls->z->n -= k;
+  next(ls);
+}
+
+
+/* saves the current character and the 'k' after it */
+static void saverun (LexState *ls, size_t k) {
+  Mbuffer *b = ls->buff;
+  if (luaZ_sizebuffer(b) - luaZ_bufflen(b) <= k)
+    growbuffer(ls, k + 1);
+  b->buffer[luaZ_bufflen(b)++] = cast(char, ls->current);
+  memcpy(b->buffer + luaZ_bufflen(b), ls->z->p, k);
+  luaZ_bufflen(b) += k;
+  skiprun(ls, k);
+}
+
+/* }====================================================== */
+
+
 void luaX_init (lua_State *L) {
   int i;
   TString *e = luaS_newliteral(L, LUA_ENV);  /* create env name */
@@ -222,7 +369,9 @@ static int read_numeral (LexState *ls, SemInfo *seminfo) {
   for (;;) {
     if (check_next2(ls, expo))  /* exponent part? */
       check_next2(ls, "-+");  /* optional exponent sign */
-    if (lisxdigit(ls->current))
+    if (lisdigit(ls->current))
+      saverun(ls, spandigits(unread(ls)));
+    else if (lisxdigit(ls->current))
       save_and_next(ls);
     else if (ls->current == '.')
       save_and_next(ls);
@@ -289,8 +438,9 @@ static void read_long_string (LexState *ls, SemInfo *seminfo, int sep) {
         break;
       }
       default: {
-        if (seminfo) save_and_next(ls);
-        else next(ls);
+        size_t k = spanuntil(unread(ls), ']', '\n', '\r', ']');
+        if (seminfo) saverun(ls, k);
+        else skiprun(ls, k);
       }
     }
   } endloop:
@@ -417,7 +567,7 @@ static void read_string (LexState *ls, int del, SemInfo *seminfo) {
        no_save: break;
       }
       default:
-        save_and_next(ls);
+        saverun(ls, spanuntil(unread(ls), del, '\\', '\n', '\r'));
     }
   }
   save_and_next(ls);  /* skip delimiter */
@@ -436,6 +586,8 @@ static int llex (LexState *ls, SemInfo *seminfo) {
       }
       case ' ': case '\f': case '\t': case '\v': {  /* spaces */
         next(ls);
+        if (ishspace(ls->current))  /* a run (indentation)? */
+          skiprun(ls, spanspaces(unread(ls)));
         break;
       }
       case '-': {  /* '-' or '--' (comment) */
@@ -453,8 +605,8 @@ static int llex (LexState *ls, SemInfo *seminfo) {
           }
         }
         /* else short comment */
-        while (!currIsNewline(ls) && ls->current != EOZ)
-          next(ls);  /* skip until end of line (or end of file) */
+        while (!currIsNewline(ls) && ls->current != EOZ)  /* skip line */
+          skiprun(ls, spanuntil(unread(ls), '\n', '\r', '\n', '\r'));
         break;
       }
       case '[': {  /* long string or simply '[' */
@@ -524,7 +676,7 @@ static int llex (LexState *ls, SemInfo *seminfo) {
         if (lislalpha(ls->current)) {  /* identifier or reserved word? */
           TString *ts;
           do {
-            save_and_next(ls);
+            saverun(ls, spanname(unread(ls)));
           } while (lislalnum(ls->current));
           ts = luaX_newstring(ls, luaZ_buffer(ls->buff),
                                   luaZ_bufflen(ls->buff));
@@ -182,10 +182,21 @@ typedef unsigned long Instruction;
 ** Initial size for the string table (must be power of 2).
 ** The Lua core alone registers ~50 strings (reserved words +
 ** metaevent keys + a few others). Libraries would typically add
-** a few dozens more.
+** a few dozens more, and a host binding a few classes goes into
+** the thousands before the first script has run, so start big
+** enough to skip the early doublings.
 */
 #if !defined(MINSTRTABSIZE)
-#define MINSTRTABSIZE	128
+#define MINSTRTABSIZE	1024
+#endif
+
+
+/*
+** String table sizes below this grow by 4x instead of 2x when the
+** table fills up (must be power of 2).
+*/
+#if !defined(STRTABQUICKGROW)
+#define STRTABQUICKGROW	(1 << 16)
 #endif
 
 
@@ -208,8 +219,17 @@ typedef unsigned long Instruction;
 
 /*
 ** macros that are executed whenever program enters the Lua core
-** ('lua_lock') and leaves the core ('lua_unlock')
+** ('lua_lock') and leaves the core ('lua_unlock'). With concurrent
+** marking, the core lock keeps the marker thread (see lgcmark.c) out
+** while the mutator is inside the core.
 */
+#if defined(LUA_USE_CONCURRENTMARK) && !defined(lua_lock)
+LUAI_FUNC void luaC_lockcore (lua_State *L);
+LUAI_FUNC void luaC_unlockcore (lua_State *L);
+#define lua_lock(L)	luaC_lockcore(L)
+#define lua_unlock(L)	luaC_unlockcore(L)
+#endif
+
 #if !defined(lua_lock)
 #define lua_lock(L)	((void) 0)
 #define lua_unlock(L)	((void) 0)
@@ -32,6 +32,13 @@
 
 LUAI_DDEF const TValue luaO_nilobject_ = {NILCONSTANT};
 
+#if defined(LUA_NANBOXING)
+LUAI_DDEF const lu_byte luaO_nbtag_[8] = {
+  LUA_TNUMFLT, LUA_TNIL, LUA_TBOOLEAN, LUA_TLIGHTUSERDATA, LUA_TLCF,
+  LUA_TNUMINT, 0 /* collectables have their own */, LUA_TDEADKEY
+};
+#endif
+
 
 /*
 ** converts an integer to a "floating point byte", represented as
@@ -120,6 +127,65 @@ static lua_Number numarith (lua_State *L, int op, lua_Number v1,
 }
 
 
+/*
+** Get the components of a vec2 operand into 'v'; a number gives the
+** same value in both. Returns 1 if 'o' was a vec2, 0 if it was a number
+** and -1 if it was neither.
+*/
+static int tov2 (const TValue *o, float *v) {
+  lua_Number n;
+  if (ttisvec2(o)) {
+    v[0] = v2value(o)[0]; v[1] = v2value(o)[1];
+    return 1;
+  }
+  else if (ttisnumber(o)) {
+    n = nvalue(o);
+    v[0] = v[1] = cast(float, n);
+    return 0;
+  }
+  else {
+    v[0] = v[1] = 0;
+    return -1;
+  }
+}
+
+
+/*
+** Arithmetic on vec2 values: '+' and '-' take two vectors, '*' and '/'
+** either two vectors (componentwise) or a vector and a number, and
+** unary minus negates both components. Returns 0, leaving 'res'
+** untouched, when the operands are not of one of those forms.
+*/
+int luaO_v2arith (int op, const TValue *p1, const TValue *p2, TValue *res) {
+  float a[2], b[2];
+  int k1 = tov2(p1, a);
+  int k2 = tov2(p2, b);
+  if (k1 < 0 || k2 < 0 || k1 + k2 == 0)
+    return 0;  /* a non-number or no vector at all */
+  switch (op) {
+    case LUA_OPADD:
+      if (k1 + k2 != 2) return 0;
+      setv2value(res, a[0] + b[0], a[1] + b[1]);
+      return 1;
+    case LUA_OPSUB:
+      if (k1 + k2 != 2) return 0;
+      setv2value(res, a[0] - b[0], a[1] - b[1]);
+      return 1;
+    case LUA_OPMUL:
+      setv2value(res, a[0] * b[0], a[1] * b[1]);
+      return 1;
+    case LUA_OPDIV:
+      setv2value(res, a[0] / b[0], a[1] / b[1]);
+      return 1;
+    case LUA_OPUNM:
+      if (k1 != 1) return 0;
+      setv2value(res, -a[0], -a[1]);
+      return 1;
+    default: return 0;
+  }
+}
+
+
 void luaO_arith (lua_State *L, int op, const TValue *p1, const TValue *p2,
                  TValue *res) {
   switch (op) {
@@ -154,6 +220,8 @@ void luaO_arith (lua_State *L, int op, const TValue *p1, const TValue *p2,
       else break;  /* go to the end */
     }
   }
+  if (luaO_v2arith(op, p1, p2, res))
+    return;
   /* could not perform raw operation; try metamethod */
   lua_assert(L != NULL);  /* should not fail when folding (compile time) */
   luaT_trybinTM(L, p1, p2, res, cast(TMS, (op - LUA_OPADD) + TM_ADD));
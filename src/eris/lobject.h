@@ -94,6 +94,8 @@ struct GCObject {
 ** an actual value plus a tag with its type.
 */
 
+#if !defined(LUA_NANBOXING)	/* { */
+
 /*
 ** Union of all Lua values
 */
@@ -104,27 +106,106 @@ typedef union Value {
   lua_CFunction f; /* light C functions */
   lua_Integer i;   /* integer numbers */
   lua_Number n;    /* float numbers */
+  float v2[2];     /* vec2 components */
 } Value;
 
 
 #define TValuefields	Value value_; int tt_
 
 
-typedef struct lua_TValue {
-  TValuefields;
-} TValue;
+/* macro defining a nil value */
+#define NILCONSTANT	{NULL}, LUA_TNIL
+
+
+#define val_(o)		((o)->value_)
+
+
+/* raw type tag of a TValue */
+#define rttype(o)	((o)->tt_)
 
+#else				/* }{ */
+
+/*
+** With NaN boxing a value is a single 64-bit word: either a float, or a
+** NaN with the sign bit set whose bits 48-50 give the kind of the value
+** (NBK_*) and whose low 48 bits hold it (a pointer, a 32-bit integer or
+** a boolean). Float NaNs are stored as a canonical NaN that never looks
+** like one of those. The variant tag of a collectable value is read
+** from the object it points to.
+*/
+#if LUA_FLOAT_TYPE != LUA_FLOAT_DOUBLE || LUA_INT_TYPE != LUA_INT_INT
+#error "NaN boxing needs 'double' floats and 'int' integers"
+#endif
+
+typedef unsigned long long l_nbits;
+
+typedef union Value {
+  l_nbits u;       /* boxed values */
+  lua_Number n;    /* float numbers */
+  float v2[2];     /* unused: vec2 values cannot be boxed */
+} Value;
+
+
+#define TValuefields	Value value_
+
+
+#define NBK_NIL		1
+#define NBK_BOOLEAN	2
+#define NBK_LIGHTUD	3
+#define NBK_LCF		4
+#define NBK_INT		5
+#define NBK_GC		6
+#define NBK_DEADKEY	7
+
+/* high bits of a boxed value of kind 'k' */
+#define NBKIND(k)	(cast(l_nbits, 0xFFF8 | (k)) << 48)
+
+#define NBTAGMASK	NBKIND(7)
+#define NBPAYLOAD	(~NBTAGMASK)
+#define NBCANONNAN	(cast(l_nbits, 0x7FF8) << 48)
+
+#define NBNIL		NBKIND(NBK_NIL)
 
 
 /* macro defining a nil value */
-#define NILCONSTANT	{NULL}, LUA_TNIL
+#define NILCONSTANT	{NBNIL}
 
 
 #define val_(o)		((o)->value_)
 
+/* is it a float? (everything below the first boxed kind) */
+#define nbisfloat(o)	(val_(o).u < NBKIND(1))
+
+/* kind of a boxed value */
+#define nbkind(o)	(cast_int(val_(o).u >> 48) & 7)
+
+#define nbis(o,k)	((val_(o).u & NBTAGMASK) == NBKIND(k))
+
+#define nbptr(o)	cast(void *, cast(size_t, val_(o).u & NBPAYLOAD))
+
+/* box 'p' (a pointer or an unsigned integer) as kind 'k' */
+#define nbbox(k,p)  \
+	check_exp((cast(l_nbits, cast(size_t, p)) & NBTAGMASK) == 0, \
+	          NBKIND(k) | cast(l_nbits, cast(size_t, p)))
+
+/* 'gc' field of a collectable value, without checks */
+#define nbgc(o)		cast(GCObject *, nbptr(o))
+
+
+/* tags of the boxed kinds (for collectables, see 'rttype') */
+LUAI_DDEC const lu_byte luaO_nbtag_[8];
 
 /* raw type tag of a TValue */
-#define rttype(o)	((o)->tt_)
+#define rttype(o)  \
+	(nbisfloat(o) ? LUA_TNUMFLT : \
+	 nbkind(o) == NBK_GC ? ctb(nbgc(o)->tt) : luaO_nbtag_[nbkind(o)])
+
+#endif				/* } */
+
+
+typedef struct lua_TValue {
+  TValuefields;
+} TValue;
 
 /* tag with no variants (bits 0-3) */
 #define novariant(x)	((x) & 0x0F)
@@ -157,6 +238,7 @@ typedef struct lua_TValue {
 #define ttisfulluserdata(o)	checktag((o), ctb(LUA_TUSERDATA))
 #define ttisthread(o)		checktag((o), ctb(LUA_TTHREAD))
 #define ttisdeadkey(o)		checktag((o), LUA_TDEADKEY)
+#define ttisvec2(o)		checktag((o), LUA_TVEC2)
 
 
 /* Macros to access values */
@@ -175,6 +257,7 @@ typedef struct lua_TValue {
 #define hvalue(o)	check_exp(ttistable(o), gco2t(val_(o).gc))
 #define bvalue(o)	check_exp(ttisboolean(o), val_(o).b)
 #define thvalue(o)	check_exp(ttisthread(o), gco2th(val_(o).gc))
+#define v2value(o)	check_exp(ttisvec2(o), val_(o).v2)
 /* a dead value may get the 'gc' field, but cannot access its contents */
 #define deadvalue(o)	check_exp(ttisdeadkey(o), cast(void *, val_(o).gc))
 
@@ -254,6 +337,11 @@ typedef struct lua_TValue {
 
 #define setdeadvalue(obj)	settt_(obj, LUA_TDEADKEY)
 
+/* components are read before the store, as 'obj' may be their source */
+#define setv2value(obj,x,y) \
+  { TValue *io=(obj); float x_=cast(float, (x)), y_=cast(float, (y)); \
+    val_(io).v2[0]=x_; val_(io).v2[1]=y_; settt_(io, LUA_TVEC2); }
+
 
 
 #define setobj(L,obj1,obj2) \
@@ -283,6 +371,186 @@ typedef struct lua_TValue {
 
 
 
+/*
+** {======================================================
+** NaN boxing
+** =======================================================
+*/
+
+#if defined(LUA_NANBOXING)	/* { */
+
+#undef settt_
+
+/* Macros to test type */
+#undef ttisnumber
+#undef ttisfloat
+#undef ttisinteger
+#undef ttisnil
+#undef ttisboolean
+#undef ttislightuserdata
+#undef ttisstring
+#undef ttisshrstring
+#undef ttislngstring
+#undef ttistable
+#undef ttisfunction
+#undef ttisclosure
+#undef ttisCclosure
+#undef ttisLclosure
+#undef ttislcf
+#undef ttisfulluserdata
+#undef ttisthread
+#undef ttisdeadkey
+#undef ttisvec2
+#undef iscollectable
+
+#define nbcheckgc(o,t)		(iscollectable(o) && nbgc(o)->tt == (t))
+
+#define ttisnumber(o)		(nbisfloat(o) || nbkind(o) == NBK_INT)
+#define ttisfloat(o)		nbisfloat(o)
+#define ttisinteger(o)		nbis((o), NBK_INT)
+#define ttisnil(o)		nbis((o), NBK_NIL)
+#define ttisboolean(o)		nbis((o), NBK_BOOLEAN)
+#define ttislightuserdata(o)	nbis((o), NBK_LIGHTUD)
+#define ttisstring(o)  \
+	(iscollectable(o) && novariant(nbgc(o)->tt) == LUA_TSTRING)
+#define ttisshrstring(o)	nbcheckgc((o), LUA_TSHRSTR)
+#define ttislngstring(o)	nbcheckgc((o), LUA_TLNGSTR)
+#define ttistable(o)		nbcheckgc((o), LUA_TTABLE)
+#define ttisfunction(o)		(ttisclosure(o) || ttislcf(o))
+#define ttisclosure(o)  \
+	(iscollectable(o) && (nbgc(o)->tt & 0x1F) == LUA_TFUNCTION)
+#define ttisCclosure(o)		nbcheckgc((o), LUA_TCCL)
+#define ttisLclosure(o)		nbcheckgc((o), LUA_TLCL)
+#define ttislcf(o)		nbis((o), NBK_LCF)
+#define ttisfulluserdata(o)	nbcheckgc((o), LUA_TUSERDATA)
+#define ttisthread(o)		nbcheckgc((o), LUA_TTHREAD)
+#define ttisdeadkey(o)		nbis((o), NBK_DEADKEY)
+/* a vec2 does not fit in a boxed value, see 'lua_pushvec2' */
+#define ttisvec2(o)		((void)(o), 0)
+
+#define iscollectable(o)	nbis((o), NBK_GC)
+
+
+/* Macros to access values */
+#undef ivalue
+#undef fltvalue
+#undef gcvalue
+#undef pvalue
+#undef tsvalue
+#undef uvalue
+#undef clvalue
+#undef clLvalue
+#undef clCvalue
+#undef fvalue
+#undef hvalue
+#undef bvalue
+#undef thvalue
+#undef deadvalue
+
+#define ivalue(o)  \
+	check_exp(ttisinteger(o), l_castU2S(cast(lua_Unsigned, val_(o).u)))
+#define fltvalue(o)	check_exp(ttisfloat(o), val_(o).n)
+#define gcvalue(o)	check_exp(iscollectable(o), nbgc(o))
+#define pvalue(o)	check_exp(ttislightuserdata(o), nbptr(o))
+#define tsvalue(o)	check_exp(ttisstring(o), gco2ts(nbgc(o)))
+#define uvalue(o)	check_exp(ttisfulluserdata(o), gco2u(nbgc(o)))
+#define clvalue(o)	check_exp(ttisclosure(o), gco2cl(nbgc(o)))
+#define clLvalue(o)	check_exp(ttisLclosure(o), gco2lcl(nbgc(o)))
+#define clCvalue(o)	check_exp(ttisCclosure(o), gco2ccl(nbgc(o)))
+#define fvalue(o)  \
+	check_exp(ttislcf(o), \
+	          cast(lua_CFunction, cast(size_t, val_(o).u & NBPAYLOAD)))
+#define hvalue(o)	check_exp(ttistable(o), gco2t(nbgc(o)))
+#define bvalue(o)	check_exp(ttisboolean(o), cast_int(val_(o).u & 1))
+#define thvalue(o)	check_exp(ttisthread(o), gco2th(nbgc(o)))
+#define deadvalue(o)	check_exp(ttisdeadkey(o), nbptr(o))
+
+
+/* Macros to set values */
+#undef setfltvalue
+#undef chgfltvalue
+#undef setivalue
+#undef chgivalue
+#undef setnilvalue
+#undef setfvalue
+#undef setpvalue
+#undef setbvalue
+#undef setgcovalue
+#undef setsvalue
+#undef setuvalue
+#undef setthvalue
+#undef setclLvalue
+#undef setclCvalue
+#undef sethvalue
+#undef setdeadvalue
+#undef setv2value
+
+#define setfltvalue(obj,x) \
+  { TValue *io=(obj); lua_Number n_=(x); \
+    if (luai_numisnan(n_)) val_(io).u = NBCANONNAN; else val_(io).n = n_; }
+
+#define chgfltvalue(obj,x) \
+  { TValue *io_=(obj); lua_assert(ttisfloat(io_)); setfltvalue(io_, x); }
+
+#define setivalue(obj,x) \
+  { TValue *io=(obj); \
+    val_(io).u = NBKIND(NBK_INT) | cast(l_nbits, l_castS2U(x)); }
+
+#define chgivalue(obj,x) \
+  { TValue *io_=(obj); lua_assert(ttisinteger(io_)); setivalue(io_, x); }
+
+#define setnilvalue(obj) (val_(obj).u = NBNIL)
+
+#define setfvalue(obj,x) \
+  { TValue *io=(obj); lua_CFunction f_=(x); val_(io).u = nbbox(NBK_LCF, f_); }
+
+#define setpvalue(obj,x) \
+  { TValue *io=(obj); void *p_=(x); val_(io).u = nbbox(NBK_LIGHTUD, p_); }
+
+#define setbvalue(obj,x) \
+  { TValue *io=(obj); val_(io).u = NBKIND(NBK_BOOLEAN) | ((x) != 0); }
+
+#define setgcovalue(L,obj,x) \
+  { TValue *io = (obj); GCObject *i_g=(x); \
+    val_(io).u = nbbox(NBK_GC, i_g); }
+
+#define setsvalue(L,obj,x) \
+  { TValue *io = (obj); TString *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+#define setuvalue(L,obj,x) \
+  { TValue *io = (obj); Udata *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+#define setthvalue(L,obj,x) \
+  { TValue *io = (obj); lua_State *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+#define setclLvalue(L,obj,x) \
+  { TValue *io = (obj); LClosure *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+#define setclCvalue(L,obj,x) \
+  { TValue *io = (obj); CClosure *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+#define sethvalue(L,obj,x) \
+  { TValue *io = (obj); Table *x_ = (x); \
+    val_(io).u = nbbox(NBK_GC, obj2gco(x_)); checkliveness(L,io); }
+
+/* keeps the pointer, so that 'next' can still find the key */
+#define setdeadvalue(obj)  \
+	(val_(obj).u = NBKIND(NBK_DEADKEY) | (val_(obj).u & NBPAYLOAD))
+
+#define setv2value(obj,x,y) \
+  { (void)(obj); (void)(x); (void)(y); lua_assert(0); }
+
+#endif				/* } */
+
+/* }====================================================== */
+
+
+
 
 /*
 ** {======================================================
@@ -368,6 +636,8 @@ typedef union UUdata {
 #define getudatamem(u)  \
   check_exp(sizeof((u)->ttuv_), (cast(char*, (u)) + sizeof(UUdata)))
 
+#if !defined(LUA_NANBOXING)
+
 #define setuservalue(L,u,o) \
 	{ const TValue *io=(o); Udata *iu = (u); \
 	  iu->user_ = io->value_; iu->ttuv_ = rttype(io); \
@@ -379,6 +649,20 @@ typedef union UUdata {
 	  io->value_ = iu->user_; settt_(io, iu->ttuv_); \
 	  checkliveness(L,io); }
 
+#else
+
+/* the tag is part of the value, 'ttuv_' is unused */
+#define setuservalue(L,u,o) \
+	{ const TValue *io=(o); Udata *iu = (u); \
+	  iu->user_ = io->value_; checkliveness(L,io); }
+
+
+#define getuservalue(L,u,o) \
+	{ TValue *io=(o); const Udata *iu = (u); \
+	  io->value_ = iu->user_; checkliveness(L,io); }
+
+#endif
+
 
 /*
 ** Description of an upvalue for function prototypes
@@ -401,6 +685,16 @@ typedef struct LocVar {
 } LocVar;
 
 
+/*
+** State the interpreter keeps for each instruction of a function
+*/
+typedef struct ICache {
+  unsigned int slot;  /* inline cache: slot of the key (see 'ichit') */
+  lu_byte lsizenode;  /* inline cache: log2 of the table's node array size */
+  lu_byte deopts;  /* times a quickened form of the instruction was undone */
+} ICache;
+
+
 /*
 ** Function Prototypes
 */
@@ -424,6 +718,7 @@ typedef struct Proto {
   LocVar *locvars;  /* information about local variables (debug information) */
   Upvaldesc *upvalues;  /* upvalue information */
   struct LClosure *cache;  /* last-created closure with this prototype */
+  ICache *ic;  /* per-instruction state (allocated on first use) */
   TString  *source;  /* used for debug information */
   GCObject *gclist;
 } Proto;
@@ -482,10 +777,16 @@ typedef union TKey {
 
 
 /* copy a value into a key without messing up field 'next' */
+#if !defined(LUA_NANBOXING)
 #define setnodekey(L,key,obj) \
 	{ TKey *k_=(key); const TValue *io_=(obj); \
 	  k_->nk.value_ = io_->value_; k_->nk.tt_ = io_->tt_; \
 	  (void)L; checkliveness(L,io_); }
+#else
+#define setnodekey(L,key,obj) \
+	{ TKey *k_=(key); const TValue *io_=(obj); \
+	  k_->nk.value_ = io_->value_; (void)L; checkliveness(L,io_); }
+#endif
 
 
 typedef struct Node {
@@ -536,6 +837,8 @@ LUAI_FUNC int luaO_utf8esc (char *buff, unsigned long x);
 LUAI_FUNC int luaO_ceillog2 (unsigned int x);
 LUAI_FUNC void luaO_arith (lua_State *L, int op, const TValue *p1,
                            const TValue *p2, TValue *res);
+LUAI_FUNC int luaO_v2arith (int op, const TValue *p1, const TValue *p2,
+                            TValue *res);
 LUAI_FUNC size_t luaO_str2num (const char *s, TValue *o);
 LUAI_FUNC int luaO_hexavalue (int c);
 LUAI_FUNC void luaO_tostring (lua_State *L, StkId obj);
@@ -230,11 +230,32 @@ OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
 
 OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 
-OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
+OP_EXTRAARG,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/*
+** Quickened opcodes: forms of the instructions above specialized for
+** two integer operands (II) or for float arithmetic (FF: two numbers,
+** not both integers). Only the interpreter writes them, over the
+** generic instruction (see 'luaV_execute').
+*/
+OP_ADDII,/*	A B C	R(A) := RK(B) + RK(C), both integers		*/
+OP_ADDFF,/*	A B C	R(A) := RK(B) + RK(C), float arithmetic		*/
+OP_SUBII,
+OP_SUBFF,
+OP_MULII,
+OP_MULFF,
+OP_DIVFF,
+OP_LTII,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++, both integers */
+OP_LTFF,
+OP_LEII,
+OP_LEFF
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_EXTRAARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_LEFF) + 1)
+
+/* number of opcodes that can appear in generated (or dumped) code */
+#define NUM_BASICOPS	(cast(int, OP_EXTRAARG) + 1)
 
 
 
@@ -290,6 +311,13 @@ LUAI_DDEC const lu_byte luaP_opmodes[NUM_OPCODES];
 LUAI_DDEC const char *const luaP_opnames[NUM_OPCODES+1];  /* opcode names */
 
 
+LUAI_DDEC const lu_byte luaP_basicops[NUM_OPCODES - NUM_BASICOPS];
+
+/* the generic opcode of 'o', which may be a quickened one */
+#define basicop(o)  \
+	((o) < NUM_BASICOPS ? (o) : cast(OpCode, luaP_basicops[(o) - NUM_BASICOPS]))
+
+
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
 
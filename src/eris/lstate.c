@@ -20,6 +20,9 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "lgcfree.h"
+#include "lgcmark.h"
+#include "lgcprof.h"
 #include "llex.h"
 #include "lmem.h"
 #include "lstate.h"
@@ -36,6 +39,14 @@
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
 #endif
 
+#if !defined(LUAI_GENMINORMUL)
+#define LUAI_GENMINORMUL	20  /* minor collection after 20% growth */
+#endif
+
+#if !defined(LUAI_GENMAJORMUL)
+#define LUAI_GENMAJORMUL	100  /* major collection after 100% growth */
+#endif
+
 
 /*
 ** a macro to help the creation of a unique random seed when a state is
@@ -193,6 +204,9 @@ static void init_registry (lua_State *L, global_State *g) {
   /* registry[LUA_RIDX_GLOBALS] = table of globals */
   sethvalue(L, &temp, luaH_new(L));  /* temp = new table (global table) */
   luaH_setint(L, registry, LUA_RIDX_GLOBALS, &temp);
+  /* registry[LUA_RIDX_KEYS] = table of pinned keys */
+  sethvalue(L, &temp, luaH_new(L));
+  luaH_setint(L, registry, LUA_RIDX_KEYS, &temp);
 }
 
 
@@ -242,12 +256,15 @@ static void preinit_thread (lua_State *L, global_State *g) {
 static void close_state (lua_State *L) {
   global_State *g = G(L);
   luaF_close(L, L->stack);  /* close all upvalues for this thread */
+  luaC_setprofile(L, LUA_GCPROFOFF);  /* no need to track what goes now */
   luaC_freeallobjects(L);  /* collect all objects */
   if (g->version)  /* closing a fully built state? */
     luai_userstateclose(L);
-  luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
-  freestack(L);
-  lua_assert(gettotalbytes(g) == sizeof(LG));
+  if (!g->bulkfree) {  /* else everything goes with the main block */
+    luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
+    freestack(L);
+    lua_assert(gettotalbytes(g) == sizeof(LG));
+  }
   (*g->frealloc)(g->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
 }
 
@@ -264,6 +281,8 @@ LUA_API lua_State *lua_newthread (lua_State *L) {
   /* link it on list 'allgc' */
   L1->next = g->allgc;
   g->allgc = obj2gco(L1);
+  if (luaC_tracking(g))
+    luaC_profalloc(L, obj2gco(L1));
   /* anchor it on L stack */
   setthvalue(L, L->top, L1);
   api_incr_top(L);
@@ -310,7 +329,12 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->mainthread = L;
   g->seed = makeseed(L);
   g->gcrunning = 0;  /* no GC while building state */
+  g->bulkfree = 0;
+  g->gcdefer = 0;
+  g->gcmarking = 0;
   g->GCestimate = 0;
+  g->GCmajorbase = 0;
+  g->GCminortime = 0;
   g->strt.size = g->strt.nuse = 0;
   g->strt.hash = NULL;
   setnilvalue(&g->l_registry);
@@ -323,11 +347,18 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->gray = g->grayagain = NULL;
   g->weak = g->ephemeron = g->allweak = NULL;
   g->twups = NULL;
+  g->marker = NULL;
+  g->freer = NULL;
+  g->profile = NULL;
+  g->ichits = g->icmisses = 0;
   g->totalbytes = sizeof(LG);
   g->GCdebt = 0;
+  g->GCparked = 0;
   g->gcfinnum = 0;
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
+  g->genminormul = LUAI_GENMINORMUL;
+  g->genmajormul = LUAI_GENMAJORMUL;
   for (i=0; i < LUA_NUMTAGS; i++) g->mt[i] = NULL;
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
     /* memory allocation error: free partial state */
@@ -340,6 +371,8 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
 
 LUA_API void lua_close (lua_State *L) {
   L = G(L)->mainthread;  /* only the main thread can be closed */
+  luaC_stopmarker(L);  /* before the lock, which goes with it */
+  luaC_stopfreer(L);  /* everything is freed inline from now on */
   lua_lock(L);
   close_state(L);
 }
@@ -31,6 +31,9 @@
 
 
 struct lua_longjmp;  /* defined in ldo.c */
+struct GCMarker;  /* defined in lgcmark.c */
+struct GCFreer;  /* defined in lgcfree.c */
+struct GCProfile;  /* defined in lgcprof.c */
 
 
 /*
@@ -53,6 +56,7 @@ struct lua_longjmp;  /* defined in ldo.c */
 /* kinds of Garbage Collection */
 #define KGC_NORMAL	0
 #define KGC_EMERGENCY	1	/* gc was forced by an allocation failure */
+#define KGC_GEN		2	/* generational collection */
 
 
 typedef struct stringtable {
@@ -121,8 +125,11 @@ typedef struct global_State {
   void *ud;         /* auxiliary data to 'frealloc' */
   l_mem totalbytes;  /* number of bytes currently allocated - GCdebt */
   l_mem GCdebt;  /* bytes allocated not yet compensated by the collector */
+  l_mem GCparked;  /* debt set aside while steps are deferred */
   lu_mem GCmemtrav;  /* memory traversed by the GC */
   lu_mem GCestimate;  /* an estimate of the non-garbage memory in use */
+  lu_mem GCmajorbase;  /* memory in use after last major collection */
+  lu_mem GCminortime;  /* duration of the last minor collection, in us */
   stringtable strt;  /* hash table for strings */
   TValue l_registry;
   unsigned int seed;  /* randomized seed for hashes */
@@ -130,6 +137,9 @@ typedef struct global_State {
   lu_byte gcstate;  /* state of garbage collector */
   lu_byte gckind;  /* kind of GC running */
   lu_byte gcrunning;  /* true if GC is running */
+  lu_byte bulkfree;  /* true if closing the state frees all memory at once */
+  lu_byte gcdefer;  /* true if debt should not trigger GC steps */
+  lu_byte gcmarking;  /* true while the marker thread traverses objects */
   GCObject *allgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* current position of sweep in list */
   GCObject *finobj;  /* list of collectable objects with finalizers */
@@ -141,9 +151,16 @@ typedef struct global_State {
   GCObject *tobefnz;  /* list of userdata to be GC */
   GCObject *fixedgc;  /* list of objects not to be collected */
   struct lua_State *twups;  /* list of threads with open upvalues */
+  struct GCMarker *marker;  /* concurrent marking thread, if any */
+  struct GCFreer *freer;  /* background free thread, if any */
+  struct GCProfile *profile;  /* collector profile, if enabled */
+  lu_mem ichits;  /* field accesses served by an inline cache (if counted) */
+  lu_mem icmisses;  /* field accesses that had to refill one */
   unsigned int gcfinnum;  /* number of finalizers to call in each GC step */
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC 'granularity' */
+  int genminormul;  /* control for minor generational collections */
+  int genmajormul;  /* control for major generational collections */
   lua_CFunction panic;  /* to be called in unprotected errors */
   struct lua_State *mainthread;
   const lua_Number *version;  /* pointer to version number */
@@ -25,14 +25,6 @@
 #define MEMERRMSG       "not enough memory"
 
 
-/*
-** Lua will use at most ~(2^LUAI_HASHLIMIT) bytes from a string to
-** compute its hash
-*/
-#if !defined(LUAI_HASHLIMIT)
-#define LUAI_HASHLIMIT		5
-#endif
-
 
 /*
 ** equality for long strings
@@ -46,14 +38,90 @@ int luaS_eqlngstr (TString *a, TString *b) {
 }
 
 
+/*
+** {======================================================
+** String hash
+** =======================================================
+*/
+
+#define HPRIME1		0x9e3779b1u
+#define HPRIME2		0x85ebca77u
+#define HPRIME3		0xc2b2ae3du
+
+#define rotl32(x,n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+/* feed word 'w' into hash lane 'h' */
+#define hround(h,w,p,n)	((h) = rotl32(((h) ^ (w)) * (p), n))
+
+
+/* 4 bytes from 'p', in machine order (any order will do) */
+static unsigned int read32 (const char *p) {
+  unsigned int w = 0;
+  memcpy(&w, p, 4);
+  return w;
+}
+
+
+#if defined(LLONG_MAX)
+/* 64-bit product of 'x' and 'y', folded back to 32 bits */
+static unsigned int mulfold (unsigned int x, unsigned int y) {
+  unsigned long long m = cast(unsigned long long, x) * y;
+  return cast(unsigned int, m >> 32) ^ cast(unsigned int, m);
+}
+#endif
+
+
+/*
+** Hashes every byte of the string, 8 at a time in two lanes, reading
+** unaligned words; the tail is the last 8 bytes of the string, which
+** may overlap the previous block (strings shorter than that get their
+** own reads). The seed goes into both lanes before the first word, and
+** each word is multiplied together with the running state, so which
+** strings collide depends on the seed. The final mix is the one from
+** MurmurHash3.
+*/
 unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
-  unsigned int h = seed ^ cast(unsigned int, l);
-  size_t step = (l >> LUAI_HASHLIMIT) + 1;
-  for (; l >= step; l -= step)
-    h ^= ((h<<5) + (h>>2) + cast_byte(str[l - 1]));
-  return h;
+  unsigned int a = seed ^ cast(unsigned int, l);
+  unsigned int b = rotl32(seed, 16) ^ HPRIME3;
+  if (l >= 8) {
+    const char *last = str + l - 8;
+    for (; str < last; str += 8) {
+      hround(a, read32(str), HPRIME1, 13);
+      hround(b, read32(str + 4), HPRIME2, 17);
+    }
+    hround(a, read32(last), HPRIME1, 13);
+    hround(b, read32(last + 4), HPRIME2, 17);
+  }
+  else {
+    unsigned int lo = 0, hi = 0;
+    if (l >= 4) {
+      lo = read32(str);
+      hi = read32(str + l - 4);
+    }
+    else if (l > 0)
+      lo = (cast(unsigned int, cast_byte(str[0])) << 16) |
+           (cast(unsigned int, cast_byte(str[l >> 1])) << 8) |
+           cast(unsigned int, cast_byte(str[l - 1]));
+#if defined(LLONG_MAX)
+    /* most keys are this short, so they skip the lanes and the final
+       mix: two dependent multiplies instead of four */
+    return mulfold(mulfold(a ^ lo ^ HPRIME1, b ^ hi) ^ seed, HPRIME2);
+#else
+    hround(a, lo, HPRIME1, 13);
+    hround(b, hi, HPRIME2, 17);
+#endif
+  }
+  a ^= rotl32(b, 15) * HPRIME3;
+  a ^= a >> 16;
+  a *= 0x85ebca6bu;
+  a ^= a >> 13;
+  a *= 0xc2b2ae35u;
+  a ^= a >> 16;
+  return a;
 }
 
+/* }====================================================== */
+
 
 unsigned int luaS_hashlongstr (TString *ts) {
   lua_assert(ts->tt == LUA_TLNGSTR);
@@ -171,7 +239,7 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
   TString **list = &g->strt.hash[lmod(h, g->strt.size)];
   lua_assert(str != NULL);  /* otherwise 'memcmp'/'memcpy' are undefined */
   for (ts = *list; ts != NULL; ts = ts->u.hnext) {
-    if (l == ts->shrlen &&
+    if (ts->hash == h && l == ts->shrlen &&
         (memcmp(str, getstr(ts), l * sizeof(char)) == 0)) {
       /* found! */
       if (isdead(g, ts))  /* dead (but not collected yet)? */
@@ -180,7 +248,8 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
     }
   }
   if (g->strt.nuse >= g->strt.size && g->strt.size <= MAX_INT/2) {
-    luaS_resize(L, g->strt.size * 2);
+    int size = g->strt.size;
+    luaS_resize(L, size < STRTABQUICKGROW ? size * 4 : size * 2);
     list = &g->strt.hash[lmod(h, g->strt.size)];  /* recompute with new size */
   }
   ts = createstrobj(L, l, LUA_TSHRSTR, h);
@@ -211,11 +211,14 @@ static int str_dump (lua_State *L) {
 #define CAP_POSITION	(-2)
 
 
+struct Pattern;
+
 typedef struct MatchState {
   const char *src_init;  /* init of source string */
   const char *src_end;  /* end ('\0') of source string */
   const char *p_end;  /* end ('\0') of pattern */
   lua_State *L;
+  const struct Pattern *pat;  /* compiled form of the pattern, if any */
   int matchdepth;  /* control for recursive depth (to avoid C stack overflow) */
   unsigned char level;  /* total number of captures (finished or unfinished) */
   struct {
@@ -255,19 +258,20 @@ static int capture_to_close (MatchState *ms) {
 }
 
 
-static const char *classend (MatchState *ms, const char *p) {
+/* end of the single char class at 'p', NULL if it is malformed */
+static const char *findclassend (const char *p, const char *p_end) {
   switch (*p++) {
     case L_ESC: {
-      if (p == ms->p_end)
-        luaL_error(ms->L, "malformed pattern (ends with '%%')");
+      if (p == p_end)
+        return NULL;  /* ends with '%' */
       return p+1;
     }
     case '[': {
       if (*p == '^') p++;
       do {  /* look for a ']' */
-        if (p == ms->p_end)
-          luaL_error(ms->L, "malformed pattern (missing ']')");
-        if (*(p++) == L_ESC && p < ms->p_end)
+        if (p == p_end)
+          return NULL;  /* missing ']' */
+        if (*(p++) == L_ESC && p < p_end)
           p++;  /* skip escapes (e.g. '%]') */
       } while (*p != ']');
       return p+1;
@@ -279,6 +283,18 @@ static const char *classend (MatchState *ms, const char *p) {
 }
 
 
+static const char *classend (MatchState *ms, const char *p) {
+  const char *ep = findclassend(p, ms->p_end);
+  if (ep == NULL) {
+    if (*p == L_ESC)
+      luaL_error(ms->L, "malformed pattern (ends with '%%')");
+    else
+      luaL_error(ms->L, "malformed pattern (missing ']')");
+  }
+  return ep;
+}
+
+
 static int match_class (int c, int cl) {
   int res;
   switch (tolower(cl)) {
@@ -338,14 +354,9 @@ static int singlematch (MatchState *ms, const char *s, const char *p,
 }
 
 
-static const char *matchbalance (MatchState *ms, const char *s,
-                                   const char *p) {
-  if (p >= ms->p_end - 1)
-    luaL_error(ms->L, "malformed pattern (missing arguments to '%%b')");
-  if (*s != *p) return NULL;
+static const char *balance (MatchState *ms, const char *s, int b, int e) {
+  if (*s != b) return NULL;
   else {
-    int b = *p;
-    int e = *(p+1);
     int cont = 1;
     while (++s < ms->src_end) {
       if (*s == e) {
@@ -358,6 +369,14 @@ static const char *matchbalance (MatchState *ms, const char *s,
 }
 
 
+static const char *matchbalance (MatchState *ms, const char *s,
+                                   const char *p) {
+  if (p >= ms->p_end - 1)
+    luaL_error(ms->L, "malformed pattern (missing arguments to '%%b')");
+  return balance(ms, s, *p, *(p+1));
+}
+
+
 static const char *max_expand (MatchState *ms, const char *s,
                                  const char *p, const char *ep) {
   ptrdiff_t i = 0;  /* counts maximum expand for item */
@@ -524,6 +543,475 @@ static const char *match (MatchState *ms, const char *s, const char *p) {
 }
 
 
+/*
+** {======================================================
+** Compiled patterns: a pattern is translated once into an array of
+** items (a class with its suffix, a capture, '%b', '%f', a back
+** reference or the final '$'), with every class turned into a bitmap
+** of the chars it accepts. 'cmatch' runs them with the same recursion
+** as 'match' runs the pattern text, so results, captures and the
+** "pattern too complex" limit are the same. The last patterns used
+** are kept compiled in a small LRU cache in the registry.
+** Patterns that are long or malformed are left to 'match' (which
+** raises any errors exactly where it used to).
+** =======================================================
+*/
+
+/* number of compiled patterns kept per state */
+#if !defined(LUA_PATCACHESIZE)
+#define LUA_PATCACHESIZE	16
+#endif
+
+#define MAXPLEN		96	/* longer patterns are not compiled */
+#define MAXPSETS	8	/* distinct classes in a compiled pattern */
+
+/* item opcodes */
+#define PI_CHAR		0	/* a single char, 'c' */
+#define PI_ANY		1	/* '.' */
+#define PI_SET		2	/* class or set, bitmap number 'c' */
+#define PI_OPEN		3	/* '(' */
+#define PI_POSITION	4	/* '()' */
+#define PI_CLOSE	5	/* ')' */
+#define PI_EOS		6	/* '$' at the end of the pattern */
+#define PI_BALANCE	7	/* '%bxy', x and y in 'c' and 'c2' */
+#define PI_FRONTIER	8	/* '%f[set]', bitmap number 'c' */
+#define PI_BACKREF	9	/* '%0'-'%9', digit in 'c' */
+#define PI_END		10
+
+typedef struct PItem {
+  unsigned char op;
+  unsigned char rep;  /* suffix of a class: 0, '*', '+', '-' or '?' */
+  unsigned char c, c2;
+} PItem;
+
+typedef struct Pattern {
+  int anchor;  /* pattern starts with '^' (not part of 'item') */
+  int nlit;  /* number of plain chars the pattern starts with */
+  char lit[MAXPLEN];  /* those chars */
+  unsigned char set[MAXPSETS][32];  /* bitmaps of the classes */
+  PItem item[MAXPLEN + 1];  /* items, ended by PI_END */
+} Pattern;
+
+#define testset(st,c)	((st)[(c) >> 3] & (1u << ((c) & 7)))
+
+
+/*
+** Adds the bitmap of the chars matching the class at 'p' (ending at
+** 'ep') to 'pt', sharing it with an earlier identical class. Returns
+** its number, or -1 if there are too many.
+*/
+static int addset (Pattern *pt, int *nsets, const char *p, const char *ep) {
+  unsigned char st[32];
+  int c, i;
+  memset(st, 0, sizeof(st));
+  for (c = 0; c <= UCHAR_MAX; c++) {
+    int in = (*p == '[') ? matchbracketclass(c, p, ep - 1)
+                         : match_class(c, uchar(*(p + 1)));
+    if (in) st[c >> 3] |= (unsigned char)(1u << (c & 7));
+  }
+  for (i = 0; i < *nsets; i++)
+    if (memcmp(pt->set[i], st, sizeof(st)) == 0) return i;
+  if (*nsets == MAXPSETS) return -1;
+  memcpy(pt->set[*nsets], st, sizeof(st));
+  return (*nsets)++;
+}
+
+
+/* the only char in bitmap 'st', or -1 if it has none or several */
+static int singlechar (const unsigned char *st) {
+  int c, res = -1;
+  for (c = 0; c <= UCHAR_MAX; c++) {
+    if (testset(st, c)) {
+      if (res >= 0) return -1;
+      res = c;
+    }
+  }
+  return res;
+}
+
+
+/*
+** Translates pattern 'p' into 'pt'; returns 0 if it cannot, because
+** it is malformed or uses too many classes. The decoding follows
+** 'match' case by case.
+*/
+static int compile (Pattern *pt, const char *p, size_t lp) {
+  const char *p_end = p + lp;
+  int n = 0, nsets = 0;
+  pt->anchor = (*p == '^');
+  if (pt->anchor) p++;
+  while (p < p_end) {
+    PItem *it = &pt->item[n++];
+    const char *ep;
+    it->rep = it->c = it->c2 = 0;
+    switch (*p) {
+      case '(': {
+        it->op = (*(p + 1) == ')') ? PI_POSITION : PI_OPEN;
+        p += (it->op == PI_POSITION) ? 2 : 1;
+        continue;
+      }
+      case ')': {
+        it->op = PI_CLOSE; p++;
+        continue;
+      }
+      case '$': {
+        if ((p + 1) != p_end) break;  /* not the last char: a class */
+        it->op = PI_EOS; p++;
+        continue;
+      }
+      case L_ESC: {
+        switch (*(p + 1)) {
+          case 'b': {
+            if (p + 2 >= p_end - 1) return 0;  /* missing arguments */
+            it->op = PI_BALANCE;
+            it->c = uchar(*(p + 2)); it->c2 = uchar(*(p + 3));
+            p += 4;
+            continue;
+          }
+          case 'f': {
+            int st;
+            p += 2;
+            if (*p != '[' || (ep = findclassend(p, p_end)) == NULL ||
+                (st = addset(pt, &nsets, p, ep)) < 0)
+              return 0;
+            it->op = PI_FRONTIER; it->c = (unsigned char)st;
+            p = ep;
+            continue;
+          }
+          case '0': case '1': case '2': case '3':
+          case '4': case '5': case '6': case '7':
+          case '8': case '9': {
+            it->op = PI_BACKREF; it->c = uchar(*(p + 1));
+            p += 2;
+            continue;
+          }
+          default: break;  /* a class */
+        }
+        break;
+      }
+      default: break;
+    }
+    /* single char class plus optional suffix */
+    if ((ep = findclassend(p, p_end)) == NULL) return 0;
+    if (*p == '.')
+      it->op = PI_ANY;
+    else if (*p != L_ESC && *p != '[') {
+      it->op = PI_CHAR; it->c = uchar(*p);
+    }
+    else {
+      int st = addset(pt, &nsets, p, ep);
+      int c;
+      if (st < 0) return 0;
+      if ((c = singlechar(pt->set[st])) >= 0) {  /* e.g. '%.' or '[x]' */
+        it->op = PI_CHAR; it->c = (unsigned char)c;
+        if (st == nsets - 1) nsets--;  /* bitmap not needed after all */
+      }
+      else {
+        it->op = PI_SET; it->c = (unsigned char)st;
+      }
+    }
+    if (ep < p_end &&
+        (*ep == '*' || *ep == '+' || *ep == '-' || *ep == '?')) {
+      it->rep = uchar(*ep);
+      ep++;
+    }
+    p = ep;
+  }
+  pt->item[n].op = PI_END;
+  for (n = 0; pt->item[n].op == PI_CHAR && pt->item[n].rep == 0; n++)
+    pt->lit[n] = (char)pt->item[n].c;
+  pt->nlit = n;
+  return 1;
+}
+
+
+static int singleitem (MatchState *ms, const char *s, const PItem *it) {
+  if (s >= ms->src_end)
+    return 0;
+  else {
+    int c = uchar(*s);
+    switch (it->op) {
+      case PI_ANY: return 1;
+      case PI_SET: return testset(ms->pat->set[it->c], c);
+      default: return (it->c == c);
+    }
+  }
+}
+
+
+static const char *cmatch (MatchState *ms, const char *s, const PItem *it);
+
+
+static const char *cmax_expand (MatchState *ms, const char *s,
+                                  const PItem *it) {
+  ptrdiff_t i = 0;  /* counts maximum expand for item */
+  while (singleitem(ms, s + i, it))
+    i++;
+  /* keeps trying to match with the maximum repetitions */
+  while (i>=0) {
+    const char *res = cmatch(ms, (s+i), it+1);
+    if (res) return res;
+    i--;  /* else didn't match; reduce 1 repetition to try again */
+  }
+  return NULL;
+}
+
+
+static const char *cmin_expand (MatchState *ms, const char *s,
+                                  const PItem *it) {
+  for (;;) {
+    const char *res = cmatch(ms, s, it+1);
+    if (res != NULL)
+      return res;
+    else if (singleitem(ms, s, it))
+      s++;  /* try with one more repetition */
+    else return NULL;
+  }
+}
+
+
+static const char *cstart_capture (MatchState *ms, const char *s,
+                                     const PItem *it, int what) {
+  const char *res;
+  int level = ms->level;
+  if (level >= LUA_MAXCAPTURES) luaL_error(ms->L, "too many captures");
+  ms->capture[level].init = s;
+  ms->capture[level].len = what;
+  ms->level = level+1;
+  if ((res=cmatch(ms, s, it)) == NULL)  /* match failed? */
+    ms->level--;  /* undo capture */
+  return res;
+}
+
+
+static const char *cend_capture (MatchState *ms, const char *s,
+                                   const PItem *it) {
+  int l = capture_to_close(ms);
+  const char *res;
+  ms->capture[l].len = s - ms->capture[l].init;  /* close capture */
+  if ((res = cmatch(ms, s, it)) == NULL)  /* match failed? */
+    ms->capture[l].len = CAP_UNFINISHED;  /* undo capture */
+  return res;
+}
+
+
+static const char *cmatch (MatchState *ms, const char *s, const PItem *it) {
+  if (ms->matchdepth-- == 0)
+    luaL_error(ms->L, "pattern too complex");
+  init: /* using goto's to optimize tail recursion */
+  switch (it->op) {
+    case PI_END: break;
+    case PI_OPEN: {
+      s = cstart_capture(ms, s, it + 1, CAP_UNFINISHED);
+      break;
+    }
+    case PI_POSITION: {
+      s = cstart_capture(ms, s, it + 1, CAP_POSITION);
+      break;
+    }
+    case PI_CLOSE: {
+      s = cend_capture(ms, s, it + 1);
+      break;
+    }
+    case PI_EOS: {
+      s = (s == ms->src_end) ? s : NULL;  /* check end of string */
+      break;
+    }
+    case PI_BALANCE: {
+      s = balance(ms, s, (char)it->c, (char)it->c2);
+      if (s != NULL) {
+        it++; goto init;
+      }
+      break;
+    }
+    case PI_FRONTIER: {
+      const unsigned char *st = ms->pat->set[it->c];
+      int previous = (s == ms->src_init) ? '\0' : uchar(*(s - 1));
+      if (!testset(st, previous) && testset(st, uchar(*s))) {
+        it++; goto init;
+      }
+      s = NULL;  /* match failed */
+      break;
+    }
+    case PI_BACKREF: {
+      s = match_capture(ms, s, it->c);
+      if (s != NULL) {
+        it++; goto init;
+      }
+      break;
+    }
+    default: {  /* single char class plus optional suffix */
+      if (!singleitem(ms, s, it)) {
+        if (it->rep == '*' || it->rep == '?' || it->rep == '-') {
+          it++; goto init;  /* accept empty */
+        }
+        else  /* '+' or no suffix */
+          s = NULL;  /* fail */
+      }
+      else {  /* matched once */
+        switch (it->rep) {
+          case '?': {  /* optional */
+            const char *res;
+            if ((res = cmatch(ms, s + 1, it + 1)) != NULL)
+              s = res;
+            else {
+              it++; goto init;
+            }
+            break;
+          }
+          case '+':  /* 1 or more repetitions */
+            s++;  /* 1 match already done */
+            /* FALLTHROUGH */
+          case '*':  /* 0 or more repetitions */
+            s = cmax_expand(ms, s, it);
+            break;
+          case '-':  /* 0 or more repetitions (minimum) */
+            s = cmin_expand(ms, s, it);
+            break;
+          default:  /* no suffix */
+            s++; it++; goto init;
+        }
+      }
+      break;
+    }
+  }
+  ms->matchdepth++;
+  return s;
+}
+
+
+/* matches at 's' with the compiled pattern if there is one */
+static const char *domatch (MatchState *ms, const char *s, const char *p) {
+  if (ms->pat != NULL)
+    return cmatch(ms, s, ms->pat->item);
+  else
+    return match(ms, s, p);
+}
+
+
+typedef struct CacheEntry {
+  size_t len;  /* length of 'src'; > MAXPLEN if the entry is empty */
+  unsigned int hash;
+  unsigned int stamp;  /* last use */
+  int ok;  /* whether 'src' compiled (failures are cached too) */
+  char src[MAXPLEN];
+  Pattern pt;
+} CacheEntry;
+
+typedef struct PatCache {
+  unsigned int clock;
+  char locale[64];  /* LC_CTYPE locale the entries were compiled under */
+  CacheEntry entry[LUA_PATCACHESIZE];
+} PatCache;
+
+/* key, in the registry, of the 'PatCache' */
+static const int PATCACHE = 0;
+
+
+static unsigned int hashpattern (const char *p, size_t l) {
+  unsigned int h = 2166136261u ^ (unsigned int)l;
+  for (; l > 0; l--)
+    h = (h ^ uchar(*p++)) * 16777619u;
+  return h;
+}
+
+
+/*
+** Returns the compiled form of pattern 'p', or NULL if it has none.
+** Without a cache (the library was not opened in this state) 'p' is
+** compiled into 'tmp'.
+*/
+static void clearpatcache (PatCache *pc) {
+  int i;
+  for (i = 0; i < LUA_PATCACHESIZE; i++) {
+    pc->entry[i].len = MAXPLEN + 1;  /* empty */
+    pc->entry[i].stamp = 0;
+  }
+}
+
+
+/*
+** Class bitmaps follow the LC_CTYPE locale of the moment they are built,
+** so entries are dropped whenever its name changes (through 'os.setlocale'
+** or from C). Returns 0 when the name is too long to remember, in which
+** case nothing is cached.
+*/
+static int checklocale (PatCache *pc) {
+  const char *loc = setlocale(LC_CTYPE, NULL);
+  size_t l;
+  if (loc == NULL)
+    return 0;
+  else if (strcmp(loc, pc->locale) == 0)
+    return 1;
+  else if ((l = strlen(loc)) >= sizeof(pc->locale))
+    return 0;
+  memcpy(pc->locale, loc, l + 1);
+  clearpatcache(pc);
+  return 1;
+}
+
+
+static const Pattern *getpattern (lua_State *L, const char *p, size_t lp,
+                                  Pattern *tmp) {
+  PatCache *pc;
+  CacheEntry *e, *victim;
+  unsigned int h;
+  int i;
+  if (lp > MAXPLEN) return NULL;
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &PATCACHE);
+  pc = (PatCache *)lua_touserdata(L, -1);
+  lua_pop(L, 1);  /* the registry keeps it alive */
+  if (pc == NULL || !checklocale(pc))
+    return compile(tmp, p, lp) ? tmp : NULL;
+  h = hashpattern(p, lp);
+  victim = &pc->entry[0];
+  for (i = 0; i < LUA_PATCACHESIZE; i++) {
+    e = &pc->entry[i];
+    if (e->hash == h && e->len == lp && memcmp(e->src, p, lp) == 0) {
+      e->stamp = ++pc->clock;
+      return e->ok ? &e->pt : NULL;
+    }
+    if (e->stamp < victim->stamp) victim = e;
+  }
+  e = victim;  /* least recently used */
+  e->len = lp;
+  e->hash = h;
+  e->stamp = ++pc->clock;
+  memcpy(e->src, p, lp);
+  e->ok = compile(&e->pt, p, lp);
+  return e->ok ? &e->pt : NULL;
+}
+
+
+static void createpatcache (lua_State *L) {
+  PatCache *pc = (PatCache *)lua_newuserdata(L, sizeof(PatCache));
+  pc->clock = 0;
+  pc->locale[0] = '\0';  /* set by the first lookup */
+  clearpatcache(pc);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &PATCACHE);
+}
+
+/* }====================================================== */
+
+
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STR_SSE2
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+#define firstbit(m)	__builtin_ctz(m)
+#else
+static int firstbit (unsigned int m) {
+  int i = 0;
+  while ((m & 1u) == 0) { m >>= 1; i++; }
+  return i;
+}
+#endif
+
+#endif
+
 
 static const char *lmemfind (const char *s1, size_t l1,
                                const char *s2, size_t l2) {
@@ -531,6 +1019,26 @@ static const char *lmemfind (const char *s1, size_t l1,
   else if (l2 > l1) return NULL;  /* avoids a negative 'l1' */
   else {
     const char *init;  /* to search for a '*s2' inside 's1' */
+#if defined(STR_SSE2)
+    /* test 16 starting positions at a time for both the first and the
+       last char of 's2'; only candidates passing both are compared */
+    if (l2 > 1) {
+      const __m128i first = _mm_set1_epi8(s2[0]);
+      const __m128i last = _mm_set1_epi8(s2[l2 - 1]);
+      for (; l1 >= l2 + 15; s1 += 16, l1 -= 16) {
+        __m128i f = _mm_loadu_si128((const __m128i *)s1);
+        __m128i e = _mm_loadu_si128((const __m128i *)(s1 + l2 - 1));
+        unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+                           _mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(e, last)));
+        for (; m != 0; m &= m - 1) {
+          const char *c = s1 + firstbit(m);
+          if (memcmp(c + 1, s2 + 1, l2 - 2) == 0)
+            return c;
+        }
+      }
+      if (l2 > l1) return NULL;
+    }
+#endif
     l2--;  /* 1st char will be checked by 'memchr' */
     l1 = l1-l2;  /* 's2' cannot be found after that */
     while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
@@ -591,6 +1099,7 @@ static int nospecials (const char *p, size_t l) {
 static void prepstate (MatchState *ms, lua_State *L,
                        const char *s, size_t ls, const char *p, size_t lp) {
   ms->L = L;
+  ms->pat = NULL;
   ms->matchdepth = MAXCCALLS;
   ms->src_init = s;
   ms->src_end = s + ls;
@@ -626,16 +1135,24 @@ static int str_find_aux (lua_State *L, int find) {
   }
   else {
     MatchState ms;
+    Pattern tmp;
+    const Pattern *pt = getpattern(L, p, lp, &tmp);
     const char *s1 = s + init - 1;
     int anchor = (*p == '^');
     if (anchor) {
       p++; lp--;  /* skip anchor character */
     }
     prepstate(&ms, L, s, ls, p, lp);
+    ms.pat = pt;
     do {
       const char *res;
+      if (pt != NULL && pt->nlit > 0 && !anchor) {
+        /* no match can start before the next copy of its plain prefix */
+        s1 = lmemfind(s1, ms.src_end - s1, pt->lit, pt->nlit);
+        if (s1 == NULL) break;
+      }
       reprepstate(&ms);
-      if ((res=match(&ms, s1, p)) != NULL) {
+      if ((res=domatch(&ms, s1, p)) != NULL) {
         if (find) {
           lua_pushinteger(L, (s1 - s) + 1);  /* start */
           lua_pushinteger(L, res - s);   /* end */
@@ -667,6 +1184,7 @@ typedef struct GMatchState {
   const char *p;  /* pattern */
   const char *lastmatch;  /* end of last match */
   MatchState ms;  /* match state */
+  Pattern pt;  /* compiled pattern, when 'ms.pat' is set */
 } GMatchState;
 
 
@@ -676,8 +1194,12 @@ static int gmatch_aux (lua_State *L) {
   gm->ms.L = L;
   for (src = gm->src; src <= gm->ms.src_end; src++) {
     const char *e;
+    if (gm->ms.pat != NULL && gm->pt.nlit > 0) {
+      src = lmemfind(src, gm->ms.src_end - src, gm->pt.lit, gm->pt.nlit);
+      if (src == NULL) break;
+    }
     reprepstate(&gm->ms);
-    if ((e = match(&gm->ms, src, gm->p)) != NULL && e != gm->lastmatch) {
+    if ((e = domatch(&gm->ms, src, gm->p)) != NULL && e != gm->lastmatch) {
       gm->src = gm->lastmatch = e;
       return push_captures(&gm->ms, src, e);
     }
@@ -691,10 +1213,17 @@ static int gmatch (lua_State *L) {
   const char *s = luaL_checklstring(L, 1, &ls);
   const char *p = luaL_checklstring(L, 2, &lp);
   GMatchState *gm;
+  const Pattern *pt;
   lua_settop(L, 2);  /* keep them on closure to avoid being collected */
   gm = (GMatchState *)lua_newuserdata(L, sizeof(GMatchState));
   prepstate(&gm->ms, L, s, ls, p, lp);
   gm->src = s; gm->p = p; gm->lastmatch = NULL;
+  /* a '^' is no anchor here, leave such patterns to 'match' */
+  pt = (*p == '^') ? NULL : getpattern(L, p, lp, &gm->pt);
+  if (pt != NULL) {  /* keep a copy, the cache may drop it */
+    if (pt != &gm->pt) gm->pt = *pt;
+    gm->ms.pat = &gm->pt;
+  }
   lua_pushcclosure(L, gmatch_aux, 3);
   return 1;
 }
@@ -769,19 +1298,36 @@ static int str_gsub (lua_State *L) {
   int anchor = (*p == '^');
   lua_Integer n = 0;  /* replacement count */
   MatchState ms;
+  Pattern tmp;
+  const Pattern *pt;
   luaL_Buffer b;
   luaL_argcheck(L, tr == LUA_TNUMBER || tr == LUA_TSTRING ||
                    tr == LUA_TFUNCTION || tr == LUA_TTABLE, 3,
                       "string/function/table expected");
+  pt = getpattern(L, p, lp, &tmp);
+  if (pt != NULL && pt != &tmp) {
+    /* replacements (and finalizers run while the buffer grows) may reuse
+       the cache entry, so work on a private copy */
+    tmp = *pt;
+    pt = &tmp;
+  }
   luaL_buffinit(L, &b);
   if (anchor) {
     p++; lp--;  /* skip anchor character */
   }
   prepstate(&ms, L, src, srcl, p, lp);
+  ms.pat = pt;
   while (n < max_s) {
     const char *e;
+    if (pt != NULL && pt->nlit > 0 && !anchor) {
+      /* copy everything up to the next copy of the plain prefix */
+      const char *q = lmemfind(src, ms.src_end - src, pt->lit, pt->nlit);
+      if (q == NULL) break;
+      luaL_addlstring(&b, src, q - src);
+      src = q;
+    }
     reprepstate(&ms);  /* (re)prepare state for new match */
-    if ((e = match(&ms, src, p)) != NULL && e != lastmatch) {  /* match? */
+    if ((e = domatch(&ms, src, p)) != NULL && e != lastmatch) {  /* match? */
       n++;
       add_value(&ms, &b, src, e, tr);  /* add replacement to buffer */
       src = lastmatch = e;
@@ -1577,6 +2123,7 @@ static void createmetatable (lua_State *L) {
 ** Open string library
 */
 LUAMOD_API int luaopen_string (lua_State *L) {
+  createpatcache(L);
   luaL_newlib(L, strlib);
   createmetatable(L);
   return 1;
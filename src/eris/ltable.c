@@ -110,6 +110,17 @@ static int l_hashfloat (lua_Number n) {
 #endif
 
 
+/*
+** hash for a vec2 key: a mix of the hashes of its components (which
+** are never negative, so neither is the result)
+*/
+static int l_hashvec2 (const float *v) {
+  unsigned int h = cast(unsigned int, l_hashfloat(cast_num(v[0])));
+  h = h * 31u + cast(unsigned int, l_hashfloat(cast_num(v[1])));
+  return cast_int(h & cast(unsigned int, INT_MAX));
+}
+
+
 /*
 ** returns the 'main' position of an element in a table (that is, the index
 ** of its hash value)
@@ -130,6 +141,8 @@ static Node *mainposition (const Table *t, const TValue *key) {
       return hashpointer(t, pvalue(key));
     case LUA_TLCF:
       return hashpointer(t, fvalue(key));
+    case LUA_TVEC2:
+      return hashmod(t, l_hashvec2(v2value(key)));
     default:
       lua_assert(!ttisdeadkey(key));
       return hashpointer(t, gcvalue(key));
@@ -452,6 +465,9 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
     else if (luai_numisnan(fltvalue(key)))
       luaG_runerror(L, "table index is NaN");
   }
+  else if (ttisvec2(key) && (luai_numisnan(v2value(key)[0]) ||
+                             luai_numisnan(v2value(key)[1])))
+    luaG_runerror(L, "table index is NaN");
   mp = mainposition(t, key);
   if (!ttisnil(gval(mp)) || isdummy(t)) {  /* main position is taken? */
     Node *othern;
@@ -522,7 +538,7 @@ const TValue *luaH_getshortstr (Table *t, TString *key) {
   lua_assert(key->tt == LUA_TSHRSTR);
   for (;;) {  /* check whether 'key' is somewhere in the chain */
     const TValue *k = gkey(n);
-    if (ttisshrstring(k) && eqshrstr(tsvalue(k), key))
+    if (keyisshrstr(k, key))
       return gval(n);  /* that's it */
     else {
       int nx = gnext(n);
@@ -534,6 +550,29 @@ const TValue *luaH_getshortstr (Table *t, TString *key) {
 }
 
 
+/*
+** 'luaH_getshortstr' that also points 'ic' at the key's slot, when the
+** key is present
+*/
+const TValue *luaH_getshortstrIC (Table *t, TString *key, ICache *ic) {
+  Node *n = hashstr(t, key);
+  lua_assert(key->tt == LUA_TSHRSTR);
+  for (;;) {
+    if (keyisshrstr(gkey(n), key)) {
+      ic->slot = cast(unsigned int, n - t->node);
+      ic->lsizenode = t->lsizenode;
+      return gval(n);
+    }
+    else {
+      int nx = gnext(n);
+      if (nx == 0)
+        return luaO_nilobject;  /* not found (and nothing to cache) */
+      n += nx;
+    }
+  }
+}
+
+
 /*
 ** "Generic" get version. (Not that generic: not valid for integers,
 ** which may be in array part, nor for floats with integral values.)
@@ -40,10 +40,39 @@
   (gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
 
 
+/*
+** Short strings are only equal to themselves. With NaN boxing that is
+** a comparison of the boxed words, which saves reading the type of each
+** key in the chain from its object.
+*/
+#if defined(LUA_NANBOXING)
+#define keyisshrstr(k,key)	(val_(k).u == nbbox(NBK_GC, obj2gco(key)))
+#else
+#define keyisshrstr(k,key)	(ttisshrstring(k) && eqshrstr(tsvalue(k), key))
+#endif
+
+
+/*
+** Inline cache of a field access with a constant short-string key: the
+** slot the key was last found in and the size of that table's node
+** array. Any table of the same size that holds the key in that slot is
+** a hit, so tables built the same way (objects from one constructor)
+** share the entry; everything else goes through 'luaH_getshortstrIC'.
+** A zeroed entry is valid: it can only hit where it is right.
+*/
+#define ichit(ic,t,key)  \
+	((t)->lsizenode == (ic)->lsizenode && \
+	 keyisshrstr(gkey(gnode(t, (ic)->slot)), key))
+
+#define icslot(ic,t)	gval(gnode(t, (ic)->slot))
+
+
 LUAI_FUNC const TValue *luaH_getint (Table *t, lua_Integer key);
 LUAI_FUNC void luaH_setint (lua_State *L, Table *t, lua_Integer key,
                                                     TValue *value);
 LUAI_FUNC const TValue *luaH_getshortstr (Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getshortstrIC (Table *t, TString *key,
+                                                      ICache *ic);
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key);
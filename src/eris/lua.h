@@ -70,8 +70,9 @@ typedef struct lua_State lua_State;
 #define LUA_TFUNCTION		6
 #define LUA_TUSERDATA		7
 #define LUA_TTHREAD		8
+#define LUA_TVEC2		9
 
-#define LUA_NUMTAGS		9
+#define LUA_NUMTAGS		10
 
 
 
@@ -82,7 +83,8 @@ typedef struct lua_State lua_State;
 /* predefined values in the registry */
 #define LUA_RIDX_MAINTHREAD	1
 #define LUA_RIDX_GLOBALS	2
-#define LUA_RIDX_LAST		LUA_RIDX_GLOBALS
+#define LUA_RIDX_KEYS		3
+#define LUA_RIDX_LAST		LUA_RIDX_KEYS
 
 
 /* type of numbers in Lua */
@@ -118,6 +120,12 @@ typedef const char * (*lua_Reader) (lua_State *L, void *ud, size_t *sz);
 typedef int (*lua_Writer) (lua_State *L, const void *p, size_t sz, void *ud);
 
 
+/*
+** Type for pinned keys (see 'lua_internkey')
+*/
+typedef const struct lua_PinnedKey *lua_Key;
+
+
 /*
 ** Type for memory-allocation functions
 */
@@ -187,6 +195,8 @@ LUA_API lua_CFunction   (lua_tocfunction) (lua_State *L, int idx);
 LUA_API void	       *(lua_touserdata) (lua_State *L, int idx);
 LUA_API lua_State      *(lua_tothread) (lua_State *L, int idx);
 LUA_API const void     *(lua_topointer) (lua_State *L, int idx);
+LUA_API int             (lua_tovec2) (lua_State *L, int idx,
+                                      lua_Number *x, lua_Number *y);
 
 
 /*
@@ -233,6 +243,7 @@ LUA_API void  (lua_pushcclosure) (lua_State *L, lua_CFunction fn, int n);
 LUA_API void  (lua_pushboolean) (lua_State *L, int b);
 LUA_API void  (lua_pushlightuserdata) (lua_State *L, void *p);
 LUA_API int   (lua_pushthread) (lua_State *L);
+LUA_API void  (lua_pushvec2) (lua_State *L, lua_Number x, lua_Number y);
 
 
 /*
@@ -266,6 +277,17 @@ LUA_API int   (lua_setmetatable) (lua_State *L, int objindex);
 LUA_API void  (lua_setuservalue) (lua_State *L, int idx);
 
 
+/*
+** pinned keys: strings interned once and kept alive as long as the
+** state, so that field access from C skips hashing and interning
+*/
+LUA_API lua_Key (lua_internkey) (lua_State *L, const char *k);
+LUA_API lua_Key (lua_tokey) (lua_State *L, int idx);
+LUA_API void  (lua_pushkey) (lua_State *L, lua_Key k);
+LUA_API int   (lua_getkey) (lua_State *L, int idx, lua_Key k);
+LUA_API void  (lua_setkey) (lua_State *L, int idx, lua_Key k);
+
+
 /*
 ** 'load' and 'call' functions (load and run Lua code)
 */
@@ -307,9 +329,85 @@ LUA_API int (lua_isyieldable) (lua_State *L);
 #define LUA_GCSTEP		5
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
+#define LUA_GCSETMAJORMUL	8
 #define LUA_GCISRUNNING		9
+#define LUA_GCGEN		10
+#define LUA_GCINC		11
+#define LUA_GCSETMINORMUL	12
+#define LUA_GCDEFER		13
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
+LUA_API int (lua_gcstepfor) (lua_State *L, int usec);
+LUA_API int (lua_setconcurrentmark) (lua_State *L, int on);
+
+/* statistics of the background free thread (see 'lua_setbackgroundfree') */
+typedef struct lua_FreeStats {
+  size_t blocks;  /* blocks handed to the free thread */
+  size_t bytes;  /* bytes handed to the free thread */
+  size_t batches;  /* number of hand-offs */
+  size_t direct;  /* blocks freed inline while the thread was behind */
+  size_t pending;  /* bytes handed over but not yet freed */
+  double freetime;  /* seconds spent freeing on the free thread */
+  double handofftime;  /* seconds the collector spent handing batches over */
+  int batchsize;  /* current batch size, in blocks */
+} lua_FreeStats;
+
+LUA_API int (lua_setbackgroundfree) (lua_State *L, int on);
+LUA_API int (lua_getfreestats) (lua_State *L, lua_FreeStats *st);
+
+
+/*
+** GC profiling: per-step durations by phase, and heap census
+*/
+#define LUA_GCPROFOFF		0
+#define LUA_GCPROFON		1
+#define LUA_GCPROFTRACK		2	/* also record allocation sites */
+#define LUA_GCPROFRESET		3
+
+/* collector phases */
+#define LUA_GCPPROPAGATE	0
+#define LUA_GCPATOMIC		1
+#define LUA_GCPSWEEP		2
+#define LUA_GCPFINALIZE		3
+#define LUA_GCPHASES		4
+
+/* bin 0 counts steps under 1us, bin i those under 2^i us */
+#define LUA_GCHISTBINS		16
+
+typedef struct lua_GCPhaseStats {
+  size_t steps;  /* steps that did work in this phase */
+  double total;  /* seconds spent in this phase */
+  double max;  /* longest step, in seconds */
+  size_t hist[LUA_GCHISTBINS];  /* steps by duration */
+} lua_GCPhaseStats;
+
+typedef struct lua_GCProfile {
+  lua_GCPhaseStats phase[LUA_GCPHASES];
+} lua_GCProfile;
+
+/* object kinds in a census */
+#define LUA_CENSUSTABLE		0
+#define LUA_CENSUSSTRING	1
+#define LUA_CENSUSLFUNC		2
+#define LUA_CENSUSCFUNC		3
+#define LUA_CENSUSUSERDATA	4
+#define LUA_CENSUSPROTO		5
+#define LUA_CENSUSTHREAD	6
+#define LUA_CENSUSKINDS		7
+
+typedef struct lua_HeapCensus {
+  size_t count[LUA_CENSUSKINDS];
+  size_t bytes[LUA_CENSUSKINDS];
+} lua_HeapCensus;
+
+/* called once per allocation site by 'lua_heapcensus' */
+typedef void (*lua_CensusSite) (void *ud, const char *site, size_t count,
+                                size_t bytes);
+
+LUA_API int (lua_gcprofile) (lua_State *L, int what);
+LUA_API int (lua_getgcprofile) (lua_State *L, lua_GCProfile *p);
+LUA_API void (lua_heapcensus) (lua_State *L, lua_HeapCensus *c,
+                               lua_CensusSite f, void *ud);
 
 
 /*
@@ -327,6 +425,14 @@ LUA_API size_t   (lua_stringtonumber) (lua_State *L, const char *s);
 
 LUA_API lua_Alloc (lua_getallocf) (lua_State *L, void **ud);
 LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
+LUA_API int       (lua_setbulkfree) (lua_State *L, int bulk);
+
+/*
+** 'lua_setbulkfree' checks with the allocator: 'f(ud, NULL, LUA_ALLOCBULK,
+** 0)' must return non-NULL only if freeing the state's main block gives
+** back all of its memory. Plain allocators treat it as 'free(NULL)'.
+*/
+#define LUA_ALLOCBULK	(~(size_t)0)
 
 
 
@@ -355,6 +461,7 @@ LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 #define lua_isnil(L,n)		(lua_type(L, (n)) == LUA_TNIL)
 #define lua_isboolean(L,n)	(lua_type(L, (n)) == LUA_TBOOLEAN)
 #define lua_isthread(L,n)	(lua_type(L, (n)) == LUA_TTHREAD)
+#define lua_isvec2(L,n)		(lua_type(L, (n)) == LUA_TVEC2)
 #define lua_isnone(L,n)		(lua_type(L, (n)) == LUA_TNONE)
 #define lua_isnoneornil(L, n)	(lua_type(L, (n)) <= 0)
 
@@ -437,6 +544,9 @@ LUA_API lua_Hook (lua_gethook) (lua_State *L);
 LUA_API int (lua_gethookmask) (lua_State *L);
 LUA_API int (lua_gethookcount) (lua_State *L);
 
+LUA_API void (lua_icstats) (lua_State *L, size_t *hits, size_t *misses,
+                                          int reset);
+
 
 struct lua_Debug {
   int event;
@@ -36,6 +36,20 @@
 /* #define LUA_32BITS */
 
 
+/*
+@@ LUA_NANBOXING packs every value into 8 bytes (instead of 16): floats
+** are stored as themselves and all other values inside NaNs. It needs
+** 'double' floats, 32-bit integers and user-space pointers that fit in
+** 48 bits (as on current x64 and AArch64 systems without pointer
+** tagging). Define it in the make file or here, so that everything
+** linked with Lua sees the same 'lua_Integer'. There is no room left
+** for the two floats of a vec2, so 'lua_pushvec2' (and 'vec2') raise
+** an error in this mode, as does 'lua_pushlightuserdata' for a pointer
+** with any of its top 16 bits set.
+*/
+/* #define LUA_NANBOXING */
+
+
 /*
 @@ LUA_USE_C89 controls the use of non-ISO-C89 features.
 ** Define it if you want Lua to avoid the use of a few C99 features
@@ -126,6 +140,13 @@
 #endif
 #define LUA_FLOAT_TYPE	LUA_FLOAT_FLOAT
 
+#elif defined(LUA_NANBOXING)	/* }{ */
+/*
+** 32-bit integers (to fit inside a NaN) and 'double'
+*/
+#define LUA_INT_TYPE	LUA_INT_INT
+#define LUA_FLOAT_TYPE	LUA_FLOAT_DOUBLE
+
 #elif defined(LUA_C89_NUMBERS)	/* }{ */
 /*
 ** largest types available for C89 ('long' and 'double')
@@ -152,6 +152,21 @@ static int forlimit (const TValue *obj, lua_Integer *p, lua_Integer step,
 }
 
 
+/*
+** Fields of a vec2: 'x' and 'y' are its components, anything else goes
+** to the metatable for vec2 values. Returns 1 if 'key' was one of them.
+*/
+static int v2field (const TValue *t, const TValue *key, StkId val) {
+  if (ttisshrstring(key) && tsvalue(key)->shrlen == 1) {
+    switch (getstr(tsvalue(key))[0]) {
+      case 'x': setfltvalue(val, cast_num(v2value(t)[0])); return 1;
+      case 'y': setfltvalue(val, cast_num(v2value(t)[1])); return 1;
+    }
+  }
+  return 0;
+}
+
+
 /*
 ** Finish the table access 'val = t[key]'.
 ** if 'slot' is NULL, 't' is not a table; otherwise, 'slot' points to
@@ -164,6 +179,8 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
   for (loop = 0; loop < MAXTAGLOOP; loop++) {
     if (slot == NULL) {  /* 't' is not a table? */
       lua_assert(!ttistable(t));
+      if (ttisvec2(t) && v2field(t, key, val))
+        return;
       tm = luaT_gettmbyobj(L, t, TM_INDEX);
       if (ttisnil(tm))
         luaG_typeerror(L, t, "index");  /* no metamethod */
@@ -424,6 +441,8 @@ int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_TLCF: return fvalue(t1) == fvalue(t2);
     case LUA_TSHRSTR: return eqshrstr(tsvalue(t1), tsvalue(t2));
     case LUA_TLNGSTR: return luaS_eqlngstr(tsvalue(t1), tsvalue(t2));
+    case LUA_TVEC2: return (v2value(t1)[0] == v2value(t2)[0] &&
+                            v2value(t1)[1] == v2value(t2)[1]);
     case LUA_TUSERDATA: {
       if (uvalue(t1) == uvalue(t2)) return 1;
       else if (L == NULL) return 0;
@@ -657,7 +676,7 @@ void luaV_finishOp (lua_State *L) {
   CallInfo *ci = L->ci;
   StkId base = ci->u.l.base;
   Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
-  OpCode op = GET_OPCODE(inst);
+  OpCode op = basicop(GET_OPCODE(inst));  /* (may have been quickened since) */
   switch (op) {  /* finish its execution */
     case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
     case OP_BAND: case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
@@ -746,6 +765,10 @@ void luaV_finishOp (lua_State *L) {
 
 #define Protect(x)	{ {x;}; base = ci->u.l.base; }
 
+/* vec2 arithmetic into 'ra'; cannot raise errors, so needs no 'Protect' */
+#define v2arith(op,b,c)  \
+	((ttisvec2(b) || ttisvec2(c)) && luaO_v2arith(op, b, c, ra))
+
 #define checkGC(L,c)  \
 	{ luaC_condGC(L, L->top = (c),  /* limit of live values */ \
                          Protect(L->top = ci->top));  /* restore top */ \
@@ -762,6 +785,20 @@ void luaV_finishOp (lua_State *L) {
   lua_assert(base <= L->top && L->top < L->stack + L->stacksize); \
 }
 
+/*
+** 'LUA_USE_JUMPTABLE' selects direct-threaded dispatch through a table of
+** label addresses (see ljumptab.h). It needs the GCC "labels as values"
+** extension, so by default it is only turned on for GCC-compatible
+** compilers; everything else uses the portable 'switch'.
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE	1
+#else
+#define LUA_USE_JUMPTABLE	0
+#endif
+#endif
+
 #define vmdispatch(o)	switch(o)
 #define vmcase(l)	case l:
 #define vmbreak		break
@@ -782,12 +819,136 @@ void luaV_finishOp (lua_State *L) {
     Protect(luaV_finishset(L,t,k,v,slot)); }
 
 
+/*
+** Per-instruction state of 'p' (see 'ICache'), allocated on first use
+*/
+static ICache *getic (lua_State *L, Proto *p) {
+  if (p->ic == NULL) {
+    ICache *ic = luaM_newvector(L, p->sizecode, ICache);
+    int n;
+    for (n = 0; n < p->sizecode; n++) {
+      ic[n].slot = 0;
+      ic[n].lsizenode = 0;
+      ic[n].deopts = 0;
+    }
+    p->ic = ic;
+  }
+  return p->ic;
+}
+
+
+/*
+** Inline caches. Accesses to a table with a constant short-string key
+** go through the cache of their instruction, so a hit costs two
+** compares instead of a hash and a chain walk.
+*/
+static const TValue *icmiss (lua_State *L, Proto *p, int pc, Table *h,
+                             TString *key) {
+  ICache *ic = getic(L, p);
+  G(L)->icmisses++;
+  return luaH_getshortstrIC(h, key, &ic[pc]);
+}
+
+
+/*
+** Hits are only counted when built with LUAI_ICSTATS: the count is a
+** store to shared state on the fast path of every field access.
+*/
+#if defined(LUAI_ICSTATS)
+#define countichit(L)	(G(L)->ichits++)
+#else
+#define countichit(L)	((void)0)
+#endif
+
+
+/* 'slot' gets the entry for 'h[key]' (which may be nil) */
+#define icget(L,h,key,slot) { \
+  int pc_ = pcRel(ci->u.l.savedpc, cl->p); \
+  ICache *ic_ = cl->p->ic; \
+  if (ic_ != NULL && ichit(ic_ + pc_, h, key)) { \
+    slot = icslot(ic_ + pc_, h); countichit(L); } \
+  else slot = icmiss(L, cl->p, pc_, h, key); }
+
+
+/* 'gettableProtected' for a constant key 'k' */
+#define gettableIC(L,t,k,v) { const TValue *slot; \
+  if (ttistable(t) && ttisshrstring(k)) { \
+    icget(L, hvalue(t), tsvalue(k), slot); \
+    if (!ttisnil(slot)) { setobj2s(L, v, slot); } \
+    else Protect(luaV_finishget(L,t,k,v,slot)); } \
+  else gettableProtected(L,t,k,v); }
+
+
+/* 'settableProtected' for a constant key 'k' */
+#define settableIC(L,t,k,v) { const TValue *slot; \
+  if (ttistable(t) && ttisshrstring(k)) { \
+    icget(L, hvalue(t), tsvalue(k), slot); \
+    if (!ttisnil(slot)) { \
+      luaC_barrierback(L, hvalue(t), v); \
+      setobj2t(L, cast(TValue *,slot), v); } \
+    else Protect(luaV_finishset(L,t,k,v,slot)); } \
+  else settableProtected(L,t,k,v); }
+
+
+/*
+** Quickening. A generic arithmetic or comparison instruction that finds
+** operands some quickened opcode covers (OP_ADDII etc.) rewrites itself
+** into that opcode, which then only has to check for those types. On
+** other operands the quickened instruction writes the generic opcode
+** back and does the operation the long way. After MAXDEOPTS such undos
+** an instruction stays generic, so sites that mix types stop flipping.
+** Code leaving the interpreter (dumps, Eris) is written with generic
+** opcodes only (see 'basicop').
+*/
+#define MAXDEOPTS	4
+
+/* operands for float arithmetic (what the FF forms cover) */
+#define isfltpair(a,b)  \
+	(ttisnumber(a) && ttisnumber(b) && !(ttisinteger(a) && ttisinteger(b)))
+
+static void deoptimize (lua_State *L, Proto *p, int pc) {
+  ICache *ic;
+  Instruction *i = &p->code[pc];
+  SET_OPCODE(*i, basicop(GET_OPCODE(*i)));
+  ic = getic(L, p);  /* (after the rewrite, as it may raise an error) */
+  if (ic[pc].deopts < MAXDEOPTS)
+    ic[pc].deopts++;
+}
+
+
+/* rewrite the current instruction into opcode 'o' */
+#define quicken(o) { \
+  int pc_ = pcRel(ci->u.l.savedpc, cl->p); \
+  if (cl->p->ic == NULL || cl->p->ic[pc_].deopts < MAXDEOPTS) \
+    SET_OPCODE(cl->p->code[pc_], o); }
+
+
+/* undo the current quickened instruction and do 'op' in full */
+#define deoptarith(op) { \
+  deoptimize(L, cl->p, pcRel(ci->u.l.savedpc, cl->p)); \
+  Protect(luaO_arith(L, op, rb, rc, ra)); }
+
+
+/* same for a comparison 'cmp', with the test and jump of OP_LT/OP_LE */
+#define deoptcmp(cmp) { \
+  deoptimize(L, cl->p, pcRel(ci->u.l.savedpc, cl->p)); \
+  Protect( \
+    if (cmp(L, rb, rc) != GETARG_A(i)) \
+      ci->u.l.savedpc++; \
+    else \
+      donextjump(ci); \
+  ) }
+
+
 
 void luaV_execute (lua_State *L) {
   CallInfo *ci = L->ci;
   LClosure *cl;
   TValue *k;
   StkId base;
+#if LUA_USE_JUMPTABLE
+#include "ljumptab.h"
+#endif
   ci->callstatus |= CIST_FRESH;  /* fresh invocation of 'luaV_execute" */
  newframe:  /* reentry point when frame changes (call/return) */
   lua_assert(ci == L->ci);
@@ -836,20 +997,23 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_GETTABUP) {
         TValue *upval = cl->upvals[GETARG_B(i)]->v;
         TValue *rc = RKC(i);
-        gettableProtected(L, upval, rc, ra);
+        if (ISK(GETARG_C(i))) gettableIC(L, upval, rc, ra)
+        else gettableProtected(L, upval, rc, ra);
         vmbreak;
       }
       vmcase(OP_GETTABLE) {
         StkId rb = RB(i);
         TValue *rc = RKC(i);
-        gettableProtected(L, rb, rc, ra);
+        if (ISK(GETARG_C(i))) gettableIC(L, rb, rc, ra)
+        else gettableProtected(L, rb, rc, ra);
         vmbreak;
       }
       vmcase(OP_SETTABUP) {
         TValue *upval = cl->upvals[GETARG_A(i)]->v;
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
-        settableProtected(L, upval, rb, rc);
+        if (ISK(GETARG_B(i))) settableIC(L, upval, rb, rc)
+        else settableProtected(L, upval, rb, rc);
         vmbreak;
       }
       vmcase(OP_SETUPVAL) {
@@ -861,7 +1025,8 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_SETTABLE) {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
-        settableProtected(L, ra, rb, rc);
+        if (ISK(GETARG_B(i))) settableIC(L, ra, rb, rc)
+        else settableProtected(L, ra, rb, rc);
         vmbreak;
       }
       vmcase(OP_NEWTABLE) {
@@ -875,15 +1040,10 @@ void luaV_execute (lua_State *L) {
         vmbreak;
       }
       vmcase(OP_SELF) {
-        const TValue *aux;
         StkId rb = RB(i);
-        TValue *rc = RKC(i);
-        TString *key = tsvalue(rc);  /* key must be a string */
+        TValue *rc = RKC(i);  /* key must be a string */
         setobjs2s(L, ra + 1, rb);
-        if (luaV_fastget(L, rb, key, aux, luaH_getstr)) {
-          setobj2s(L, ra, aux);
-        }
-        else Protect(luaV_finishget(L, rb, rc, ra, aux));
+        gettableIC(L, rb, rc, ra);
         vmbreak;
       }
       vmcase(OP_ADD) {
@@ -893,11 +1053,17 @@ void luaV_execute (lua_State *L) {
         if (ttisinteger(rb) && ttisinteger(rc)) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           setivalue(ra, intop(+, ib, ic));
+          quicken(OP_ADDII);
         }
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_numadd(L, nb, nc));
+          if (ttisnumber(rb) && ttisnumber(rc)) {
+            quicken(OP_ADDFF);
+          }
+        }
+        else if (!v2arith(LUA_OPADD, rb, rc)) {
+          Protect(luaT_trybinTM(L, rb, rc, ra, TM_ADD));
         }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_ADD)); }
         vmbreak;
       }
       vmcase(OP_SUB) {
@@ -907,11 +1073,17 @@ void luaV_execute (lua_State *L) {
         if (ttisinteger(rb) && ttisinteger(rc)) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           setivalue(ra, intop(-, ib, ic));
+          quicken(OP_SUBII);
         }
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_numsub(L, nb, nc));
+          if (ttisnumber(rb) && ttisnumber(rc)) {
+            quicken(OP_SUBFF);
+          }
+        }
+        else if (!v2arith(LUA_OPSUB, rb, rc)) {
+          Protect(luaT_trybinTM(L, rb, rc, ra, TM_SUB));
         }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_SUB)); }
         vmbreak;
       }
       vmcase(OP_MUL) {
@@ -921,11 +1093,17 @@ void luaV_execute (lua_State *L) {
         if (ttisinteger(rb) && ttisinteger(rc)) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           setivalue(ra, intop(*, ib, ic));
+          quicken(OP_MULII);
         }
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_nummul(L, nb, nc));
+          if (ttisnumber(rb) && ttisnumber(rc)) {
+            quicken(OP_MULFF);
+          }
+        }
+        else if (!v2arith(LUA_OPMUL, rb, rc)) {
+          Protect(luaT_trybinTM(L, rb, rc, ra, TM_MUL));
         }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_MUL)); }
         vmbreak;
       }
       vmcase(OP_DIV) {  /* float division (always with floats) */
@@ -934,8 +1112,13 @@ void luaV_execute (lua_State *L) {
         lua_Number nb; lua_Number nc;
         if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_numdiv(L, nb, nc));
+          if (ttisnumber(rb) && ttisnumber(rc)) {
+            quicken(OP_DIVFF);
+          }
+        }
+        else if (!v2arith(LUA_OPDIV, rb, rc)) {
+          Protect(luaT_trybinTM(L, rb, rc, ra, TM_DIV));
         }
-        else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_DIV)); }
         vmbreak;
       }
       vmcase(OP_BAND) {
@@ -1038,7 +1221,7 @@ void luaV_execute (lua_State *L) {
         else if (tonumber(rb, &nb)) {
           setfltvalue(ra, luai_numunm(L, nb));
         }
-        else {
+        else if (!v2arith(LUA_OPUNM, rb, rb)) {
           Protect(luaT_trybinTM(L, rb, rb, ra, TM_UNM));
         }
         vmbreak;
@@ -1093,8 +1276,16 @@ void luaV_execute (lua_State *L) {
         vmbreak;
       }
       vmcase(OP_LT) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          quicken(OP_LTII);
+        }
+        else if (isfltpair(rb, rc)) {
+          quicken(OP_LTFF);
+        }
         Protect(
-          if (luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i))
+          if (luaV_lessthan(L, rb, rc) != GETARG_A(i))
             ci->u.l.savedpc++;
           else
             donextjump(ci);
@@ -1102,8 +1293,16 @@ void luaV_execute (lua_State *L) {
         vmbreak;
       }
       vmcase(OP_LE) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          quicken(OP_LEII);
+        }
+        else if (isfltpair(rb, rc)) {
+          quicken(OP_LEFF);
+        }
         Protect(
-          if (luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i))
+          if (luaV_lessequal(L, rb, rc) != GETARG_A(i))
             ci->u.l.savedpc++;
           else
             donextjump(ci);
@@ -1314,6 +1513,144 @@ void luaV_execute (lua_State *L) {
         lua_assert(0);
         vmbreak;
       }
+      vmcase(OP_ADDII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(+, ib, ic));
+        }
+        else deoptarith(LUA_OPADD);
+        vmbreak;
+      }
+      vmcase(OP_ADDFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numadd(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else if (isfltpair(rb, rc)) {
+          setfltvalue(ra, luai_numadd(L, nvalue(rb), nvalue(rc)));
+        }
+        else deoptarith(LUA_OPADD);
+        vmbreak;
+      }
+      vmcase(OP_SUBII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(-, ib, ic));
+        }
+        else deoptarith(LUA_OPSUB);
+        vmbreak;
+      }
+      vmcase(OP_SUBFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numsub(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else if (isfltpair(rb, rc)) {
+          setfltvalue(ra, luai_numsub(L, nvalue(rb), nvalue(rc)));
+        }
+        else deoptarith(LUA_OPSUB);
+        vmbreak;
+      }
+      vmcase(OP_MULII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
+          setivalue(ra, intop(*, ib, ic));
+        }
+        else deoptarith(LUA_OPMUL);
+        vmbreak;
+      }
+      vmcase(OP_MULFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_nummul(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else if (isfltpair(rb, rc)) {
+          setfltvalue(ra, luai_nummul(L, nvalue(rb), nvalue(rc)));
+        }
+        else deoptarith(LUA_OPMUL);
+        vmbreak;
+      }
+      vmcase(OP_DIVFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numdiv(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else if (ttisnumber(rb) && ttisnumber(rc)) {
+          setfltvalue(ra, luai_numdiv(L, nvalue(rb), nvalue(rc)));
+        }
+        else deoptarith(LUA_OPDIV);
+        vmbreak;
+      }
+      vmcase(OP_LTII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          if ((ivalue(rb) < ivalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else deoptcmp(luaV_lessthan);
+        vmbreak;
+      }
+      vmcase(OP_LTFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          if (luai_numlt(fltvalue(rb), fltvalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else if (isfltpair(rb, rc)) {
+          if (LTnum(rb, rc) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else deoptcmp(luaV_lessthan);
+        vmbreak;
+      }
+      vmcase(OP_LEII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          if ((ivalue(rb) <= ivalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else deoptcmp(luaV_lessequal);
+        vmbreak;
+      }
+      vmcase(OP_LEFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          if (luai_numle(fltvalue(rb), fltvalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else if (isfltpair(rb, rc)) {
+          if (LEnum(rb, rc) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else deoptcmp(luaV_lessequal);
+        vmbreak;
+      }
     }
   }
 }
@@ -0,0 +1,213 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "SDL.h"
+
+#include "asserts.hpp"
+#include "frame_pacer.hpp"
+
+namespace graphics
+{
+	namespace
+	{
+		// Anything closer to the deadline than this is spun rather than slept.
+		const double spin_threshold_ms = 2.0;
+
+		// About 18 minutes of frames with input at 60Hz.
+		const size_t max_trace_samples = 65536;
+
+		double counter_to_ms(uint64_t ticks)
+		{
+			return static_cast<double>(ticks) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+		}
+
+		uint64_t ms_to_counter(double ms)
+		{
+			return static_cast<uint64_t>(ms * static_cast<double>(SDL_GetPerformanceFrequency()) / 1000.0);
+		}
+	}
+
+	FramePacer::FramePacer()
+		: vsync_(static_cast<int>(VSync::OFF)),
+		  refresh_rate_(60),
+		  target_fps_(0.0),
+		  limiter_enabled_(false),
+		  next_deadline_(0),
+		  lock_(),
+		  last_present_(0),
+		  stats_(),
+		  trace_enabled_(false),
+		  trace_(),
+		  trace_next_(0),
+		  trace_total_(0)
+	{
+	}
+
+	VSync FramePacer::setVSync(VSync mode)
+	{
+		int interval = 0;
+		switch(mode) {
+			case VSync::OFF:		interval = 0; break;
+			case VSync::ON:			interval = 1; break;
+			case VSync::ADAPTIVE:	interval = -1; break;
+		}
+		if(SDL_GL_SetSwapInterval(interval) != 0) {
+			if(mode == VSync::ADAPTIVE) {
+				LOG_WARN("Adaptive vsync not supported, falling back to vsync: {}", SDL_GetError());
+				return setVSync(VSync::ON);
+			}
+			LOG_ERROR("Unable to set swap interval {}: {}", interval, SDL_GetError());
+			mode = SDL_GL_GetSwapInterval() == 0 ? VSync::OFF : VSync::ON;
+		}
+		vsync_ = static_cast<int>(mode);
+		return mode;
+	}
+
+	void FramePacer::setRefreshRate(int hz)
+	{
+		refresh_rate_ = hz > 0 ? hz : 60;
+	}
+
+	void FramePacer::setTargetFps(double fps)
+	{
+		target_fps_ = std::max(fps, 0.0);
+	}
+
+	float FramePacer::targetIntervalMs() const
+	{
+		// With vsync on we can't present faster than the display, whatever the limiter says.
+		const double target = target_fps_;
+		const int refresh = refresh_rate_;
+		double fps = target > 0.0 ? target : refresh;
+		if(getVSync() != VSync::OFF) {
+			fps = std::min(fps, static_cast<double>(refresh));
+		}
+		return static_cast<float>(1000.0 / fps);
+	}
+
+	void FramePacer::limit()
+	{
+		if(!limiter_enabled_) {
+			next_deadline_ = 0;
+			return;
+		}
+		const uint64_t interval = ms_to_counter(targetIntervalMs());
+		uint64_t now = SDL_GetPerformanceCounter();
+		if(next_deadline_ == 0 || now > next_deadline_ + interval) {
+			// first frame, or we're more than a frame behind. Don't try and catch up, that just
+			// produces a burst of unpaced frames.
+			next_deadline_ = now + interval;
+			return;
+		}
+		for(;;) {
+			const double remaining = counter_to_ms(next_deadline_ > now ? next_deadline_ - now : 0);
+			if(remaining <= 0.0) {
+				break;
+			}
+			if(remaining > spin_threshold_ms) {
+				SDL_Delay(static_cast<Uint32>(remaining - spin_threshold_ms));
+			}
+			now = SDL_GetPerformanceCounter();
+		}
+		next_deadline_ += interval;
+	}
+
+	double FramePacer::idleTimeMs() const
+	{
+		const uint64_t now = SDL_GetPerformanceCounter();
+		if(!limiter_enabled_ || next_deadline_ <= now) {
+			return 0.0;
+		}
+		return counter_to_ms(next_deadline_ - now);
+	}
+
+	void FramePacer::presented(uint64_t input_time, uint64_t now)
+	{
+		const float target = targetIntervalMs();
+		std::lock_guard<std::mutex> lk(lock_);
+		stats_.target_ms = target;
+		if(last_present_ != 0) {
+			stats_.interval_ms = static_cast<float>(counter_to_ms(now - last_present_));
+			if(stats_.interval_ms > target * 1.5f) {
+				++stats_.late_frames;
+			}
+		}
+		last_present_ = now;
+		++stats_.frames;
+
+		if(input_time != 0 && input_time <= now) {
+			const float ms = static_cast<float>(counter_to_ms(now - input_time));
+			stats_.input_last_ms = ms;
+			stats_.input_avg_ms = stats_.input_samples == 0 ? ms : stats_.input_avg_ms + (ms - stats_.input_avg_ms) * 0.05f;
+			stats_.input_max_ms = std::max(stats_.input_max_ms, ms);
+			++stats_.input_samples;
+			if(trace_enabled_) {
+				if(trace_.size() < max_trace_samples) {
+					trace_.emplace_back(ms);
+				} else {
+					trace_[trace_next_] = ms;
+				}
+				trace_next_ = (trace_next_ + 1) % max_trace_samples;
+				++trace_total_;
+			}
+		}
+	}
+
+	void FramePacer::setLatencyTrace(bool en)
+	{
+		if(!en && trace_enabled_) {
+			logLatencySummary();
+		}
+		std::lock_guard<std::mutex> lk(lock_);
+		trace_enabled_ = en;
+		trace_.clear();
+		trace_next_ = 0;
+		trace_total_ = 0;
+	}
+
+	void FramePacer::logLatencySummary()
+	{
+		std::vector<float> samples;
+		uint64_t total = 0;
+		{
+			std::lock_guard<std::mutex> lk(lock_);
+			samples = trace_;
+			total = trace_total_;
+		}
+		if(samples.empty()) {
+			LOG_INFO("Input latency trace: no samples");
+			return;
+		}
+		std::sort(samples.begin(), samples.end());
+		auto pct = [&samples](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+		LOG_INFO("Input latency trace: last {} of {} samples, min {:.2f}ms, p50 {:.2f}ms, p95 {:.2f}ms, p99 {:.2f}ms, max {:.2f}ms", 
+			samples.size(), total, samples.front(), pct(0.5), pct(0.95), pct(0.99), samples.back());
+	}
+
+	PacingStats FramePacer::getStats()
+	{
+		std::lock_guard<std::mutex> lk(lock_);
+		return stats_;
+	}
+}
@@ -0,0 +1,114 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace graphics
+{
+	enum class VSync
+	{
+		OFF,
+		ON,
+		// Waits for vblank if the frame is on time, swaps immediately (tearing) if it's late.
+		ADAPTIVE,
+	};
+
+	struct PacingStats
+	{
+		PacingStats() : frames(0), late_frames(0), interval_ms(0.0f), target_ms(0.0f), input_samples(0), input_last_ms(0.0f), input_avg_ms(0.0f), input_max_ms(0.0f) {}
+		uint64_t frames;
+		uint64_t late_frames;		//!< Presents that came more than half an interval after they should have.
+		float interval_ms;			//!< Time between the last two presents.
+		float target_ms;			//!< Expected present interval, from the refresh rate or frame limit.
+		uint64_t input_samples;		//!< Frames that had input to measure latency from.
+		float input_last_ms;		//!< Input event to swap returning, for the last frame with input.
+		float input_avg_ms;
+		float input_max_ms;
+	};
+
+	// Frame pacing: swap interval selection, a frame limiter for when nothing else is throttling
+	// the main loop, late frame detection and (optionally) an input-to-present latency trace.
+	//
+	// setVSync() talks to the GL context so must be called on the thread that owns it. limit() is
+	// for the simulation thread and presented() for whichever thread swaps, everything else may be
+	// called from anywhere.
+	class FramePacer
+	{
+	public:
+		FramePacer();
+
+		// Returns the mode that was actually applied, adaptive falls back to ON if the driver
+		// doesn't support late swap tearing.
+		VSync setVSync(VSync mode);
+		VSync getVSync() const { return static_cast<VSync>(vsync_.load()); }
+
+		void setRefreshRate(int hz);
+		// Caps the rate limit() lets frames through at, 0 means use the refresh rate.
+		void setTargetFps(double fps);
+		void setLimiterEnabled(bool en) { limiter_enabled_ = en; }
+		bool isLimiterEnabled() const { return limiter_enabled_; }
+
+		// Blocks until the next frame is due. Sleeps for most of the wait and spins for the last
+		// couple of milliseconds since OS sleeps routinely overshoot by about that much.
+		void limit();
+		// Time left before limit() lets the next frame through, i.e. how long this thread would
+		// otherwise sit idle. 0 when the limiter is off (or the frame is already late).
+		double idleTimeMs() const;
+
+		// Called right after the swap returns. 'input_time' is the performance counter value of the
+		// oldest input event that fed into the frame, or 0 if there wasn't one.
+		void presented(uint64_t input_time, uint64_t now);
+
+		// When enabled input-to-present samples are kept, up to the last 'max_trace_samples' of them,
+		// a summary is logged when it's turned off.
+		void setLatencyTrace(bool en);
+		bool isLatencyTraceEnabled() const { return trace_enabled_; }
+		void logLatencySummary();
+
+		PacingStats getStats();
+	private:
+		float targetIntervalMs() const;
+
+		std::atomic<int> vsync_;
+		// read by presented() on the swapping thread.
+		std::atomic<int> refresh_rate_;
+		std::atomic<double> target_fps_;
+		std::atomic<bool> limiter_enabled_;
+		uint64_t next_deadline_;
+
+		std::mutex lock_;
+		uint64_t last_present_;
+		PacingStats stats_;
+		std::atomic<bool> trace_enabled_;
+		// Ring buffer, once full 'trace_next_' is the oldest sample and gets overwritten first.
+		std::vector<float> trace_;
+		size_t trace_next_;
+		uint64_t trace_total_;
+
+		FramePacer(const FramePacer&) = delete;
+		FramePacer& operator=(const FramePacer&) = delete;
+	};
+}
@@ -0,0 +1,255 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+
+#include "asserts.hpp"
+#include "job_system.hpp"
+
+namespace jobs
+{
+	namespace
+	{
+		// which worker the current thread is, and of which job system.
+		thread_local const JobSystem* tls_owner = nullptr;
+		thread_local int tls_index = -1;
+
+		uint64_t now_ns()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+	}
+
+	JobSystem::JobSystem(int num_workers)
+		: queues_(),
+		  threads_(),
+		  running_(true),
+		  queued_(0),
+		  sleep_lock_(),
+		  sleep_cv_(),
+		  stats_(),
+		  last_sample_ns_(now_ns())
+	{
+		if(num_workers < 0) {
+			const int hw = static_cast<int>(std::thread::hardware_concurrency());
+			num_workers = std::max(hw - 1, 0);
+		}
+		for(int n = 0; n != num_workers + 1; ++n) {
+			queues_.emplace_back(new WorkerQueue());
+		}
+		stats_.resize(queues_.size());
+
+		tls_owner = this;
+		tls_index = 0;
+		for(int n = 1; n <= num_workers; ++n) {
+			threads_.emplace_back(&JobSystem::workerMain, this, n);
+		}
+		LOG_INFO("Job system started with {} worker threads", num_workers);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lk(sleep_lock_);
+			running_ = false;
+		}
+		sleep_cv_.notify_all();
+		for(auto& t : threads_) {
+			t.join();
+		}
+		if(tls_owner == this) {
+			tls_owner = nullptr;
+			tls_index = -1;
+		}
+	}
+
+	int JobSystem::currentIndex() const
+	{
+		return tls_owner == this ? tls_index : -1;
+	}
+
+	void JobSystem::push(Job job)
+	{
+		// Threads that aren't part of the system feed the main thread's queue, the workers will steal from it.
+		const int index = std::max(currentIndex(), 0);
+		{
+			std::lock_guard<std::mutex> lk(queues_[index]->lock);
+			queues_[index]->jobs.emplace_back(std::move(job));
+		}
+		{
+			std::lock_guard<std::mutex> lk(sleep_lock_);
+			++queued_;
+		}
+		sleep_cv_.notify_one();
+	}
+
+	bool JobSystem::pop(int index, Job* job)
+	{
+		WorkerQueue& q = *queues_[index];
+		std::lock_guard<std::mutex> lk(q.lock);
+		if(q.jobs.empty()) {
+			return false;
+		}
+		*job = std::move(q.jobs.back());
+		q.jobs.pop_back();
+		--queued_;
+		return true;
+	}
+
+	bool JobSystem::steal(int index, Job* job)
+	{
+		const int count = numThreads();
+		for(int n = 1; n != count; ++n) {
+			WorkerQueue& q = *queues_[(index + n) % count];
+			std::unique_lock<std::mutex> lk(q.lock, std::try_to_lock);
+			if(!lk.owns_lock() || q.jobs.empty()) {
+				continue;
+			}
+			*job = std::move(q.jobs.front());
+			q.jobs.pop_front();
+			--queued_;
+			++queues_[index]->jobs_stolen;
+			return true;
+		}
+		return false;
+	}
+
+	bool JobSystem::runOne(int index)
+	{
+		Job job;
+		if(!pop(index, &job) && !steal(index, &job)) {
+			return false;
+		}
+		execute(index, job);
+		return true;
+	}
+
+	void JobSystem::execute(int index, Job& job)
+	{
+		WorkerQueue& q = *queues_[index];
+		const uint64_t start = now_ns();
+		job.fn();
+		q.busy_ns += now_ns() - start;
+		++q.jobs_run;
+		finish(job.counter);
+	}
+
+	void JobSystem::finish(Counter* counter)
+	{
+		if(counter == nullptr) {
+			return;
+		}
+		std::vector<Counter::Continuation> ready;
+		{
+			// Decremented under the lock, wait() takes the same lock before returning so the counter
+			// can't be destroyed while we're still touching it.
+			std::lock_guard<std::mutex> lk(counter->lock_);
+			if(counter->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+				return;
+			}
+			ready.swap(counter->continuations_);
+		}
+		for(auto& c : ready) {
+			push(Job{ std::move(c.fn), c.counter });
+		}
+	}
+
+	void JobSystem::run(JobFn fn, Counter* counter)
+	{
+		if(counter != nullptr) {
+			counter->pending_.fetch_add(1, std::memory_order_acq_rel);
+		}
+		push(Job{ std::move(fn), counter });
+	}
+
+	void JobSystem::runAfter(Counter* dependency, JobFn fn, Counter* counter)
+	{
+		if(counter != nullptr) {
+			counter->pending_.fetch_add(1, std::memory_order_acq_rel);
+		}
+		if(dependency != nullptr) {
+			// Checked under the lock so that we can't race the last job of 'dependency' finishing.
+			std::lock_guard<std::mutex> lk(dependency->lock_);
+			if(!dependency->isDone()) {
+				dependency->continuations_.push_back(Counter::Continuation{ std::move(fn), counter });
+				return;
+			}
+		}
+		push(Job{ std::move(fn), counter });
+	}
+
+	void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn, Counter* counter)
+	{
+		ASSERT_LOG(grain > 0, "parallelFor grain size must be non-zero: {}", grain);
+		Counter local;
+		Counter* c = counter != nullptr ? counter : &local;
+		for(size_t first = begin; first < end; first += grain) {
+			const size_t last = std::min(first + grain, end);
+			run([fn, first, last]() { fn(first, last); }, c);
+		}
+		if(counter == nullptr) {
+			wait(&local);
+		}
+	}
+
+	void JobSystem::wait(Counter* counter)
+	{
+		const int index = currentIndex();
+		while(!counter->isDone()) {
+			// Help out rather than block, if we aren't a worker then we can still steal from one.
+			if(!runOne(std::max(index, 0))) {
+				std::this_thread::yield();
+			}
+		}
+		std::lock_guard<std::mutex> lk(counter->lock_);
+	}
+
+	void JobSystem::workerMain(int index)
+	{
+		tls_owner = this;
+		tls_index = index;
+		while(running_) {
+			if(runOne(index)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lk(sleep_lock_);
+			sleep_cv_.wait(lk, [this]() { return !running_ || queued_ > 0; });
+		}
+	}
+
+	void JobSystem::sampleStats()
+	{
+		const uint64_t now = now_ns();
+		const uint64_t elapsed = std::max<uint64_t>(now - last_sample_ns_, 1);
+		last_sample_ns_ = now;
+		for(size_t n = 0; n != queues_.size(); ++n) {
+			WorkerQueue& q = *queues_[n];
+			const uint64_t busy = q.busy_ns.load();
+			stats_[n].utilization = std::min(static_cast<float>(busy - q.last_busy_ns) / static_cast<float>(elapsed), 1.0f);
+			stats_[n].jobs_run = q.jobs_run.load();
+			stats_[n].jobs_stolen = q.jobs_stolen.load();
+			q.last_busy_ns = busy;
+		}
+	}
+}
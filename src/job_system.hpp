@@ -0,0 +1,138 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jobs
+{
+	typedef std::function<void()> JobFn;
+
+	class JobSystem;
+
+	// Tracks a group of outstanding jobs. Jobs add themselves to the counter when they are
+	// submitted and remove themselves when they finish, a counter reaching zero releases any
+	// jobs that were scheduled to run after it.
+	class Counter
+	{
+	public:
+		Counter() : pending_(0), lock_(), continuations_() {}
+		bool isDone() const { return pending_.load(std::memory_order_acquire) == 0; }
+		int pending() const { return pending_.load(std::memory_order_acquire); }
+	private:
+		friend class JobSystem;
+		struct Continuation
+		{
+			JobFn fn;
+			Counter* counter;
+		};
+		std::atomic<int> pending_;
+		std::mutex lock_;
+		std::vector<Continuation> continuations_;
+
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+	};
+
+	struct WorkerStats
+	{
+		WorkerStats() : jobs_run(0), jobs_stolen(0), utilization(0.0f) {}
+		uint64_t jobs_run;
+		uint64_t jobs_stolen;
+		float utilization;		//!< Fraction of wall time spent running jobs between the last two calls to sampleStats().
+	};
+
+	// Work stealing scheduler. Every worker, plus the thread that created the JobSystem (which is
+	// treated as worker 0), owns a deque of jobs. Owners push and pop at the back of their own deque
+	// while idle workers steal from the front of someone else's, which keeps recently submitted
+	// (cache warm) work local and hands the oldest, usually biggest, chunks to thieves.
+	class JobSystem
+	{
+	public:
+		// num_workers < 0 means one worker per hardware thread, minus the calling thread.
+		explicit JobSystem(int num_workers=-1);
+		~JobSystem();
+
+		void run(JobFn fn, Counter* counter=nullptr);
+		// Runs fn once every job tracked by 'dependency' has finished.
+		void runAfter(Counter* dependency, JobFn fn, Counter* counter=nullptr);
+		// Splits [begin, end) into chunks of at most 'grain' elements, calling fn(first, last) for each.
+		// If no counter is given the call doesn't return until every chunk has been run.
+		void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn, Counter* counter=nullptr);
+
+		// Blocks until the counter reaches zero, running queued jobs in the mean time rather than sleeping.
+		void wait(Counter* counter);
+
+		// Number of threads that execute jobs, including the main thread.
+		int numThreads() const { return static_cast<int>(queues_.size()); }
+
+		// Updates the utilization figures, call once per frame (or at whatever rate the overlay refreshes).
+		void sampleStats();
+		const std::vector<WorkerStats>& getStats() const { return stats_; }
+	private:
+		struct Job
+		{
+			JobFn fn;
+			Counter* counter;
+		};
+		struct WorkerQueue
+		{
+			WorkerQueue() : lock(), jobs(), jobs_run(0), jobs_stolen(0), busy_ns(0), last_busy_ns(0) {}
+			std::mutex lock;
+			std::deque<Job> jobs;
+			std::atomic<uint64_t> jobs_run;
+			std::atomic<uint64_t> jobs_stolen;
+			std::atomic<uint64_t> busy_ns;
+			uint64_t last_busy_ns;
+		};
+
+		void push(Job job);
+		bool pop(int index, Job* job);
+		bool steal(int index, Job* job);
+		bool runOne(int index);
+		void execute(int index, Job& job);
+		void finish(Counter* counter);
+		void workerMain(int index);
+		int currentIndex() const;
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues_;
+		std::vector<std::thread> threads_;
+		std::atomic<bool> running_;
+		std::atomic<int> queued_;
+		std::mutex sleep_lock_;
+		std::condition_variable sleep_cv_;
+
+		std::vector<WorkerStats> stats_;
+		uint64_t last_sample_ns_;
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+	};
+}
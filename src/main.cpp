@@ -164,6 +164,8 @@ void sol_test()
 }
 */
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -182,6 +184,8 @@ void sol_test()
 #include "imgui_utils.hpp"
 #include "TextEditor.h"
 #include "object.hpp"
+#include "object_pool.hpp"
+#include "job_system.hpp"
 
 #include "spdlog/spdlog.h"
 #include "SDL.h"
@@ -393,6 +397,11 @@ public:
 		ImGui_ImplSdlGL3_Init(window_);
 		// need to do imgui font configuration before call xxx_NewFrame.
 		imgui_config_fonts();
+		// Draw data is copied into the frame snapshot and rendered from there, possibly on another
+		// thread, so we don't want ImGui::Render() issuing GL calls itself. Device objects are made
+		// up-front for the same reason, rather than lazily in the first NewFrame().
+		ImGui::GetIO().RenderDrawListsFn = nullptr;
+		ImGui_ImplSdlGL3_CreateDeviceObjects();
 
 		printAttributes();
 		printExtensions();
@@ -417,15 +426,14 @@ public:
 		}
 	}
 	void newFrame() {
-		clear();
 		ImGui_ImplSdlGL3_NewFrame(window_);
 	}
 	void swap() {
-		ImGui::Render();
-
 		ASSERT_LOG(window_ != nullptr, "Internal window was null");
 		SDL_GL_SwapWindow(window_);	
 	}
+	SDL_Window* getWindow() const { return window_; }
+	SDL_GLContext getContext() const { return context_; }
 	void setClearColor(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
 		glClearColor(r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f);
 	}
@@ -466,8 +474,9 @@ public:
 				if(log_window_events_) {
 					LOG_INFO("Window {} resized {}x{}", ev->window.windowID, ev->window.data1, ev->window.data2);
 				}
+				// n.b. no glViewport() here, the context may be owned by the render thread. The
+				// viewport is set from the frame snapshot when it's drawn.
 				SDL_GL_GetDrawableSize(window_, &actual_width_, &actual_height_);
-				glViewport(0, 0, actual_width_, actual_height_);
 				break;
 			case SDL_WINDOWEVENT_SIZE_CHANGED:
 				// we're handling the resized event rather than the changed event.
@@ -763,6 +772,7 @@ void show_text_editor(TextEditor *editor)
 }
 
 #include "geometry.hpp"
+#include "script_buffer.hpp"
 
 class DrawList;
 
@@ -866,8 +876,13 @@ public:
 	//const std::vector<DrawIndex>& getIndices() const { return indices_; }
 	// number 1 of the addSprite overloads -- most basic case
 	void addSprite(const graphics::Texture* tex, const point& loc, int width, int height, const rect& tr, uint32_t color = 0xffffffff);
+	// One sprite at each position, read straight out of a vec2 buffer filled in by a script.
+	void addSprites(const graphics::Texture* tex, game::BufferSpan<const glm::vec2> positions, int width, int height, const rect& tr, uint32_t color = 0xffffffff);
 
 	void clear() { draw_cmds_.clear(); }
+	// Hands the accumulated commands over (to a frame snapshot), taking the previous contents of
+	// 'cmds' in exchange so their storage gets re-used.
+	void swapCommands(std::unordered_map<unsigned, LocalCommand>& cmds) { draw_cmds_.swap(cmds); }
 
 	typedef std::unordered_map<unsigned, LocalCommand>::iterator iterator;
 	typedef std::unordered_map<unsigned, LocalCommand>::const_iterator const_iterator;
@@ -913,6 +928,16 @@ void DrawList::addSprite(const graphics::Texture* tex, const point& loc, int wid
 	}
 }
 
+void DrawList::addSprites(const graphics::Texture* tex, game::BufferSpan<const glm::vec2> positions, int width, int height, const rect& tr, uint32_t color)
+{
+	auto& cmd = draw_cmds_[tex->id()];
+	cmd.vertices.reserve(cmd.vertices.size() + positions.size() * 4);
+	cmd.indices.reserve(cmd.indices.size() + positions.size() * indicies_rect.size());
+	for(const auto& p : positions) {
+		addSprite(tex, point(static_cast<int>(p.x), static_cast<int>(p.y)), width, height, tr, color);
+	}
+}
+
 void game::Object::draw(DrawList* drawlist)
 {
 	ASSERT_LOG(!tex_rect_.empty(), "No rects defined for texture.");
@@ -920,18 +945,66 @@ void game::Object::draw(DrawList* drawlist)
 	drawlist->addSprite(tex_.get(), loc_, width_, height_, tr);
 }
 
+void game::Object::drawAt(DrawList* drawlist, const BufferSpan<const glm::vec2>& positions)
+{
+	ASSERT_LOG(!tex_rect_.empty(), "No rects defined for texture.");
+	drawlist->addSprites(tex_.get(), positions, width_, height_, tex_rect_[frame_]);
+}
+
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "frame_pacer.hpp"
+#include "render_thread.hpp"
+#include "script_gc_panel.hpp"
+#include "script_state.hpp"
+#include "transform_state.hpp"
+
 GLuint g_proj_matrix_loc = -1;
 int g_width = 0, g_height = 0;
 
-void render(const game::Object* obj, const DrawList* drawlist)
+// Everything the GL side needs to draw a frame. Filled in by the simulation and then only read by
+// whoever renders it, which may be the render thread.
+struct FrameSnapshot
 {
-	obj->getShader()->apply();
+	FrameSnapshot() : width(0), height(0), shader(nullptr), sprites(), imgui_lists(), imgui_list_count(0), imgui_display_size(), imgui_fb_scale(), input_time(0) {}
+	void captureImGui(const ImDrawData* dd) {
+		const ImGuiIO& io = ImGui::GetIO();
+		imgui_display_size = io.DisplaySize;
+		imgui_fb_scale = io.DisplayFramebufferScale;
+		imgui_list_count = dd != nullptr && dd->Valid ? dd->CmdListsCount : 0;
+		while(static_cast<int>(imgui_lists.size()) < imgui_list_count) {
+			imgui_lists.emplace_back(new ImDrawList());
+		}
+		// ImVector is shallow on copy, so the buffers are cloned by hand.
+		for(int n = 0; n != imgui_list_count; ++n) {
+			const ImDrawList* src = dd->CmdLists[n];
+			ImDrawList* dst = imgui_lists[n].get();
+			dst->CmdBuffer.resize(src->CmdBuffer.Size);
+			memcpy(dst->CmdBuffer.Data, src->CmdBuffer.Data, src->CmdBuffer.Size * sizeof(ImDrawCmd));
+			dst->IdxBuffer.resize(src->IdxBuffer.Size);
+			memcpy(dst->IdxBuffer.Data, src->IdxBuffer.Data, src->IdxBuffer.Size * sizeof(ImDrawIdx));
+			dst->VtxBuffer.resize(src->VtxBuffer.Size);
+			memcpy(dst->VtxBuffer.Data, src->VtxBuffer.Data, src->VtxBuffer.Size * sizeof(ImDrawVert));
+		}
+	}
+	int width;
+	int height;
+	const graphics::Shader* shader;
+	std::unordered_map<unsigned, LocalCommand> sprites;
+	std::vector<std::unique_ptr<ImDrawList>> imgui_lists;
+	int imgui_list_count;
+	ImVec2 imgui_display_size;
+	ImVec2 imgui_fb_scale;
+	uint64_t input_time;		//!< Performance counter value of the first input event handled this frame, 0 if none.
+};
 
-    glViewport(0, 0, (GLsizei)g_width, (GLsizei)g_height);
-	auto ortho_projection = glm::ortho(0.f, static_cast<float>(g_width), static_cast<float>(g_height), 0.f);
+void render(const FrameSnapshot& frame, const DrawList* drawlist)
+{
+	frame.shader->apply();
+
+    glViewport(0, 0, (GLsizei)frame.width, (GLsizei)frame.height);
+	auto ortho_projection = glm::ortho(0.f, static_cast<float>(frame.width), static_cast<float>(frame.height), 0.f);
     /*const float ortho_projection[4][4] =
     {
         { 2.0f/g_width, 0.0f,                   0.0f, 0.0f },
@@ -943,12 +1016,12 @@ void render(const game::Object* obj, const DrawList* drawlist)
 
 	//static GLuint color_id = obj->getShader()->getUniformId("u_color");
 	//glUniform4f(color_id, 1.0f, 1.0f, 1.0f, 1.0f);
-	static GLuint tex_id = obj->getShader()->getUniformId("u_tex");
+	static GLuint tex_id = frame.shader->getUniformId("u_tex");
 	glUniform1i(tex_id, 0);
 
 	glActiveTexture(GL_TEXTURE0);
 
-	for(const auto& item : *drawlist) {
+	for(const auto& item : frame.sprites) {
 		const auto& cmd = item.second;
 		glBindVertexArray(drawlist->getVertexArrayObj());
 		glBindBuffer(GL_ARRAY_BUFFER, drawlist->getVertexBufferObj());
@@ -973,6 +1046,28 @@ void render(const game::Object* obj, const DrawList* drawlist)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void render_frame(FrameSnapshot& frame, const DrawList* drawlist)
+{
+	glScissor(0, 0, frame.width, frame.height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	render(frame, drawlist);
+
+	std::vector<ImDrawList*> lists;
+	for(int n = 0; n != frame.imgui_list_count; ++n) {
+		lists.emplace_back(frame.imgui_lists[n].get());
+	}
+	ImDrawData dd;
+	dd.Valid = true;
+	dd.CmdLists = lists.data();
+	dd.CmdListsCount = frame.imgui_list_count;
+	for(auto dl : lists) {
+		dd.TotalVtxCount += dl->VtxBuffer.Size;
+		dd.TotalIdxCount += dl->IdxBuffer.Size;
+	}
+	ImGui_ImplSdlGL3_RenderDrawData(&dd, frame.imgui_display_size, frame.imgui_fb_scale);
+}
+
 
 int main(int argc, char* argv[])
 {
@@ -1023,26 +1118,137 @@ int main(int argc, char* argv[])
 	theme_imgui_default(true, 1.0f);
 
 	ImGui::FrameTimeHistogram frame_time;
+	game::ScriptGCPanel gc_panel;
+
+	jobs::JobSystem job_system;
 
 	TextEditor editor;
 	init_text_editor(&editor, "..\\data\\test1.lua");
 
-	game::ObjectPtr player = std::make_unique<game::Object>();
+	game::ObjectPool object_pool;
+	game::ObjectHandle player_handle = object_pool.spawn();
+	game::Object* player = object_pool.get(player_handle);
 	player->setTexture("..\\images\\image1.png");
 	player->attachShader(bshader);
 	// should this be as follows :-
 	// player->attachShader(bshader->clone());
 	DrawList drawlist;
 
-	int px = g_width / 2 - player->width() / 2;
-	int py = g_height / 2 - player->height() / 2;
+	// player speed in pixels per second.
+	const float player_speed = 300.0f;
+	game::TransformState transforms;
+	// Slots per interpolation job, a multiple of four as TransformState::interpolate() needs.
+	const size_t interpolate_grain = 1024;
+	// Sized up front to save a few reallocations, reset() grows it for slots spawned later on.
+	transforms.resize(object_pool.capacity());
+	transforms.reset(player_handle.index, static_cast<float>(g_width / 2 - player->width() / 2), static_cast<float>(g_height / 2 - player->height() / 2));
+
+	// --vsync=off|on|adaptive, --fps=<limit> and --latency-trace.
+	auto arg_value = [&args](const std::string& prefix) {
+		for(const auto& a : args) {
+			if(a.compare(0, prefix.size(), prefix) == 0) {
+				return a.substr(prefix.size());
+			}
+		}
+		return std::string();
+	};
+	// Numeric options fall back to 'def', with a warning, when they don't parse.
+	auto arg_number = [&arg_value](const std::string& prefix, double def) {
+		const std::string value = arg_value(prefix);
+		if(value.empty()) {
+			return def;
+		}
+		try {
+			size_t end = 0;
+			const double d = std::stod(value, &end);
+			if(end == value.size()) {
+				return d;
+			}
+		} catch(const std::exception&) {
+		}
+		LOG_WARN("Invalid value '{}' for {}, using {}", value, prefix, def);
+		return def;
+	};
+	graphics::FramePacer pacer;
+	SDL_DisplayMode display_mode;
+	if(SDL_GetWindowDisplayMode(wnd->getWindow(), &display_mode) == 0) {
+		pacer.setRefreshRate(display_mode.refresh_rate);
+	}
+	const std::string vsync_arg = arg_value("--vsync=");
+	pacer.setVSync(vsync_arg == "off" ? graphics::VSync::OFF : vsync_arg == "on" ? graphics::VSync::ON : graphics::VSync::ADAPTIVE);
+	pacer.setTargetFps(arg_number("--fps=", 0.0));
+	pacer.setLatencyTrace(std::find(args.cbegin(), args.cend(), "--latency-trace") != args.cend());
+
+	// --script=<file> runs a script whose update(dt) is called every fixed step. Its garbage is
+	// collected in the idle time after each frame is handed off, --no-idle-gc leaves it to the
+	// allocation debt instead. --gc-budget=<usec> caps the idle collection per frame.
+	// --concurrent-mark marks on a helper thread while we're outside of Lua (experimental).
+	// --background-free frees dead objects on a helper thread (experimental), it needs the system
+	// allocator, --script-alloc=system, rather than the default pool.
+	// --gc-track-sites profiles the collector and records allocation sites from the start, so the
+	// census in the Lua GC window covers objects created while loading the script.
+	// --script-cache=<dir> keeps the compiled script in an existing directory, so an unchanged
+	// script is loaded without parsing it again.
+	// --sprites=<n> gives the script a global 'sprites', a vec2 buffer of n positions laid out in a
+	// grid, and a copy of the player is drawn at each of them every frame. The script can move
+	// them, or replace 'sprites' with a vec2 buffer of its own.
+	game::ScriptState script(arg_value("--script-alloc=") != "system");
+	script.setIdleCollection(std::find(args.cbegin(), args.cend(), "--no-idle-gc") == args.cend());
+	if(std::find(args.cbegin(), args.cend(), "--concurrent-mark") != args.cend() && !script.setConcurrentMark(true)) {
+		LOG_WARN("Concurrent Lua marking isn't supported by this build, ignoring --concurrent-mark");
+	}
+	if(std::find(args.cbegin(), args.cend(), "--background-free") != args.cend() && !script.setBackgroundFree(true)) {
+		LOG_WARN("Background freeing needs --script-alloc=system and a Lua build with LUA_USE_BACKGROUNDFREE, ignoring --background-free");
+	}
+	if(std::find(args.cbegin(), args.cend(), "--gc-track-sites") != args.cend()) {
+		script.setGCProfile(true, true);
+	}
+	const int gc_budget_us = static_cast<int>(arg_number("--gc-budget=", 2000));
+	script.setChunkCache(arg_value("--script-cache="));
+	if(!arg_value("--sprites=").empty()) {
+		auto positions = script.newPositions("sprites", static_cast<size_t>(std::max(0.0, arg_number("--sprites=", 0))));
+		const int columns = std::max(1, g_width / std::max(1, player->width()));
+		for(size_t n = 0; n != positions.size(); ++n) {
+			positions[n] = glm::vec2(static_cast<float>(n % columns * player->width()), static_cast<float>(n / columns * player->height()));
+		}
+	}
+	if(!arg_value("--script=").empty()) {
+		script.runFile(arg_value("--script="));
+	}
+
+	// By default the GL context is handed to a render thread, so the simulation doesn't sit idle
+	// while we wait for vsync. --no-render-thread keeps everything serial on this thread.
+	FrameSnapshot serial_frame;
+	graphics::PresentLatency serial_latency;
+	std::unique_ptr<graphics::RenderThread<FrameSnapshot>> render_thread;
+	if(std::find(args.cbegin(), args.cend(), "--no-render-thread") == args.cend()) {
+		render_thread = std::make_unique<graphics::RenderThread<FrameSnapshot>>(wnd->getWindow(), wnd->getContext(), 
+			[&drawlist](FrameSnapshot& frame) { render_frame(frame, &drawlist); },
+			[&pacer](const FrameSnapshot& frame, uint64_t presented) { pacer.presented(frame.input_time, presented); });
+	}
+	// Once the swap is on another thread nothing throttles this loop except the limiter.
+	pacer.setLimiterEnabled(render_thread != nullptr || pacer.getVSync() == graphics::VSync::OFF);
+
+	// Input time of a snapshot the render thread dropped. Its input is only seen by the next frame that
+	// makes it to the screen, so latency is measured from there.
+	uint64_t dropped_input_time = 0;
 
 	SDL_Event ev;
 	bool running = true;
 	while(running) {
+		script.beginLatencyCritical();
+		uint64_t input_time = 0;
 		while(SDL_PollEvent(&ev)) {
 			ImGui_ImplSdlGL3_ProcessEvent(&ev);
 
+			if(input_time == 0 && (ev.type == SDL_KEYDOWN || ev.type == SDL_KEYUP || ev.type == SDL_MOUSEBUTTONDOWN 
+				|| ev.type == SDL_MOUSEBUTTONUP || ev.type == SDL_MOUSEMOTION || ev.type == SDL_TEXTINPUT)) {
+				// The event timestamp only has millisecond resolution, back-date the counter by
+				// however long the event sat in the queue.
+				const uint64_t queued_ms = SDL_GetTicks() - ev.common.timestamp;
+				input_time = SDL_GetPerformanceCounter() - queued_ms * SDL_GetPerformanceFrequency() / 1000;
+			}
+
 			const auto mod = SDL_GetModState();
 			//fmt::print("0x{:x}\n", ev.type);
 			if(ev.type == SDL_KEYUP) {
@@ -1064,19 +1270,6 @@ int main(int argc, char* argv[])
 				} else if (key == SDLK_BACKQUOTE) {
 					g_show_main_menu_bar = !g_show_main_menu_bar;
 				}
-			} else if (ev.type == SDL_KEYDOWN) {
-				const auto key = ev.key.keysym.sym;
-
-				if (key == SDLK_UP) {
-					py -= 10;
-				} else if (key == SDLK_DOWN) {
-					py += 10;
-				} else if (key == SDLK_LEFT) {
-					px -= 10;
-				} else if (key == SDLK_RIGHT) {
-					px += 10;
-				}
-
 			} else if(ev.type == SDL_WINDOWEVENT) {
 				running = wnd->handleWindowEvent(&ev);
 			}
@@ -1092,8 +1285,16 @@ int main(int argc, char* argv[])
         accumulator += frameTime;
 
         while(accumulator >= dt) {
-            //previousState = currentState;
-            //integrate(currentState, t, dt);
+			transforms.beginStep();
+			// movement is sampled from the held keys once per step, rather than applied per key event.
+			const Uint8* keys = SDL_GetKeyboardState(nullptr);
+			const float step = player_speed * static_cast<float>(dt);
+			const float dx = (keys[SDL_SCANCODE_RIGHT] ? step : 0.0f) - (keys[SDL_SCANCODE_LEFT] ? step : 0.0f);
+			const float dy = (keys[SDL_SCANCODE_DOWN] ? step : 0.0f) - (keys[SDL_SCANCODE_UP] ? step : 0.0f);
+			if(!ImGui::GetIO().WantCaptureKeyboard) {
+				transforms.translate(player_handle.index, dx, dy);
+			}
+			script.update(dt);
             t += dt;
             accumulator -= dt;
         }
@@ -1102,13 +1303,27 @@ int main(int argc, char* argv[])
 
 		frame_time.Update(static_cast<float>(frameTime));
 
-        //State state = currentState * alpha + previousState * ( 1.0 - alpha );
+		// Interpolation is split into chunks for the job system, this thread runs chunks too while
+		// it waits.
+		jobs::Counter interpolated;
+		job_system.parallelFor(0, transforms.size(), interpolate_grain, [&transforms, alpha](size_t first, size_t last) {
+			transforms.interpolate(static_cast<float>(alpha), first, last);
+		}, &interpolated);
+		job_system.wait(&interpolated);
 
 		wnd->newFrame();
 
-		player->setLocation(px, py);
+		FrameSnapshot& frame = render_thread ? render_thread->back() : serial_frame;
+		frame.width = wnd->getWidth();
+		frame.height = wnd->getHeight();
+		frame.shader = player->getShader();
+		frame.input_time = dropped_input_time != 0 ? dropped_input_time : input_time;
+
+		player->setLocation(static_cast<int>(std::round(transforms.renderX(player_handle.index))), 
+			static_cast<int>(std::round(transforms.renderY(player_handle.index))));
 		player->draw(&drawlist);
-		render(player.get(), &drawlist);
+		player->drawAt(&drawlist, script.getPositions("sprites"));
+		drawlist.swapCommands(frame.sprites);
 		drawlist.clear();
 		
 		if(g_show_main_menu_bar && ImGui::BeginMainMenuBar()) {
@@ -1132,10 +1347,74 @@ int main(int argc, char* argv[])
 		if(g_show_fps) {
 			static bool frame_time_is_open = false;
 			frame_time.Draw("Frame Time Histogram", &frame_time_is_open);
+			gc_panel.draw("Lua GC", script);
 
 			ImGui::Begin("testing");
 			static bool checked = false;
 			ImGui::CheckBoxTick("Some Test", &checked);
+			const auto& ps = object_pool.getStats();
+			ImGui::Text("Objects: %u live, %u peak, %u slots in %u slabs", 
+				static_cast<unsigned>(ps.live), static_cast<unsigned>(ps.peak), static_cast<unsigned>(ps.capacity), static_cast<unsigned>(ps.slabs));
+			ImGui::Text("Object memory: %.1f KiB live / %.1f KiB reserved", ps.bytes_live / 1024.0f, ps.bytes_reserved / 1024.0f);
+			const auto pl = render_thread ? render_thread->getStats() : serial_latency;
+			ImGui::Text("%s: present latency %.2f ms (avg %.2f, max %.2f), %llu dropped", 
+				render_thread ? "Render thread" : "Serial", pl.last_ms, pl.avg_ms, pl.max_ms, static_cast<unsigned long long>(pl.dropped));
+			bool idle_gc = script.isIdleCollectionEnabled();
+			if(ImGui::Checkbox("Idle-time Lua GC", &idle_gc)) {
+				script.setIdleCollection(idle_gc);
+			}
+			bool concurrent_mark = script.isConcurrentMarkEnabled();
+			if(ImGui::Checkbox("Concurrent Lua marking", &concurrent_mark) && !script.setConcurrentMark(concurrent_mark)) {
+				LOG_WARN("Concurrent Lua marking isn't supported by this build");
+			}
+			bool background_free = script.isBackgroundFreeEnabled();
+			if(ImGui::Checkbox("Background Lua free", &background_free) && !script.setBackgroundFree(background_free)) {
+				LOG_WARN("Background freeing needs --script-alloc=system and LUA_USE_BACKGROUNDFREE");
+			}
+			lua_FreeStats fs;
+			if(script.getFreeStats(&fs)) {
+				// Time the free thread spent freeing is sweep time the main thread didn't have to spend,
+				// less what handing the batches over cost it.
+				ImGui::Text("Background free: %.1f MiB in %llu batches (size %d), %.1f KiB pending, %llu inline", 
+					fs.bytes / (1024.0f * 1024.0f), static_cast<unsigned long long>(fs.batches), fs.batchsize, 
+					fs.pending / 1024.0f, static_cast<unsigned long long>(fs.direct));
+				ImGui::Text("Sweep time moved off main thread: %.1f ms freeing, %.1f ms hand-off", fs.freetime * 1000.0, fs.handofftime * 1000.0);
+			}
+			const auto& gs = script.getGCStats();
+			ImGui::Text("Lua heap %.1f KiB, idle GC %.2f ms (avg %.2f, max %.2f), %llu cycles", script.heapBytes() / 1024.0f, 
+				gs.last_idle_ms, gs.avg_idle_ms, gs.max_idle_ms, static_cast<unsigned long long>(gs.idle_cycles));
+			ImGui::End();
+
+			ImGui::Begin("Frame Pacing");
+			int vsync = static_cast<int>(pacer.getVSync());
+			if(ImGui::Combo("VSync", &vsync, "Off\0On\0Adaptive\0")) {
+				auto apply = [&pacer, vsync]() { pacer.setVSync(static_cast<graphics::VSync>(vsync)); };
+				if(render_thread) {
+					render_thread->post(apply);
+				} else {
+					apply();
+					pacer.setLimiterEnabled(vsync == static_cast<int>(graphics::VSync::OFF));
+				}
+			}
+			bool trace = pacer.isLatencyTraceEnabled();
+			if(ImGui::Checkbox("Latency trace", &trace)) {
+				pacer.setLatencyTrace(trace);
+			}
+			const auto fp = pacer.getStats();
+			ImGui::Text("Interval %.2f ms (target %.2f ms), %llu late of %llu", fp.interval_ms, fp.target_ms, 
+				static_cast<unsigned long long>(fp.late_frames), static_cast<unsigned long long>(fp.frames));
+			ImGui::Text("Input to present %.2f ms (avg %.2f, max %.2f)", fp.input_last_ms, fp.input_avg_ms, fp.input_max_ms);
+			ImGui::End();
+
+			job_system.sampleStats();
+			ImGui::Begin("Job Workers");
+			const auto& js = job_system.getStats();
+			for(int n = 0; n != static_cast<int>(js.size()); ++n) {
+				ImGui::ProgressBar(js[n].utilization, ImVec2(150.0f, 0.0f));
+				ImGui::SameLine();
+				ImGui::Text("%s %d: %llu run, %llu stolen", n == 0 ? "main" : "worker", n, 
+					static_cast<unsigned long long>(js[n].jobs_run), static_cast<unsigned long long>(js[n].jobs_stolen));
+			}
 			ImGui::End();
 		}
 
@@ -1143,9 +1422,34 @@ int main(int argc, char* argv[])
 			show_text_editor(&editor);
 		}
 
-		wnd->swap();
+		ImGui::Render();
+		frame.captureImGui(ImGui::GetDrawData());
+
+		if(render_thread) {
+			// A dropped snapshot may itself have carried the time from an earlier one, so this is
+			// always the oldest input still waiting to be shown.
+			dropped_input_time = render_thread->publish() ? render_thread->back().input_time : 0;
+		} else {
+			const uint64_t published = SDL_GetPerformanceCounter();
+			render_frame(frame, &drawlist);
+			wnd->swap();
+			const uint64_t presented = SDL_GetPerformanceCounter();
+			serial_latency.record(published, presented);
+			pacer.presented(frame.input_time, presented);
+		}
+		script.endLatencyCritical();
+		// The frame is out of our hands, spend (some of) the wait for the next one collecting garbage.
+		// Without the limiter there's no idle time to measure and the budget is used as is.
+		const double idle_ms = pacer.isLimiterEnabled() ? pacer.idleTimeMs() : gc_budget_us / 1000.0;
+		script.collectIdle(std::min(gc_budget_us, static_cast<int>(idle_ms * 1000.0)));
+		pacer.limit();
 
 		//fmt::print("frame time: {}\n", frameTime * 1000.0);
 	}
+	// give the context back to this thread before anything holding GL resources is destroyed.
+	render_thread.reset();
+	if(pacer.isLatencyTraceEnabled()) {
+		pacer.logLatencySummary();
+	}
 	return 0;
 }
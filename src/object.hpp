@@ -24,6 +24,7 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include "glm/vec2.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 
@@ -32,6 +33,7 @@ class DrawList;
 namespace game
 {
 	class Object;
+	template<typename T> class BufferSpan;
 	typedef std::unique_ptr<Object> ObjectPtr;
 
 	class Object
@@ -40,6 +42,8 @@ namespace game
 		Object();
 		~Object();
 		void draw(DrawList* drawlist);
+		// Draws another copy of the object's current frame at each of 'positions'.
+		void drawAt(DrawList* drawlist, const BufferSpan<const glm::vec2>& positions);
 		void setTexture(const char*filename);
 		void setLocation(int x, int y) { loc_.x = x; loc_.y = y; }
 		void attachShader(graphics::Shader* s);
@@ -0,0 +1,127 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <new>
+
+#include "asserts.hpp"
+#include "object_pool.hpp"
+
+namespace game
+{
+	ObjectPool::ObjectPool(size_t objects_per_slab)
+		: per_slab_(objects_per_slab)
+		, slabs_()
+		, free_head_(npos)
+		, stats_()
+	{
+		ASSERT_LOG(per_slab_ > 0, "Object pool needs at least one object per slab: {}", per_slab_);
+	}
+
+	ObjectPool::~ObjectPool()
+	{
+		clear();
+	}
+
+	void ObjectPool::addSlab()
+	{
+		const uint32_t first = static_cast<uint32_t>(stats_.capacity);
+		ASSERT_LOG(stats_.capacity + per_slab_ < npos, "Object pool capacity exhausted: {}", stats_.capacity);
+		slabs_.emplace_back(new Slot[per_slab_]);
+		Slot* slab = slabs_.back().get();
+		// Thread the new slots onto the free list so that the lowest index is handed out first.
+		for(size_t n = 0; n != per_slab_; ++n) {
+			slab[n].generation = 1;
+			slab[n].alive = false;
+			slab[n].next_free = n + 1 == per_slab_ ? free_head_ : first + static_cast<uint32_t>(n) + 1;
+		}
+		free_head_ = first;
+
+		stats_.capacity += per_slab_;
+		stats_.slabs = slabs_.size();
+		stats_.bytes_reserved += per_slab_ * sizeof(Slot);
+	}
+
+	void ObjectPool::reserve(size_t n)
+	{
+		while(stats_.capacity < n) {
+			addSlab();
+		}
+	}
+
+	ObjectHandle ObjectPool::spawn()
+	{
+		if(free_head_ == npos) {
+			addSlab();
+		}
+		const uint32_t index = free_head_;
+		Slot& s = slot(index);
+		free_head_ = s.next_free;
+
+		new (s.object()) Object();
+		s.alive = true;
+		s.next_free = npos;
+
+		++stats_.spawns;
+		++stats_.live;
+		if(stats_.live > stats_.peak) {
+			stats_.peak = stats_.live;
+		}
+		stats_.bytes_live += sizeof(Object);
+		return ObjectHandle(index, s.generation);
+	}
+
+	void ObjectPool::despawn(ObjectHandle h)
+	{
+		Object* obj = get(h);
+		if(obj == nullptr) {
+			LOG_WARN("Despawn of stale object handle {}:{}", h.index, h.generation);
+			return;
+		}
+		Slot& s = slot(h.index);
+		obj->~Object();
+		s.alive = false;
+		// Skip 0 on wrap-around, it's reserved for the null handle.
+		if(++s.generation == 0) {
+			s.generation = 1;
+		}
+		s.next_free = free_head_;
+		free_head_ = h.index;
+
+		++stats_.despawns;
+		--stats_.live;
+		stats_.bytes_live -= sizeof(Object);
+	}
+
+	Object* ObjectPool::get(ObjectHandle h) const
+	{
+		if(h.isNull() || h.index >= stats_.capacity) {
+			return nullptr;
+		}
+		Slot& s = slot(h.index);
+		return s.alive && s.generation == h.generation ? s.object() : nullptr;
+	}
+
+	void ObjectPool::clear()
+	{
+		forEach([this](ObjectHandle h, Object&) { despawn(h); });
+	}
+}
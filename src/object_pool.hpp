@@ -0,0 +1,117 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "object.hpp"
+
+namespace game
+{
+	// A handle to an object living in an ObjectPool. The generation is bumped every time
+	// the slot is despawned, so a handle to a dead object never resolves to whatever
+	// object re-used its slot.
+	struct ObjectHandle
+	{
+		ObjectHandle() : index(0), generation(0) {}
+		ObjectHandle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+		bool isNull() const { return generation == 0; }
+		uint32_t index;
+		uint32_t generation;
+	};
+
+	inline bool operator==(const ObjectHandle& a, const ObjectHandle& b) { return a.index == b.index && a.generation == b.generation; }
+	inline bool operator!=(const ObjectHandle& a, const ObjectHandle& b) { return !(a == b); }
+
+	struct ObjectPoolStats
+	{
+		ObjectPoolStats() : live(0), peak(0), capacity(0), slabs(0), bytes_reserved(0), bytes_live(0), spawns(0), despawns(0) {}
+		size_t live;				//!< Objects currently spawned.
+		size_t peak;				//!< Highest value 'live' has reached.
+		size_t capacity;			//!< Number of slots across all slabs.
+		size_t slabs;				//!< Number of slabs allocated, the only time we hit the allocator.
+		size_t bytes_reserved;		//!< Memory held by the slabs.
+		size_t bytes_live;			//!< Memory in slots holding a live object.
+		uint64_t spawns;
+		uint64_t despawns;
+	};
+
+	// Slab allocator for game::Object. Objects are constructed in place in fixed size slabs
+	// that are never moved or freed while the pool is alive, so pointers handed out by get()
+	// stay valid until the object is despawned. Free slots are kept on an intrusive LIFO
+	// list so spawn/despawn are O(1) and recently freed (cache warm) slots are re-used first.
+	class ObjectPool
+	{
+	public:
+		explicit ObjectPool(size_t objects_per_slab=256);
+		~ObjectPool();
+
+		ObjectHandle spawn();
+		void despawn(ObjectHandle h);
+		void clear();
+
+		// Returns nullptr if the handle is stale or null.
+		Object* get(ObjectHandle h) const;
+		bool isValid(ObjectHandle h) const { return get(h) != nullptr; }
+
+		// Pre-allocates slabs so that at least n objects can be live without allocating.
+		void reserve(size_t n);
+
+		size_t size() const { return stats_.live; }
+		size_t capacity() const { return stats_.capacity; }
+		const ObjectPoolStats& getStats() const { return stats_; }
+
+		template<typename F> void forEach(F fn) {
+			for(uint32_t n = 0; n != static_cast<uint32_t>(stats_.capacity); ++n) {
+				Slot& s = slot(n);
+				if(s.alive) {
+					fn(ObjectHandle(n, s.generation), *s.object());
+				}
+			}
+		}
+	private:
+		static const uint32_t npos = ~0U;
+
+		struct Slot
+		{
+			std::aligned_storage<sizeof(Object), alignof(Object)>::type storage;
+			uint32_t generation;
+			uint32_t next_free;
+			bool alive;
+			Object* object() { return reinterpret_cast<Object*>(&storage); }
+		};
+
+		Slot& slot(uint32_t index) const { return slabs_[index / per_slab_][index % per_slab_]; }
+		void addSlab();
+
+		size_t per_slab_;
+		std::vector<std::unique_ptr<Slot[]>> slabs_;
+		uint32_t free_head_;
+		ObjectPoolStats stats_;
+
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+	};
+}
@@ -0,0 +1,198 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SDL.h"
+
+#include "triple_buffer.hpp"
+
+namespace graphics
+{
+	// Time from a frame snapshot being completed to the swap that presented it returning.
+	// Kept for both the threaded and the serial path so the two can be compared.
+	struct PresentLatency
+	{
+		PresentLatency() : frames(0), dropped(0), last_ms(0.0f), avg_ms(0.0f), max_ms(0.0f) {}
+		void record(uint64_t published, uint64_t presented) {
+			const float ms = static_cast<float>(static_cast<double>(presented - published) * 1000.0 / SDL_GetPerformanceFrequency());
+			last_ms = ms;
+			avg_ms = frames == 0 ? ms : avg_ms + (ms - avg_ms) * 0.05f;
+			max_ms = std::max(max_ms, ms);
+			++frames;
+		}
+		uint64_t frames;
+		uint64_t dropped;		//!< Snapshots overwritten before the render thread got to them.
+		float last_ms;
+		float avg_ms;			//!< Exponential moving average.
+		float max_ms;
+	};
+
+	// Owns the GL context on a dedicated thread. The simulation fills in back() and calls publish(),
+	// then carries straight on with the next frame; the render thread picks up the newest snapshot,
+	// draws it and blocks in SDL_GL_SwapWindow without holding anyone else up. Hand-off is through a
+	// lock-free triple buffer so a slow frame on either side never stalls the other.
+	//
+	// The snapshot type must be default constructible and is recycled, the producer has to refill
+	// every field each frame. GL calls from other threads must go through post().
+	template<typename Snapshot>
+	class RenderThread
+	{
+	public:
+		typedef std::function<void(Snapshot&)> render_fn;
+		// Called on the render thread once the swap for a snapshot has returned.
+		typedef std::function<void(const Snapshot&, uint64_t presented)> present_fn;
+
+		// The context must be current on the calling thread, it is released and re-acquired on
+		// destruction so that GL resources can be cleaned up as normal.
+		RenderThread(SDL_Window* wnd, SDL_GLContext ctx, render_fn fn, present_fn present=present_fn())
+			: window_(wnd),
+			  context_(ctx),
+			  render_(fn),
+			  present_(present),
+			  frames_(),
+			  running_(true),
+			  lock_(),
+			  cv_(),
+			  has_frame_(false),
+			  tasks_(),
+			  stats_lock_(),
+			  stats_(),
+			  dropped_(0)
+		{
+			SDL_GL_MakeCurrent(window_, nullptr);
+			thread_ = std::thread(&RenderThread::renderMain, this);
+		}
+		~RenderThread() {
+			{
+				std::lock_guard<std::mutex> lk(lock_);
+				running_ = false;
+			}
+			cv_.notify_one();
+			thread_.join();
+			SDL_GL_MakeCurrent(window_, context_);
+		}
+
+		Snapshot& back() { return frames_.back().frame; }
+		// Returns true if the snapshot published before this one was never drawn. back() is then that
+		// snapshot again, so whatever in it must not be lost can be carried into the next one.
+		bool publish() {
+			frames_.back().published = SDL_GetPerformanceCounter();
+			const bool dropped = frames_.publish();
+			if(dropped) {
+				++dropped_;
+			}
+			{
+				std::lock_guard<std::mutex> lk(lock_);
+				has_frame_ = true;
+			}
+			cv_.notify_one();
+			return dropped;
+		}
+
+		// Queues a function to run on the render thread, before the next frame is drawn.
+		void post(std::function<void()> fn) {
+			{
+				std::lock_guard<std::mutex> lk(lock_);
+				tasks_.emplace_back(fn);
+			}
+			cv_.notify_one();
+		}
+
+		PresentLatency getStats() {
+			std::lock_guard<std::mutex> lk(stats_lock_);
+			PresentLatency res = stats_;
+			res.dropped = dropped_;
+			return res;
+		}
+	private:
+		struct Slot
+		{
+			Slot() : frame(), published(0) {}
+			Snapshot frame;
+			uint64_t published;
+		};
+
+		void renderMain() {
+			SDL_GL_MakeCurrent(window_, context_);
+			std::vector<std::function<void()>> tasks;
+			for(;;) {
+				{
+					std::unique_lock<std::mutex> lk(lock_);
+					cv_.wait(lk, [this]() { return !running_ || has_frame_ || !tasks_.empty(); });
+					if(!running_) {
+						break;
+					}
+					has_frame_ = false;
+					tasks.swap(tasks_);
+				}
+				for(auto& t : tasks) {
+					t();
+				}
+				tasks.clear();
+
+				if(!frames_.acquire()) {
+					continue;
+				}
+				Slot& slot = frames_.front();
+				render_(slot.frame);
+				SDL_GL_SwapWindow(window_);
+				const uint64_t now = SDL_GetPerformanceCounter();
+				if(present_) {
+					present_(slot.frame, now);
+				}
+
+				std::lock_guard<std::mutex> lk(stats_lock_);
+				stats_.record(slot.published, now);
+			}
+			SDL_GL_MakeCurrent(window_, nullptr);
+		}
+
+		SDL_Window* window_;
+		SDL_GLContext context_;
+		render_fn render_;
+		present_fn present_;
+		TripleBuffer<Slot> frames_;
+		std::thread thread_;
+
+		bool running_;
+		std::mutex lock_;
+		std::condition_variable cv_;
+		bool has_frame_;
+		std::vector<std::function<void()>> tasks_;
+
+		std::mutex stats_lock_;
+		PresentLatency stats_;
+		std::atomic<uint64_t> dropped_;
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+	};
+}
@@ -0,0 +1,91 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "glm/vec2.hpp"
+
+#include "lua.hpp"
+extern "C" {
+#include "lbuflib.h"
+}
+
+namespace game
+{
+	// Element type of a script buffer (see lbuflib.h) for each C++ type that can look at one.
+	template<typename T> struct BufferElement;
+	template<> struct BufferElement<float> { static const int type = LUA_BUFF32; };
+	template<> struct BufferElement<double> { static const int type = LUA_BUFF64; };
+	template<> struct BufferElement<int32_t> { static const int type = LUA_BUFI32; };
+	template<> struct BufferElement<uint8_t> { static const int type = LUA_BUFU8; };
+	template<> struct BufferElement<glm::vec2> { static const int type = LUA_BUFVEC2; };
+	template<typename T> struct BufferElement<const T> : BufferElement<T> {};
+
+	static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "vec2 buffers hold two packed floats per element");
+
+	// The elements of a buffer, seen in place. Nothing is copied, so the span is only good while
+	// the buffer is reachable from Lua; don't keep one across anything that could let the
+	// collector free it.
+	template<typename T>
+	class BufferSpan
+	{
+	public:
+		BufferSpan() : data_(nullptr), size_(0) {}
+		BufferSpan(T* data, size_t size) : data_(data), size_(size) {}
+		// A read-only span from a writable one.
+		template<typename U>
+		BufferSpan(const BufferSpan<U>& other) : data_(other.data()), size_(other.size()) {}
+
+		T* data() const { return data_; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		T& operator[](size_t n) const { return data_[n]; }
+		T* begin() const { return data_; }
+		T* end() const { return data_ + size_; }
+	private:
+		T* data_;
+		size_t size_;
+	};
+
+	// Empty unless the value at 'idx' is a buffer with elements of type T.
+	template<typename T>
+	BufferSpan<T> toBufferSpan(lua_State* L, int idx)
+	{
+		int type = -1;
+		size_t n = 0;
+		void* p = luaL_totypedbuf(L, idx, &type, &n);
+		if(p == nullptr || type != BufferElement<T>::type) {
+			return BufferSpan<T>();
+		}
+		return BufferSpan<T>(static_cast<T*>(p), n);
+	}
+
+	// Pushes a new zero-filled buffer of 'n' elements, for C++ to fill in before handing it to a
+	// script.
+	template<typename T>
+	BufferSpan<T> newBuffer(lua_State* L, size_t n)
+	{
+		return BufferSpan<T>(static_cast<T*>(luaL_newtypedbuf(L, BufferElement<T>::type, n)), n);
+	}
+}
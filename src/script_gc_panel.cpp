@@ -0,0 +1,153 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cfloat>
+
+#include "imgui.h"
+
+#include "asserts.hpp"
+#include "script_gc_panel.hpp"
+
+namespace game
+{
+	namespace
+	{
+		const char* const phase_names[LUA_GCPHASES] = { "Propagate", "Atomic", "Sweep", "Finalize" };
+		const char* const kind_names[LUA_CENSUSKINDS] = { "table", "string", "Lua function", "C function", "userdata", "proto", "thread" };
+
+		// Sites past this many are summed into one line.
+		const int max_sites_shown = 25;
+	}
+
+	ScriptGCPanel::ScriptGCPanel()
+		: census_(),
+		  has_census_(false)
+	{
+	}
+
+	void ScriptGCPanel::draw(const char* name, ScriptState& script, bool* open)
+	{
+		if(!ImGui::Begin(name, open)) {
+			ImGui::End();
+			return;
+		}
+
+		bool profile = script.isGCProfileEnabled();
+		bool track = script.isTrackingAllocSites();
+		bool changed = false;
+		if(ImGui::Checkbox("Profile collector", &profile)) {
+			track = track && profile;
+			changed = true;
+		}
+		ImGui::SameLine();
+		if(ImGui::Checkbox("Track allocation sites", &track)) {
+			profile = profile || track;
+			changed = true;
+		}
+		if(changed && !script.setGCProfile(profile, track)) {
+			LOG_WARN("Unable to change Lua GC profiling");
+		}
+
+		lua_GCProfile prof;
+		if(script.getGCProfile(&prof)) {
+			ImGui::SameLine();
+			if(ImGui::Button("Reset")) {
+				script.resetGCProfile();
+			}
+			// Bin n counts steps under 2^n microseconds, the last one everything longer.
+			ImGui::TextDisabled("Step times, <1us to >=%dms, log2 bins", (1 << (LUA_GCHISTBINS - 2)) / 1000);
+			for(int n = 0; n != LUA_GCPHASES; ++n) {
+				const lua_GCPhaseStats& ps = prof.phase[n];
+				float bins[LUA_GCHISTBINS];
+				std::transform(ps.hist, ps.hist + LUA_GCHISTBINS, bins, [](size_t v) { return static_cast<float>(v); });
+				ImGui::PushID(n);
+				ImGui::PlotHistogram("", bins, LUA_GCHISTBINS, 0, phase_names[n], 0.0f, FLT_MAX, ImVec2(3.0f * 60.0f, 40.0f));
+				ImGui::SameLine();
+				ImGui::Text("%llu steps\n%.2f ms total\n%.3f ms max", static_cast<unsigned long long>(ps.steps), ps.total * 1000.0, ps.max * 1000.0);
+				ImGui::PopID();
+			}
+		}
+
+		ImGui::Separator();
+		if(ImGui::Button("Take census")) {
+			census_ = script.takeCensus();
+			has_census_ = true;
+		}
+		if(has_census_) {
+			drawCensus();
+		}
+		ImGui::End();
+	}
+
+	void ScriptGCPanel::drawCensus()
+	{
+		ImGui::Columns(3, "census_types");
+		ImGui::Text("Type"); ImGui::NextColumn();
+		ImGui::Text("Objects"); ImGui::NextColumn();
+		ImGui::Text("KiB"); ImGui::NextColumn();
+		ImGui::Separator();
+		size_t count = 0;
+		size_t bytes = 0;
+		for(int n = 0; n != LUA_CENSUSKINDS; ++n) {
+			ImGui::Text("%s", kind_names[n]); ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(census_.types.count[n])); ImGui::NextColumn();
+			ImGui::Text("%.1f", census_.types.bytes[n] / 1024.0f); ImGui::NextColumn();
+			count += census_.types.count[n];
+			bytes += census_.types.bytes[n];
+		}
+		ImGui::Separator();
+		ImGui::Text("total"); ImGui::NextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(count)); ImGui::NextColumn();
+		ImGui::Text("%.1f", bytes / 1024.0f); ImGui::NextColumn();
+		ImGui::Columns(1);
+
+		if(census_.sites.empty()) {
+			return;
+		}
+		ImGui::Spacing();
+		ImGui::Columns(3, "census_sites");
+		ImGui::Text("Allocated by"); ImGui::NextColumn();
+		ImGui::Text("Objects"); ImGui::NextColumn();
+		ImGui::Text("KiB"); ImGui::NextColumn();
+		ImGui::Separator();
+		size_t rest_count = 0;
+		size_t rest_bytes = 0;
+		for(int n = 0; n != static_cast<int>(census_.sites.size()); ++n) {
+			const auto& site = census_.sites[n];
+			if(n >= max_sites_shown) {
+				rest_count += site.count;
+				rest_bytes += site.bytes;
+				continue;
+			}
+			ImGui::Text("%s", site.name.c_str()); ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(site.count)); ImGui::NextColumn();
+			ImGui::Text("%.1f", site.bytes / 1024.0f); ImGui::NextColumn();
+		}
+		if(rest_count > 0) {
+			ImGui::TextDisabled("%d more", static_cast<int>(census_.sites.size()) - max_sites_shown); ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(rest_count)); ImGui::NextColumn();
+			ImGui::Text("%.1f", rest_bytes / 1024.0f); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+}
@@ -0,0 +1,220 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+
+#include "asserts.hpp"
+#include "script_state.hpp"
+
+namespace game
+{
+	namespace
+	{
+		int traceback(lua_State* L)
+		{
+			luaL_traceback(L, L, lua_tostring(L, 1), 1);
+			return 1;
+		}
+
+		void add_site(void* ud, const char* site, size_t count, size_t bytes)
+		{
+			static_cast<std::vector<ScriptAllocSite>*>(ud)->push_back(ScriptAllocSite{ site, count, bytes });
+		}
+	}
+
+	ScriptState::ScriptState(bool pooled)
+		: L_(pooled ? luaL_newpoolstate() : luaL_newstate()),
+		  idle_gc_(false),
+		  concurrent_mark_(false),
+		  pooled_(pooled),
+		  background_free_(false),
+		  gc_profile_(false),
+		  track_sites_(false),
+		  critical_depth_(0),
+		  gc_stats_()
+	{
+		ASSERT_LOG(L_ != nullptr, "Unable to create Lua state.");
+		luaL_openlibs(L_);
+	}
+
+	ScriptState::~ScriptState()
+	{
+		lua_close(L_);
+	}
+
+	bool ScriptState::call(int nargs)
+	{
+		const int base = lua_gettop(L_) - nargs;
+		lua_pushcfunction(L_, traceback);
+		lua_insert(L_, base);
+		const int res = lua_pcall(L_, nargs, 0, base);
+		if(res != LUA_OK) {
+			LOG_ERROR("Script error: {}", lua_tostring(L_, -1));
+			lua_pop(L_, 1);
+		}
+		lua_remove(L_, base);
+		return res == LUA_OK;
+	}
+
+	bool ScriptState::runFile(const std::string& filename)
+	{
+		if(luaL_loadfile(L_, filename.c_str()) != LUA_OK) {
+			LOG_ERROR("Unable to load script: {}", lua_tostring(L_, -1));
+			lua_pop(L_, 1);
+			return false;
+		}
+		return call(0);
+	}
+
+	void ScriptState::setChunkCache(const std::string& dir)
+	{
+		luaL_setchunkcache(L_, dir.empty() ? nullptr : dir.c_str(), 0);
+	}
+
+	const luaL_ChunkCacheStats* ScriptState::getChunkCacheStats() const
+	{
+		return luaL_chunkcachestats(L_);
+	}
+
+	void ScriptState::update(double dt)
+	{
+		if(lua_getglobal(L_, "update") != LUA_TFUNCTION) {
+			lua_pop(L_, 1);
+			return;
+		}
+		lua_pushnumber(L_, dt);
+		call(1);
+	}
+
+	BufferSpan<glm::vec2> ScriptState::newPositions(const char* name, size_t n)
+	{
+		BufferSpan<glm::vec2> positions = newBuffer<glm::vec2>(L_, n);
+		lua_setglobal(L_, name);
+		return positions;
+	}
+
+	BufferSpan<const glm::vec2> ScriptState::getPositions(const char* name) const
+	{
+		lua_getglobal(L_, name);
+		BufferSpan<const glm::vec2> positions = toBufferSpan<const glm::vec2>(L_, -1);
+		// the global keeps the buffer alive once it's off the stack.
+		lua_pop(L_, 1);
+		return positions;
+	}
+
+	void ScriptState::setIdleCollection(bool en)
+	{
+		idle_gc_ = en;
+		lua_gc(L_, LUA_GCDEFER, idle_gc_ && critical_depth_ > 0);
+	}
+
+	void ScriptState::beginLatencyCritical()
+	{
+		if(critical_depth_++ == 0 && idle_gc_) {
+			lua_gc(L_, LUA_GCDEFER, 1);
+		}
+	}
+
+	void ScriptState::endLatencyCritical()
+	{
+		ASSERT_LOG(critical_depth_ > 0, "Unbalanced endLatencyCritical()");
+		if(--critical_depth_ == 0) {
+			lua_gc(L_, LUA_GCDEFER, 0);
+		}
+	}
+
+	void ScriptState::collectIdle(int usec)
+	{
+		if(!idle_gc_ || usec <= 0) {
+			return;
+		}
+		const auto start = std::chrono::steady_clock::now();
+		if(lua_gcstepfor(L_, usec)) {
+			++gc_stats_.idle_cycles;
+		}
+		const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		gc_stats_.last_idle_ms = ms;
+		gc_stats_.avg_idle_ms = gc_stats_.idle_calls == 0 ? ms : gc_stats_.avg_idle_ms + (ms - gc_stats_.avg_idle_ms) * 0.05f;
+		gc_stats_.max_idle_ms = std::max(gc_stats_.max_idle_ms, ms);
+		++gc_stats_.idle_calls;
+	}
+
+	bool ScriptState::setConcurrentMark(bool en)
+	{
+		if(lua_setconcurrentmark(L_, en) == 0) {
+			return false;
+		}
+		concurrent_mark_ = en;
+		return true;
+	}
+
+	bool ScriptState::setBackgroundFree(bool en)
+	{
+		if(en && pooled_) {
+			return false;
+		}
+		if(lua_setbackgroundfree(L_, en) == 0) {
+			return false;
+		}
+		background_free_ = en;
+		return true;
+	}
+
+	bool ScriptState::getFreeStats(lua_FreeStats* stats) const
+	{
+		return lua_getfreestats(L_, stats) != 0;
+	}
+
+	bool ScriptState::setGCProfile(bool en, bool track_sites)
+	{
+		if(lua_gcprofile(L_, en ? (track_sites ? LUA_GCPROFTRACK : LUA_GCPROFON) : LUA_GCPROFOFF) == 0) {
+			return false;
+		}
+		gc_profile_ = en;
+		track_sites_ = en && track_sites;
+		return true;
+	}
+
+	void ScriptState::resetGCProfile()
+	{
+		lua_gcprofile(L_, LUA_GCPROFRESET);
+	}
+
+	bool ScriptState::getGCProfile(lua_GCProfile* prof) const
+	{
+		return lua_getgcprofile(L_, prof) != 0;
+	}
+
+	ScriptHeapCensus ScriptState::takeCensus() const
+	{
+		ScriptHeapCensus res;
+		lua_heapcensus(L_, &res.types, add_site, &res.sites);
+		std::sort(res.sites.begin(), res.sites.end(), [](const ScriptAllocSite& a, const ScriptAllocSite& b) { return a.bytes > b.bytes; });
+		return res;
+	}
+
+	size_t ScriptState::heapBytes() const
+	{
+		return static_cast<size_t>(lua_gc(L_, LUA_GCCOUNT, 0)) * 1024 + static_cast<size_t>(lua_gc(L_, LUA_GCCOUNTB, 0));
+	}
+}
@@ -0,0 +1,140 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm/vec2.hpp"
+
+#include "lua.hpp"
+#include "script_buffer.hpp"
+
+namespace game
+{
+	struct ScriptGCStats
+	{
+		ScriptGCStats() : idle_calls(0), idle_cycles(0), last_idle_ms(0.0f), avg_idle_ms(0.0f), max_idle_ms(0.0f) {}
+		uint64_t idle_calls;		//!< Calls to collectIdle() that had some budget to spend.
+		uint64_t idle_cycles;		//!< Collection cycles finished during idle time.
+		float last_idle_ms;
+		float avg_idle_ms;			//!< Exponential moving average.
+		float max_idle_ms;			//!< A single large step can overrun the budget, this shows by how much.
+	};
+
+	struct ScriptAllocSite
+	{
+		std::string name;			//!< "chunk:line" of the allocating function, "[C]" for the host.
+		size_t count;
+		size_t bytes;
+	};
+
+	struct ScriptHeapCensus
+	{
+		lua_HeapCensus types;
+		std::vector<ScriptAllocSite> sites;		//!< Largest first, empty unless sites are being tracked.
+	};
+
+	// The game's Lua state, allocating from the size-class pool (see luaL_newpoolstate()) unless
+	// asked to use the system allocator.
+	//
+	// Left to itself the collector runs whenever allocation has run up enough debt, so the work
+	// lands in whichever frame happens to allocate. With idle collection on, debt-triggered steps
+	// are deferred while a latency critical section is open and the main loop pays the debt back
+	// with collectIdle(), out of the time it would otherwise spend waiting for the next frame. The
+	// collector still steps on its own if the debt grows past half the heap.
+	class ScriptState
+	{
+	public:
+		explicit ScriptState(bool pooled=true);
+		~ScriptState();
+
+		lua_State* get() const { return L_; }
+
+		// Runs a script file, errors are logged and return false.
+		bool runFile(const std::string& filename);
+		// Keeps compiled scripts in 'dir', which must already exist, so that unchanged scripts load
+		// without being parsed (see luaL_setchunkcache()). An empty 'dir' turns the cache off.
+		void setChunkCache(const std::string& dir);
+		// Null if the cache is off.
+		const luaL_ChunkCacheStats* getChunkCacheStats() const;
+		// Calls the global update(dt) if a script defined one.
+		void update(double dt);
+
+		// Sets the global 'name' to a new zero-filled vec2 buffer of 'n' positions for scripts to
+		// fill in.
+		BufferSpan<glm::vec2> newPositions(const char* name, size_t n);
+		// The positions in the global 'name', empty unless it is a vec2 buffer. Points into the
+		// buffer, so it is only good until the next call into Lua.
+		BufferSpan<const glm::vec2> getPositions(const char* name) const;
+
+		void setIdleCollection(bool en);
+		bool isIdleCollectionEnabled() const { return idle_gc_; }
+		// Critical sections nest, collector steps are deferred until the outermost one ends.
+		void beginLatencyCritical();
+		void endLatencyCritical();
+		// Does collector work for at most 'usec' microseconds.
+		void collectIdle(int usec);
+
+		// Experimental: marking is handed to a helper thread which runs while the game is outside
+		// of Lua. Returns false if the Lua library was built without LUA_USE_CONCURRENTMARK.
+		bool setConcurrentMark(bool en);
+		bool isConcurrentMarkEnabled() const { return concurrent_mark_; }
+		// Experimental: the memory of dead objects is freed on a helper thread instead of during the
+		// sweep. Needs LUA_USE_BACKGROUNDFREE and the system allocator, the pool isn't thread safe
+		// (and its frees are cheap anyway). Returns false if either is missing.
+		bool setBackgroundFree(bool en);
+		bool isBackgroundFreeEnabled() const { return background_free_; }
+		// False if background freeing is off, otherwise fills in 'stats'.
+		bool getFreeStats(lua_FreeStats* stats) const;
+
+		// Times every collector step by phase. Tracking also records which function allocated each
+		// object so that a census can be broken down by site, this costs a hash lookup per allocation.
+		bool setGCProfile(bool en, bool track_sites=false);
+		bool isGCProfileEnabled() const { return gc_profile_; }
+		bool isTrackingAllocSites() const { return track_sites_; }
+		void resetGCProfile();
+		// False if profiling is off, otherwise fills in 'prof'.
+		bool getGCProfile(lua_GCProfile* prof) const;
+		// Walks the whole heap, so this is for debugging only.
+		ScriptHeapCensus takeCensus() const;
+
+		size_t heapBytes() const;
+		const ScriptGCStats& getGCStats() const { return gc_stats_; }
+	private:
+		bool call(int nargs);
+
+		lua_State* L_;
+		bool idle_gc_;
+		bool concurrent_mark_;
+		bool pooled_;
+		bool background_free_;
+		bool gc_profile_;
+		bool track_sites_;
+		int critical_depth_;
+		ScriptGCStats gc_stats_;
+
+		ScriptState(const ScriptState&) = delete;
+		ScriptState& operator=(const ScriptState&) = delete;
+	};
+}
@@ -1588,6 +1588,12 @@ namespace sol {
 #define SOL_LUA_VERSION 502
 #endif // Lua Version 502, 501 || luajit, 500
 
+#if defined(LUA_RIDX_KEYS)
+#ifndef SOL_PINNED_KEYS
+#define SOL_PINNED_KEYS
+#endif
+#endif // lua_internkey and friends
+
 // end of sol/compatibility/version.hpp
 
 #ifndef SOL_NO_COMPAT
@@ -9511,6 +9517,15 @@ namespace stack {
 		}
 	};
 
+#ifdef SOL_PINNED_KEYS
+	template <typename C>
+	struct field_getter<lua_Key, false, false, C> {
+		void get(lua_State* L, lua_Key key, int tableindex = -1) {
+			lua_getkey(L, tableindex, key);
+		}
+	};
+#endif // pinned keys
+
 	template <typename T, bool raw>
 	struct field_getter<T, true, raw, std::enable_if_t<meta::is_c_str<T>::value>> {
 		template <typename Key>
@@ -9626,6 +9641,17 @@ namespace stack {
 		}
 	};
 
+#ifdef SOL_PINNED_KEYS
+	template <typename C>
+	struct field_setter<lua_Key, false, false, C> {
+		template <typename Value>
+		void set(lua_State* L, lua_Key key, Value&& value, int tableindex = -2) {
+			push(L, std::forward<Value>(value));
+			lua_setkey(L, tableindex, key);
+		}
+	};
+#endif // pinned keys
+
 	template <typename T, bool raw>
 	struct field_setter<T, true, raw, std::enable_if_t<meta::is_c_str<T>::value>> {
 		template <typename Key, typename Value>
@@ -15800,6 +15826,10 @@ namespace sol {
 		};
 
 		typedef std::unordered_map<std::string, call_information> mapping_t;
+#ifdef SOL_PINNED_KEYS
+		// Entries point into a mapping_t, whose nodes stay put as it grows
+		typedef std::unordered_map<lua_Key, const call_information*> key_mapping_t;
+#endif // pinned keys
 
 		struct variable_wrapper {
 			virtual int index(lua_State* L) = 0;
@@ -15845,13 +15875,22 @@ namespace sol {
 
 	struct usertype_metatable_core {
 		usertype_detail::mapping_t mapping;
+#ifdef SOL_PINNED_KEYS
+		// Declared member names, pinned when the metatable is pushed so that
+		// indexing with a string key is a pointer lookup
+		usertype_detail::key_mapping_t keys;
+#endif // pinned keys
 		lua_CFunction indexfunc;
 		lua_CFunction newindexfunc;
 		std::vector<object> runtime;
 		bool mustindex;
 
 		usertype_metatable_core(lua_CFunction ifx, lua_CFunction nifx)
-		: mapping(), indexfunc(ifx), newindexfunc(nifx), runtime(), mustindex(false) {
+		: mapping(),
+#ifdef SOL_PINNED_KEYS
+		keys(),
+#endif // pinned keys
+		indexfunc(ifx), newindexfunc(nifx), runtime(), mustindex(false) {
 		}
 
 		usertype_metatable_core(const usertype_metatable_core&) = default;
@@ -16278,6 +16317,14 @@ namespace sol {
 			if (toplevel && stack::get<type>(L, keyidx) != type::string) {
 				return is_index ? f.indexfunc(L) : f.newindexfunc(L);
 			}
+#ifdef SOL_PINNED_KEYS
+			auto keyit = f.keys.find(lua_tokey(L, keyidx));
+			if (keyit != f.keys.cend()) {
+				const usertype_detail::call_information& ci = *keyit->second;
+				const usertype_detail::member_search& member = is_index ? ci.index : ci.new_index;
+				return (member)(L, static_cast<void*>(&f), ci.runtime_target);
+			}
+#endif // pinned keys
 			std::string name = stack::get<std::string>(L, keyidx);
 			auto memberit = f.mapping.find(name);
 			if (memberit != f.mapping.cend()) {
@@ -16389,6 +16436,11 @@ namespace sol {
 
 				umt_t& um = make_cleanup(L, std::move(umx));
 				usertype_metatable_core& umc = um;
+#ifdef SOL_PINNED_KEYS
+				for (const auto& kvp : umc.mapping) {
+					umc.keys.emplace(lua_internkey(L, kvp.first.c_str()), &kvp.second);
+				}
+#endif // pinned keys
 				regs_t value_table{{}};
 				int lastreg = 0;
 				(void)detail::swallow{0, (um.template make_regs<(I * 2)>(value_table, lastreg, std::get<(I * 2)>(um.functions), std::get<(I * 2 + 1)>(um.functions)), 0)...};
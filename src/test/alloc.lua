@@ -0,0 +1,110 @@
+-- allocators: bulk free at close
+
+-- this state's memory comes from malloc, so objects must be freed one by
+-- one when it closes (a leak checker would catch it otherwise)
+assert(T.setbulkfree(true) == false)
+assert(T.setbulkfree(false) == true)
+local t = {}
+for i = 1, 1000 do t[i] = {i, tostring(i)} end
+
+-- region states release everything at once
+assert(T.regionbulkfree(16 << 20, [[
+  local t = {}
+  for i = 1, 10000 do t[i] = {i, tostring(i)} end
+  setmetatable({}, {__gc = function () end})
+]]) == true)
+
+-- pool allocator: blocks moving between size classes and to and from
+-- the system allocator, and the bytes accounted for along the way
+assert(T.poolstats() == nil)  -- this state allocates with malloc
+do
+  local P = T.newpool()
+  local function class (size)
+    return T.poolstats(P).classes[(size - 1) // 16 + 1]
+  end
+  local st = T.poolstats(P)
+  assert(st.live == 0 and st.peak == 0 and st.reserved == 0)
+  assert(#st.classes == 16 and st.classes[1].size == 16)
+  assert(st.classes[16].size == 256)
+
+  local a = T.poolalloc(P, nil, 0, 10)
+  st = T.poolstats(P)
+  assert(st.live == 10 and st.peak == 10 and st.reserved > 0)
+  assert(class(10).live == 1 and class(10).slabs == 1)
+  assert(T.poolalloc(P, a, 10, 16) == a)  -- same class, same block
+  assert(T.poolstats(P).live == 16)
+
+  a = T.poolalloc(P, a, 16, 40)  -- up a class
+  assert(class(16).live == 0 and class(40).live == 1)
+  local b = T.poolalloc(P, nil, 0, 200)
+  st = T.poolstats(P)
+  assert(st.live == 240 and st.peak == 240)
+
+  a = T.poolalloc(P, a, 40, 1000)  -- out to the system allocator
+  st = T.poolstats(P)
+  assert(class(40).live == 0)
+  assert(st.large_count == 1 and st.large_allocs == 1)
+  assert(st.large_live == 1000 and st.live == 1200 and st.peak == 1200)
+  a = T.poolalloc(P, a, 1000, 600)  -- shrinks, stays large
+  st = T.poolstats(P)
+  assert(st.large_live == 600 and st.live == 800 and st.peak == 1200)
+  a = T.poolalloc(P, a, 600, 100)  -- back into the pool
+  st = T.poolstats(P)
+  assert(st.large_count == 0 and st.large_live == 0)
+  assert(class(100).live == 1 and st.live == 300 and st.peak == 1200)
+  a = T.poolalloc(P, a, 100, 20)  -- down a class
+  assert(class(100).live == 0 and class(20).live == 1)
+  assert(T.poolstats(P).live == 220)
+
+  assert(T.poolalloc(P, a, 20, 0) == nil)
+  assert(T.poolalloc(P, b, 200, 0) == nil)
+  st = T.poolstats(P)
+  assert(st.live == 0 and st.peak == 1200)
+  for i = 1, 16 do assert(st.classes[i].live == 0) end
+
+  -- freed blocks are handed out again before another slab is carved
+  local reserved, blocks = st.reserved, {}
+  for i = 1, 100 do blocks[i] = T.poolalloc(P, nil, 0, 20) end
+  assert(class(20).slabs == 1 and T.poolstats(P).reserved == reserved)
+  assert(T.poolstats(P).peak == 2000)
+  for i = 1, 100 do T.poolalloc(P, blocks[i], 20, 0) end
+  T.freepool(P)
+  assert(not pcall(T.poolstats, P))
+end
+
+-- region allocator: a shrink never moves a block, so it still works
+-- once the quota is used up
+do
+  local R = T.newregion(64 * 1024)
+  local blocks, n = {}, 0
+  repeat
+    n = n + 1
+    blocks[n] = T.regionalloc(R, nil, 0, 200)
+  until blocks[n] == nil
+  n = n - 1
+  repeat until T.regionalloc(R, nil, 0, 16) == nil  -- last scraps
+  local st = T.regionstats(R)
+  assert(st.peak == st.live)
+  for i = 1, n do  -- down to a class with no free blocks
+    assert(T.regionalloc(R, blocks[i], 200, 20) == blocks[i])
+  end
+  assert(T.regionstats(R).live == st.live - n * 180)
+  assert(T.regionstats(R).peak == st.peak)
+  assert(T.regionalloc(R, nil, 0, 16) == nil)  -- no room came back...
+  T.regionalloc(R, blocks[1], 20, 0)  -- ...until a block is freed
+  assert(T.regionalloc(R, nil, 0, 20) == blocks[1])
+  T.freeregion(R)
+  assert(T.regionstats() == nil)
+end
+
+-- and from Lua: filling a region state to its quota and then
+-- collecting shrinks the string table and the stack in place
+assert(T.regionbulkfree(1 << 20, [[
+  local t = {}
+  local ok, msg = pcall(function ()
+    for i = 1, math.huge do t[i] = {tostring(i)} end
+  end)
+  assert(not ok and string.find(msg, "not enough memory"))
+  t = nil
+  collectgarbage()
+]]) == true)
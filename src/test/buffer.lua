@@ -0,0 +1,178 @@
+-- typed buffers
+
+-- new buffers start 16-byte aligned, whatever the allocator hands out
+local keep = {}
+for i = 0, 40 do
+  keep[#keep + 1] = string.rep("x", i)   -- vary what sits in between
+  for _, t in ipairs{"u8", "f32", "f64", "i32", "vec2"} do
+    local ok, b = pcall(buffer.new, t, i)
+    if ok then
+      assert(T.bufaddr(b, 16) == 0, t .. " " .. i)
+      keep[#keep + 1] = b
+    end
+  end
+end
+
+-- views of a new buffer are aligned for every type
+local b = buffer.new("u8", 64)
+for _, t in ipairs{"f32", "f64", "i32"} do
+  assert(#b:view(t) == 64 // (t == "f64" and 8 or 4))
+end
+assert(T.bufaddr(b:slice(2), 16) == 1)
+
+-- the kernels against scalar code, at lengths around the 2 and 4
+-- element SIMD blocks, on aligned buffers and on slices one element in
+
+local function f32 (x) return (string.unpack("f", string.pack("f", x))) end
+local function same (a, b) return a == b or (a ~= a and b ~= b) end
+local nan, inf = 0/0, math.huge
+local sizes = {0, 1, 3, 4, 5, 7, 8, 17}
+math.randomseed(47)
+
+-- 'n' random elements for a buffer of type 't', a few of them special
+local function values (t, n, special)
+  local v = {}
+  for i = 1, n do
+    if t == "u8" then v[i] = math.random(0, 255)
+    elseif t == "i32" then  -- in two halves, integers may be 32 bits
+      v[i] = (math.random(0, 0xffff) - 0x8000) * 0x10000 +
+             math.random(0, 0xffff)
+    elseif special and math.random(6) == 1 then
+      v[i] = ({nan, -nan, inf, -inf})[math.random(4)]
+    else v[i] = math.random() * 200 - 100
+    end
+  end
+  return v
+end
+
+-- a buffer with the elements of 'v', in place or one element in
+local function make (t, v, shifted)
+  if not shifted then return buffer.new(t, v) end
+  local b = buffer.new(t, #v + 1)
+  return b:slice(2):set(v)
+end
+
+-- a float buffer ("f32" for vec2, whose floats are viewed in pairs)
+local function floats (t, v, shifted)
+  local b = make(t == "vec2" and "f32" or t, v, shifted)
+  return t == "vec2" and b:view("vec2") or b, b
+end
+
+for _, shifted in ipairs{false, true} do
+  for _, n in ipairs(sizes) do
+    -- axpy, and scaling with x omitted
+    for _, t in ipairs{"f32", "f64", "vec2"} do
+      local nf = t == "vec2" and 2 * n or n
+      local round = t == "f64" and function (x) return x end or f32
+      local x, xf = floats(t, values(t, nf, true), shifted)
+      local y, yf = floats(t, values(t, nf, true), shifted)
+      local a = round(math.random() * 4 - 2)
+      local xs, ys = xf:totable(), yf:totable()
+      assert(y:axpy(a, x) == y)
+      local r = yf:totable()
+      for i = 1, nf do
+        assert(same(r[i], round(ys[i] + round(a * xs[i]))), t .. " " .. n)
+      end
+      y:axpy(a)
+      local s = yf:totable()
+      for i = 1, nf do assert(same(s[i], round(r[i] * a))) end
+    end
+    -- clamp, which leaves NaNs alone
+    for _, t in ipairs{"f32", "f64", "i32", "u8", "vec2"} do
+      local nf = t == "vec2" and 2 * n or n
+      local b, bf = floats(t, values(t, nf, true), shifted)
+      local lo, hi
+      if t == "u8" then lo, hi = 50, 200
+      elseif t == "i32" then lo, hi = -2^30, 2^30
+      else lo, hi = f32(-50.5), f32(60.25)
+      end
+      local v = bf:totable()
+      b:clamp(lo, hi)
+      local r = bf:totable()
+      for i = 1, nf do
+        local e = v[i] < lo and lo or v[i] > hi and hi or v[i]
+        assert(same(r[i], e), t .. " " .. n)
+      end
+    end
+    -- min and max skip NaNs; nil when empty, NaN when there is only NaN
+    for _, t in ipairs{"f32", "f64", "i32", "u8", "vec2"} do
+      local step = t == "vec2" and 2 or 1
+      for _, kind in ipairs{"random", "nan", "edge"} do
+        local v = values(t, step * n, true)
+        if t ~= "u8" and t ~= "i32" then
+          for i = 1, #v do
+            if kind == "nan" then v[i] = nan
+            elseif kind == "edge" then  -- the NaN scan must not hide these
+              v[i] = ({nan, inf, -inf})[math.random(3)]
+            end
+          end
+        end
+        local b = floats(t, v, shifted)
+        for first = 1, step do
+          local lo, hi
+          for i = first, #v, step do
+            if v[i] == v[i] then
+              local e = (t == "f32" or t == "vec2") and f32(v[i]) or v[i]
+              lo = (lo == nil or e < lo) and e or lo
+              hi = (hi == nil or e > hi) and e or hi
+            end
+          end
+          if lo == nil and n > 0 then lo, hi = nan, nan end
+          local mins, maxs = {b:min()}, {b:max()}
+          assert(same(mins[first], lo) and same(maxs[first], hi),
+                 t .. " " .. n .. " " .. kind)
+          if t == "i32" or t == "u8" then
+            assert(n == 0 or math.type(mins[1]) == "integer")
+          end
+        end
+      end
+    end
+    -- lengths and normalize of vec2s, zero vectors included
+    do
+      local v = values("f32", 2 * n, false)
+      if n > 0 then v[1], v[2] = 0, 0 end
+      local b, bf = floats("vec2", v, shifted)
+      local xy = bf:totable()
+      local len = b:lengths():totable()
+      assert(#len == n)
+      for i = 1, n do
+        local x, y = xy[2 * i - 1], xy[2 * i]
+        local l = f32(math.sqrt(f32(f32(x * x) + f32(y * y))))
+        assert(len[i] == l)
+        if l > 0 then
+          local s = f32(1 / l)
+          xy[2 * i - 1], xy[2 * i] = f32(x * s), f32(y * s)
+        end
+      end
+      local out = buffer.new("f32", n)
+      assert(b:lengths(out) == out)
+      for i = 1, n do assert(out[i] == len[i]) end
+      b:normalize()
+      local r = bf:totable()
+      for i = 1, 2 * n do assert(r[i] == xy[i]) end
+    end
+    -- sort is stable and puts NaNs of either sign last
+    for _, t in ipairs{"f32", "f64", "i32", "u8"} do
+      local v = values(t, n, true)
+      for i = 1, n do  -- plenty of duplicates
+        if math.random(2) == 1 then v[i] = v[math.random(i)] end
+      end
+      local keys = make(t, v, shifted)
+      local idx = buffer.new("i32", n)
+      for i = 1, n do idx[i] = i end
+      local ref = {}
+      for i, k in ipairs(keys:totable()) do ref[i] = {k, i} end
+      table.sort(ref, function (a, b)
+        local an, bn = a[1] ~= a[1], b[1] ~= b[1]
+        if an ~= bn then return bn
+        elseif not an and a[1] ~= b[1] then return a[1] < b[1]
+        else return a[2] < b[2]
+        end
+      end)
+      assert(buffer.sort(keys, idx) == keys)
+      for i = 1, n do
+        assert(same(keys[i], ref[i][1]) and idx[i] == ref[i][2], t .. " " .. n)
+      end
+    end
+  end
+end
@@ -0,0 +1,63 @@
+-- on-disk chunk cache (luaL_setchunkcache)
+
+local dir = os.tmpname()
+os.remove(dir)
+assert(os.execute("mkdir " .. dir))
+local script = dir .. "/script.lua"
+
+local function writescript (body)
+  local f = assert(io.open(script, "w"))
+  f:write(body)
+  f:close()
+end
+
+local function stats ()
+  local st = T.chunkcachestats()
+  return st.hits, st.misses, st.stale, st.writes
+end
+
+local function check (h, m, s, w)
+  local h1, m1, s1, w1 = stats()
+  assert(h1 == h and m1 == m and s1 == s and w1 == w,
+         string.format("%d %d %d %d", h1, m1, s1, w1))
+end
+
+T.setchunkcache(dir, 4)
+check(0, 0, 0, 0)
+
+-- chunks loaded from strings are never cached
+for i = 1, 100 do assert(load("return " .. i)() == i) end
+assert(load("return 1", "@script.lua")() == 1)
+check(0, 0, 0, 0)
+
+-- files are: a miss, then hits while the source is unchanged
+writescript("local a = ... return (a or 0) + 1\n")
+assert(loadfile(script)(1) == 2)
+check(0, 1, 0, 1)
+assert(loadfile(script)(2) == 3)
+assert(dofile(script) == 1)
+check(2, 1, 0, 1)
+
+-- an edit makes the entry stale and it is rewritten
+writescript("return 'changed'\n")
+assert(loadfile(script)() == "changed")
+check(2, 2, 1, 2)
+assert(loadfile(script)() == "changed")
+check(3, 2, 1, 2)
+
+-- text-only loads bypass the cache; binary-only loads still reject text
+assert(loadfile(script, "t")() == "changed")
+local f, err = loadfile(script, "b")
+assert(f == nil and err:find("text chunk"))
+check(3, 2, 1, 2)
+assert(loadfile(script, "bt")() == "changed")
+check(4, 2, 1, 2)
+
+-- errors are reported as without the cache
+writescript("return +\n")
+f, err = loadfile(script)
+assert(f == nil and err:find("script.lua:1:"))
+
+T.setchunkcache(nil)
+assert(T.chunkcachestats() == nil)
+os.execute("rm -rf " .. dir)
@@ -0,0 +1,89 @@
+-- torture test for the concurrent marker (LUA_USE_CONCURRENTMARK): tables,
+-- closures, upvalues, weak tables, finalizers and coroutines mutated
+-- while the marker runs during host work (C calls)
+
+if not T.setconcurrentmark(true) then
+  return  -- not supported in this build
+end
+
+local keep = {}
+local weakv = setmetatable({}, {__mode = "v"})
+local weakk = setmetatable({}, {__mode = "k"})
+local finalized = 0
+
+local function mk (i)
+  local t = {i, tostring(i), {i * 2}}
+  return function () return t[1] + #t[2] + t[3][1] end, t
+end
+
+local function check (f, i)
+  assert(f() == i + #tostring(i) + i * 2)
+end
+
+local co = coroutine.wrap(function ()
+  local acc = {}
+  while true do
+    acc[#acc % 50 + 1] = {string.rep("x", 10) .. #acc}
+    local v = coroutine.yield(#acc)
+    acc[#acc % 50 + 1] = v
+  end
+end)
+
+-- a counter shared by closures through an upvalue that keeps changing
+local function counter ()
+  local box = {n = 0}
+  return function () box = {n = box.n + 1}; return box.n end
+end
+local counters = {}
+
+local big = {}
+for i = 1, 20000 do big[i] = {i, tostring(i)} end
+
+local function frame (n)
+  for i = 1, 1500 do
+    local id = n * 1500 + i
+    local f = mk(id)
+    keep[id % 4000 + 1] = {f, id}
+    if i % 11 == 0 then
+      setmetatable({}, {__gc = function () finalized = finalized + 1 end})
+    end
+    local k = {id}
+    weakk[k] = {k}
+    weakv[id % 997] = f
+    co({id})
+    -- old objects get new young children (barrier food)
+    local b = big[id % 20000 + 1]
+    b[3] = {id}
+    local c = counters[i % 64 + 1]
+    if c == nil then c = {counter(), 0}; counters[i % 64 + 1] = c end
+    c[2] = c[2] + 1
+    assert(c[1]() == c[2])
+    if i % 500 == 0 then T.spin(0.2) end
+  end
+  for _, e in pairs(keep) do check(e[1], e[2]) end
+  for i = 1, 20000, 97 do
+    local b = big[i]
+    assert(b[1] == i and b[2] == tostring(i))
+  end
+  for _, f in pairs(weakv) do assert(type(f()) == "number") end
+  for k, v in pairs(weakk) do assert(v[1] == k) end
+  if n % 50 == 0 then
+    local s = eris.persist({[print] = 1}, {keep[1], big[5], mk(7)})
+    local r = eris.unpersist({[1] = print}, s)
+    assert(r[2][1] == 5)
+    check(r[3], 7)
+  end
+  if n % 97 == 0 then
+    assert(T.setconcurrentmark(false))
+    assert(T.setconcurrentmark(true))
+  end
+  if n % 60 == 0 then collectgarbage() end
+end
+
+for n = 1, 150 do
+  frame(n)
+  T.spin(0.3)  -- rest of the host's frame
+end
+assert(finalized > 0)
+assert(T.setconcurrentmark(false))
+collectgarbage()
@@ -0,0 +1,90 @@
+-- deferred and time-budgeted collection (LUA_GCDEFER, lua_gcstepfor)
+
+local function garbage (n)
+  for i = 1, n do local t = {i, i + 1, tostring(i)} end
+end
+
+local function kb () return collectgarbage("count") end
+
+-- while deferred, memory grows up to the safety valve (debt at half the
+-- memory in use) instead of being collected
+local keep = {}
+for i = 1, 20000 do keep[i] = {i} end
+collectgarbage("incremental")
+local oldpause = collectgarbage("setpause", 100)  -- a cycle is due at once
+collectgarbage()
+local base = kb()
+assert(T.gcdefer(true) == false)
+local peak = 0
+for i = 1, 100 do
+  garbage(100)
+  peak = math.max(peak, kb())
+end
+assert(peak > base * 1.3, "steps were not deferred")
+assert(peak < base * 2.2 + 512, "safety valve did not hold")
+
+-- idle time pays the debt back
+local done = false
+for i = 1, 1000 do
+  done = T.gcstepfor(1000)
+  if done then break end
+end
+assert(done and kb() < base * 1.2 + 256)
+assert(T.gcdefer(false) == true)
+collectgarbage("setpause", oldpause)
+
+-- without deferral allocation steps as usual
+collectgarbage()
+base = kb()
+garbage(100000)
+assert(kb() < base * 4 + 4096)
+
+-- a stopped collector stays stopped, even in the middle of a cycle
+collectgarbage()
+collectgarbage("step", 0)
+collectgarbage("stop")
+garbage(50000)
+local before = kb()
+for i = 1, 20 do assert(T.gcstepfor(100000) == false) end
+assert(kb() >= before)
+collectgarbage("restart")
+
+-- generational mode: idle time does minor collections only
+collectgarbage("generational")
+keep = {}
+for i = 1, 20000 do keep[i] = {i} end
+collectgarbage()
+for r = 1, 20 do
+  garbage(5000)
+  T.gcstepfor(100000)
+end
+assert(#keep == 20000 and keep[20000][1] == 20000)
+collectgarbage("incremental")
+
+-- background freeing (LUA_USE_BACKGROUNDFREE), with frees slow enough
+-- that the free thread falls behind the collector feeding it
+if T.freethread(0, "") then
+  -- closing a state waits for the batches still queued
+  assert(T.freethread(2000, [[
+    local t = {}
+    for i = 1, 20000 do t[i] = {i} end
+    t = nil
+    collectgarbage()
+    local st = T.freestats()
+    assert(st.batches > 0 and st.pending > 0)
+  ]]) == true)
+
+  -- full collections back to back while the thread lags
+  assert(T.freethread(2000, [[
+    local keep, base = {}, nil
+    for r = 1, 20 do
+      for i = 1, 2000 do keep[i] = {i, tostring(i + r)} end
+      collectgarbage("collect")
+      for i = 1, 2000 do assert(keep[i][2] == tostring(i + r)) end
+      base = base or collectgarbage("count")
+      assert(collectgarbage("count") < base * 1.5)
+    end
+    local st = T.freestats()
+    assert(st.batches > 20 and st.blocks > 20 * 2000)
+  ]]) == true)
+end
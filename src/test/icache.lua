@@ -0,0 +1,91 @@
+-- inline caches of field accesses with constant keys (see 'ICache'):
+-- a cached site must give what an uncached access gives, whatever
+-- happened to the table or its slot since the cache was filled
+
+-- cached sites, and uncached accesses to compare them with (a key in
+-- a register does not go through the cache)
+local function geta (t) return t.a end
+local function getb (t) return t.b end
+local function seta (t, v) t.a = v end
+local function get (t, k) return t[k] end
+
+local function check (t)
+  assert(geta(t) == get(t, "a") and getb(t) == get(t, "b"))
+end
+
+-- a warm site on an unchanged table does not miss
+local t = {a = 1, b = 2, c = 3}
+local icstats = debug.icstats
+check(t)
+icstats(true)
+for i = 1, 100 do check(t) end  -- 't.a', 't.b' and '_ENV.assert'
+local hits, misses = icstats()
+assert(misses == 0 and (hits == 0 or hits == 300))  -- counted or not
+
+-- the key is removed, then collected into a dead key, then reused
+t = {a = 1, b = 2}
+for i = 1, 6 do t["dyn" .. i] = i end
+check(t)
+t.a = nil
+check(t)
+assert(geta(t) == nil)
+for i = 1, 6 do t["dyn" .. i] = nil end
+collectgarbage()  -- the dynamic keys are dead now
+check(t)
+for i = 1, 6 do t["new" .. i] = i; check(t) end  -- may land in dead slots
+seta(t, 10)
+assert(geta(t) == 10 and rawget(t, "a") == 10)
+check(t)
+
+-- tables of the same size with the keys in other slots, or other keys
+-- in the cached slot
+local names = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"}
+math.randomseed(42)
+for round = 1, 500 do
+  local u = {}
+  local n = math.random(0, #names)
+  for i = n, 1, -1 do  -- insertion order decides collisions
+    local j = math.random(#names)
+    u[names[j]] = round + j
+  end
+  if math.random(2) == 1 then
+    u[names[math.random(#names)]] = nil
+  end
+  check(u)
+  seta(u, round)
+  assert(rawget(u, "a") == round)
+  check(u)
+end
+
+-- a rehash to the same size puts the keys back in another order
+t = {}
+for i = 1, 8 do t[names[i]] = i end
+check(t)
+for i = 1, 8 do t[names[i]] = nil end
+for i = 8, 1, -1 do t[names[i]] = -i end
+t.x = nil
+for i = 1, 3 do t["extra" .. i] = i; t["extra" .. i] = nil end
+check(t)
+assert(geta(t) == -1 and getb(t) == -2)
+
+-- a field that became nil goes to the metamethods even on a hit
+local log = {}
+local mt = {
+  __index = function (_, k) return "index " .. k end,
+  __newindex = function (u, k, v) log[#log + 1] = k; rawset(u, k, v) end,
+}
+t = setmetatable({a = 1, b = 2}, mt)
+check(t)
+assert(geta(t) == 1)
+t.a = nil  -- the slot keeps the key, with a nil value
+assert(geta(t) == "index a" and getb(t) == 2)
+seta(t, 5)
+assert(#log == 1 and log[1] == "a" and rawget(t, "a") == 5)
+seta(t, 6)  -- present now: a raw set
+assert(#log == 1 and geta(t) == 6)
+local proto = {a = "inherited"}
+t = setmetatable({b = 1}, {__index = proto, __newindex = proto})
+assert(geta(t) == "inherited")
+seta(t, "changed")
+assert(rawget(t, "a") == nil and proto.a == "changed")
+assert(geta(t) == "changed")
@@ -0,0 +1,40 @@
+-- pinned keys (lua_internkey and friends)
+
+local short = "position"
+local long = string.rep("very_long_field_name_", 3)   -- not interned
+assert(#long > 40)
+
+-- the same name always gives the same handle
+for _, name in ipairs{short, long} do
+  local k1 = T.internkey(name)
+  local k2 = T.internkey(name)
+  assert(k1 == k2)
+  assert(T.pushkey(k1) == name)
+end
+
+-- handles stay valid after collections
+local keys = {}
+for i = 1, 50 do
+  keys[i] = T.internkey(long .. i)
+  assert(T.internkey(long .. i) == keys[i])
+end
+collectgarbage()
+collectgarbage()
+local t = {}
+for i = 1, 50 do
+  T.setkey(t, T.internkey(long .. i), i)
+end
+collectgarbage()
+for i = 1, 50 do
+  assert(t[long .. i] == i)
+  assert(T.getkey(t, keys[i]) == i)
+end
+
+-- keys work as ordinary fields, through metamethods too
+local log = {}
+local p = setmetatable({}, {__newindex = function (_, k, v) log[k] = v end,
+                            __index = function (_, k) return k .. "!" end})
+T.setkey(p, T.internkey(short), 1)
+assert(log[short] == 1 and rawget(p, short) == nil)
+assert(T.getkey(p, T.internkey(long)) == long .. "!")
+
@@ -0,0 +1,81 @@
+-- the lexer: runs of spaces, names, strings and comments are scanned a
+-- block at a time (see llex.c), so every result must be the same however
+-- the input is split into buffers
+
+-- loads 'src' as chunk "t", fed 'size' bytes at a time
+local function loadsplit (src, size)
+  local pos = 1
+  return load(function ()
+    local piece = src:sub(pos, pos + size - 1)
+    pos = pos + size
+    return piece ~= "" and piece or nil
+  end, "=t")
+end
+
+local function result (f, err)
+  if not f then return "error: " .. err end
+  local t = table.pack(pcall(f))
+  for i = 1, t.n do t[i] = string.format("%q", t[i]) end
+  return table.concat(t, ",", 1, t.n)
+end
+
+-- one byte at a time leaves no run to scan, so the character-wise code
+-- does all the work and gives the reference answer
+local sizes = {2, 3, 7, 15, 16, 17, 31, 32, 33, 64}
+local function check (src, expected)
+  local ref = result(loadsplit(src, 1))
+  if expected then
+    assert(ref:find(expected, 1, true), ref)
+  end
+  assert(result(load(src, "=t")) == ref, src)
+  for _, size in ipairs(sizes) do
+    assert(result(loadsplit(src, size)) == ref, src)
+  end
+end
+
+-- line numbers are checked through an error after the interesting part
+local function checklines (src, line)
+  check(src .. "\n@", "t:" .. line + 1 .. ": unexpected symbol near '@'")
+end
+
+-- names and whitespace at every offset around the 16-byte blocks
+for pad = 0, 33 do
+  local sp = string.rep(" ", pad)
+  for len = 1, 40 do
+    local name = string.rep("a", len - 1) .. "Z"
+    check(sp .. "local " .. name .. "_9 = " .. len ..
+          " return " .. name .. "_9" .. sp, tostring(len))
+  end
+  check("return" .. sp .. "\t\v\f" .. sp .. "1", "1")
+  check("local x" .. sp .. "é = 1", "unexpected symbol")
+end
+
+-- short strings: plain runs, escapes and newlines near block edges
+for len = 0, 40 do
+  local body = string.rep("s", len)
+  check("return '" .. body .. "'", body)
+  check('return "' .. body .. '\\"\\n\\z   \n  ' .. body .. '"')
+  check("return '" .. body .. "\\65\\x42\\u{43}\\\n" .. body .. "'")
+  check("return '" .. body .. "\n'", "unfinished string")
+  check("return '" .. body .. "\r'", "unfinished string")
+  check("return '" .. body, "unfinished string")
+  check("return \"" .. body .. "\\", "unfinished string")
+end
+
+-- long strings and comments, with closing brackets that don't close
+for len = 0, 40 do
+  local body = string.rep("L", len)
+  check("return [[" .. body .. "]]", body)
+  check("return [==[" .. body .. "]]]=]\r\n" .. body .. "]==]")
+  check("return [=[\n" .. body .. "\r\n\n\r" .. body .. "]=]")
+  check("return [[" .. body, "unfinished long string")
+  check("return [==[" .. body .. "]=]", "unfinished long string")
+  check("--[[" .. body .. "]] return 1", "1")
+  check("--[==[" .. body .. "]] ]=]\n]==] return 2", "2")
+  check("--[[" .. body, "unfinished long comment")
+  check("-- " .. body .. "\nreturn 3", "3")
+  check("--" .. body)
+  checklines("--[[\n" .. body .. "\n\r\n" .. body .. "]]", 4)
+  checklines("local s = [[" .. body .. "\n\n" .. body .. "]]", 3)
+  checklines("-- " .. body .. "\r\n-- " .. body, 2)
+end
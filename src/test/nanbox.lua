@@ -0,0 +1,90 @@
+-- values packed into NaNs (LUA_NANBOXING): 32-bit integers, number
+-- keys, light userdata payloads and dead keys
+
+if pcall(vec2, 1) then
+  return  -- only with LUA_NANBOXING
+end
+
+local maxi, mini = math.maxinteger, math.mininteger
+
+-- integers are 32 bits and wrap around
+assert(maxi == 2147483647 and mini == -2147483648)
+assert(math.type(maxi) == "integer" and math.type(mini) == "integer")
+assert(maxi + 1 == mini and mini - 1 == maxi)
+assert(maxi * 2 == -2 and -mini == mini)
+assert(mini // -1 == mini and mini % -1 == 0)
+assert(1 << 31 == mini and 1 << 32 == 0 and -1 >> 1 == maxi)
+assert(0xffffffff == -1 and 0x100000000 == 0)  -- hex literals wrap too
+assert(math.tointeger(2^31 - 1) == maxi and math.tointeger(2^31) == nil)
+assert(math.type(2147483648) == "float")  -- decimal ones become floats
+assert(maxi + 1.0 == 2^31 and mini + 0.0 == -2^31)
+assert(string.format("%d", mini) == "-2147483648")
+assert(tostring(maxi) == "2147483647")
+assert(math.ult(maxi, mini) and not math.ult(mini, maxi))
+local n = 0
+for i = mini, mini + 2 do n = n + 1 end
+assert(n == 3)
+
+-- float keys with an integer value are the same key as that integer
+local t = {}
+t[1.0], t[-0.0], t[maxi + 0.0], t[mini + 0.0] = "a", "b", "c", "d"
+assert(t[1] == "a" and t[0] == "b" and t[maxi] == "c" and t[mini] == "d")
+for k in pairs(t) do assert(math.type(k) == "integer") end
+t[2^31], t[-2^31 - 1], t[0.5] = "e", "f", "g"  -- no such integers
+assert(t[mini] == "d" and t[maxi] == "c")
+assert(t[2^31] == "e" and t[-2^31 - 1] == "f" and t[0.5] == "g")
+n = 0
+for k in pairs(t) do
+  if math.type(k) == "float" then n = n + 1 end
+end
+assert(n == 3)
+assert(not pcall(function () t[0/0] = 1 end))
+assert(t[0/0] == nil)
+
+-- light userdata hold 48-bit pointers, including ones with bit 47 set
+local addrs = {16, 2^32, 2^47 - 16, 2^47, 2^48 - 16}
+local keys = {}
+for i, a in ipairs(addrs) do
+  local p = T.lightud(a)
+  assert(type(p) == "userdata" and T.udaddr(p) == a)
+  assert(p == T.lightud(a) and p ~= T.lightud(a - 16))
+  keys[p] = i
+end
+for i, a in ipairs(addrs) do assert(keys[T.lightud(a)] == i) end
+assert(T.lightud(5) ~= 5 and keys[16] == nil)  -- not the integer payload
+-- pointers using the top 16 bits would clash with the tag bits
+for _, a in ipairs{2^48, 2^48 + 16, 2^63} do
+  local ok, err = pcall(T.lightud, a)
+  assert(not ok and string.find(err, "does not fit"))
+end
+
+-- 'next' still finds its way after a key is removed and collected,
+-- which turns it into a dead key
+local function check (t, n)
+  local seen, count = {}, 0
+  for k, v in next, t do
+    assert(not seen[k] and v == true)
+    seen[k] = true
+    count = count + 1
+    t[k] = nil
+    collectgarbage()  -- the removed key may now be dead
+  end
+  assert(count == n and next(t) == nil)
+end
+t = {}
+for i = 1, 100 do
+  t[{}] = true
+  t["key" .. i] = true
+  t[i + 0.5] = true
+  t[T.lightud(i * 16)] = true
+end
+check(t, 400)
+t = setmetatable({}, {__mode = "k"})
+local strong = {}
+for i = 1, 50 do
+  local k = {}
+  t[k] = true
+  if i % 2 == 0 then strong[i] = k end
+end
+collectgarbage()  -- half the keys die under the traversal
+check(t, 25)
@@ -0,0 +1,95 @@
+-- string patterns: compiled patterns and the pattern cache
+
+-- Lua code run in the middle of a gsub (replacement functions, __index
+-- of a replacement table, finalizers) must not disturb the outer call,
+-- even when it evicts every entry of the pattern cache
+local function churn ()
+  for i = 1, 40 do string.find("abc", "b" .. i .. "%d*") end
+end
+
+local s, n = ("k1=v1 k2=v2 k3=v3 k4=v4"):gsub("(%w+)=(%w+)",
+  function (k, v) churn() return v .. "=" .. k end)
+assert(s == "v1=k1 v2=k2 v3=k3 v4=k4" and n == 4)
+
+local tbl = setmetatable({}, {__index = function (_, k)
+  churn() return k:upper() end})
+s, n = ("one two three"):gsub("%a+", tbl)
+assert(s == "ONE TWO THREE" and n == 3)
+
+local r = {}
+for k, v in ("a=1, b=2, c=3"):gmatch("(%w+)=(%w+)") do
+  churn()
+  r[#r + 1] = k .. v
+end
+assert(table.concat(r, " ") == "a1 b2 c3")
+
+-- finalizers that use patterns while a gsub buffer grows
+do
+  local function fin () string.match("xyz", "y+" .. math.random(1000)) end
+  local big = string.rep("ab", 20000)
+  s, n = big:gsub("a(b)", function (c)
+    setmetatable({}, {__gc = fin})
+    return c .. c
+  end)
+  assert(n == 20000 and s == string.rep("bb", 20000))
+end
+
+-- more distinct patterns than cache entries, reused in turn
+for round = 1, 3 do
+  for i = 1, 50 do
+    local p = "x" .. i .. "(%d+)"
+    assert(("ax" .. i .. "42b"):match(p) == "42")
+    assert(("ax" .. i .. "42b"):find(p) == 2)
+  end
+end
+
+-- the same text as anchored and unanchored pattern
+assert(("^a"):gsub("^a", "-") == "^a" and ("a^a"):gsub("^a", "-") == "-^a")
+assert(select(2, ("^a^a"):gsub("^a", "")) == 0)
+local c = 0
+for _ in ("^a^a"):gmatch("^a") do c = c + 1 end  -- '^' is literal here
+assert(c == 2)
+
+-- literal prefixes and specials
+assert(("x$y"):find("x$y") == 1 and ("xy"):find("y$") == 2)
+assert(("a]b"):match("[]]") == "]" and ("a]b"):match("[^]]+") == "a")
+assert(("f(a(b)c)d"):match("%b()") == "(a(b)c)")
+assert(("THE (quick) fox"):find("%f[%a]%a+", 5) == 6)
+assert(("abab"):match("(ab)%1") == "ab")
+assert(("a\0b"):find("\0", 1, true) == 2 and ("a\0b"):find("%z") == 2)
+assert(("hello world"):find("o w") == 5)
+assert(("aaa"):find("aaaa") == nil)
+local long = string.rep("ab", 100) .. "c"
+assert(long:find(string.rep("ab", 60) .. "c") == 81)   -- too long to compile
+
+-- errors are the same as from the interpreter
+local function err (p, msg, subj)
+  local ok, e = pcall(string.match, subj or "abc", p)
+  assert(not ok and e:find(msg, 1, true), p)
+end
+err("%", "ends with '%'")
+err("[a", "missing ']'")
+err("%b", "missing arguments to '%b'")
+err("%f", "missing '[' after '%f' in pattern")
+err("(a)%2", "invalid capture index")
+err("(", "unfinished capture")
+err(")", "invalid pattern capture")
+err(string.rep("(a)", 33), "too many captures", string.rep("a", 40))
+
+-- classes follow the current LC_CTYPE locale, not the one in effect when
+-- the pattern was first cached (patterns over 96 characters are never
+-- compiled, so they give the interpreter's answer)
+local slow = "^(%a)" .. string.rep("x?", 50) .. "$"
+local function checkclasses ()
+  for c = 0, 255 do
+    local ch = string.char(c)
+    assert(ch:match("^(%a)$") == ch:match(slow))
+    assert((ch:find("[%l%d]")) == (ch:find("[%l%d]" .. string.rep("x?", 50))))
+  end
+end
+local old = os.setlocale(nil, "ctype")
+for _, loc in ipairs{"C", "C.UTF-8", "en_US.ISO-8859-1", "de_DE.ISO8859-1",
+                     "fr_FR", "pt_BR", "C"} do
+  if os.setlocale(loc, "ctype") then checkclasses() end
+end
+os.setlocale(old, "ctype")
@@ -0,0 +1,26 @@
+-- persisting values with eris: format version
+
+local hasvec2 = pcall(vec2, 1)  -- not with LUA_NANBOXING
+
+local perms, uperms = {}, {}
+local v = {n = 1, s = "str", f = function (x) return x * 2 end,
+           p = hasvec2 and vec2(1.5, -2), nested = {true, false, 3.25}}
+local data = eris.persist(perms, v)
+assert(data:sub(1, 4) == "ERIS")
+local w = eris.unpersist(uperms, data)
+assert(w.n == 1 and w.s == "str" and w.f(21) == 42)
+assert(w.nested[3] == 3.25)
+assert(not hasvec2 or w.p == vec2(1.5, -2))
+
+-- data written before the format had a version is rejected, not misread
+local old = "ERIS" .. data:sub(6)
+local ok, err = pcall(eris.unpersist, uperms, old)
+assert(not ok and err:find("older version of eris"), err)
+old = "ERIS\0\0\0\0" .. data:sub(6)
+ok, err = pcall(eris.unpersist, uperms, old)
+assert(not ok and err:find("older version of eris"), err)
+
+-- as is data from a newer format
+local newer = "ERIS" .. string.char(data:byte(5) + 1) .. data:sub(6)
+ok, err = pcall(eris.unpersist, uperms, newer)
+assert(not ok and err:find("format version"), err)
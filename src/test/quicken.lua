@@ -0,0 +1,83 @@
+-- quickened instructions (OP_ADDII etc.): code leaving the interpreter
+-- is generic, and sites whose operand types keep changing stay correct
+
+local function count (f, name)
+  local n = 0
+  for _, op in ipairs(T.opcodes(f)) do
+    if op == name then n = n + 1 end
+  end
+  return n
+end
+
+-- a hot loop quickens its ADDs and its LT
+local function loop ()
+  local s, i = 0, 0
+  while i < 1000 do s = s + i; i = i + 1 end
+  return s
+end
+assert(count(loop, "ADD") == 2 and count(loop, "LT") == 1)
+local cold = string.dump(loop)
+local pcold = eris.persist({}, loop)
+assert(loop() == 499500)
+assert(count(loop, "ADDII") == 2 and count(loop, "LTII") == 1)
+assert(count(loop, "ADD") == 0 and count(loop, "LT") == 0)
+
+-- dumps and persisted data hold the generic opcodes
+local hot = string.dump(loop)
+assert(hot == cold)
+assert(T.freshstate(hot) == "499500")
+local f = load(hot, "=loop", "b")
+assert(count(f, "ADD") == 2 and count(f, "ADDII") == 0)
+assert(f() == 499500 and count(f, "ADDII") == 2)
+local phot = eris.persist({}, loop)
+assert(phot == pcold)
+f = eris.unpersist({}, phot)
+assert(count(f, "ADD") == 2 and count(f, "LTII") == 0)
+assert(f() == 499500 and count(f, "LTII") == 1)
+
+-- one site flipping between operand types many more times than the
+-- MAXDEOPTS (4) undos after which it stays generic
+local function add (a, b) return a + b end
+local function lt (a, b) return a < b end
+local V = setmetatable({}, {
+  __add = function (a, b) return "meta" end,
+  __lt = function (a, b) return true end,
+})
+local cases = {  -- a, b, a + b, a < b
+  {1, 2, 3, true}, {2.5, 1, 3.5, false}, {"10", 5, 15.0, nil},
+  {V, 1, "meta", nil}, {-3, 4, 1, true}, {0.5, 0.25, 0.75, false},
+  {V, V, "meta", true}, {"a", "b", nil, true},
+}
+for round = 1, 5 do
+  for _, c in ipairs(cases) do
+    local a, b, sum, less = c[1], c[2], c[3], c[4]
+    if sum ~= nil then
+      local r = add(a, b)
+      assert(r == sum and math.type(r) == math.type(sum))
+    end
+    if less ~= nil then assert(lt(a, b) == less) end
+  end
+end
+assert(count(add, "ADD") == 1 and count(lt, "LT") == 1)
+for i = 1, 10 do assert(add(i, i) == 2 * i) end
+assert(count(add, "ADD") == 1)  -- no longer quickened
+
+-- errors raised from a quickened site name the generic operation
+local function addnil (a, b) return a + b end
+local function ltnil (a, b) return a < b end
+for i = 1, 10 do addnil(i, i); ltnil(i, i) end
+assert(count(addnil, "ADDII") == 1 and count(ltnil, "LTII") == 1)
+local ok, err = pcall(addnil, 1, nil)
+assert(not ok and
+       string.find(err, "perform arithmetic on a nil value %(local 'b'%)"))
+ok, err = pcall(ltnil, 1, nil)
+assert(not ok and string.find(err, "attempt to compare number with nil"))
+for i = 1, 10 do addnil(i, i) end
+local W = setmetatable({}, {__add = function () error("in add") end})
+local tb
+ok, err = xpcall(addnil, function (m)
+  tb = debug.traceback(m)
+  return m
+end, 1, W)
+assert(not ok and string.find(err, "in add"))
+assert(string.find(tb, "in metamethod '__add'"), tb)
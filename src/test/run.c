@@ -0,0 +1,539 @@
+/*
+** Runs the regression scripts given on the command line, e.g.
+**   ./run keys.lua strings.lua
+** Each script runs in a fresh state that has the standard libraries
+** plus a 'T' table with hooks into the C API that plain Lua code
+** cannot reach. A script fails by raising an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#include "lbuflib.h"
+
+#include "lobject.h"  /* for hooks that read the core's own structures */
+#include "lopcodes.h"
+#include "lstate.h"
+
+
+/*
+** {======================================================
+** Pinned keys
+** =======================================================
+*/
+
+static int t_internkey (lua_State *L) {
+  lua_pushlightuserdata(L, (void *)lua_internkey(L, luaL_checkstring(L, 1)));
+  return 1;
+}
+
+
+static lua_Key checkkey (lua_State *L, int arg) {
+  luaL_checktype(L, arg, LUA_TLIGHTUSERDATA);
+  return (lua_Key)lua_touserdata(L, arg);
+}
+
+
+static int t_getkey (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_getkey(L, 1, checkkey(L, 2));
+  return 1;
+}
+
+
+static int t_setkey (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_settop(L, 3);
+  lua_setkey(L, 1, checkkey(L, 2));
+  return 0;
+}
+
+
+static int t_pushkey (lua_State *L) {
+  lua_pushkey(L, checkkey(L, 1));
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Chunk cache
+** =======================================================
+*/
+
+static int t_setchunkcache (lua_State *L) {
+  luaL_setchunkcache(L, luaL_optstring(L, 1, NULL),
+                        (int)luaL_optinteger(L, 2, 0));
+  return 0;
+}
+
+
+static int t_chunkcachestats (lua_State *L) {
+  const luaL_ChunkCacheStats *st = luaL_chunkcachestats(L);
+  if (st == NULL) return 0;
+  lua_createtable(L, 0, 4);
+  lua_pushinteger(L, (lua_Integer)st->hits);
+  lua_setfield(L, -2, "hits");
+  lua_pushinteger(L, (lua_Integer)st->misses);
+  lua_setfield(L, -2, "misses");
+  lua_pushinteger(L, (lua_Integer)st->stale);
+  lua_setfield(L, -2, "stale");
+  lua_pushinteger(L, (lua_Integer)st->writes);
+  lua_setfield(L, -2, "writes");
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Collector
+** =======================================================
+*/
+
+static int t_gcdefer (lua_State *L) {
+  lua_pushboolean(L, lua_gc(L, LUA_GCDEFER, lua_toboolean(L, 1)));
+  return 1;
+}
+
+
+static int t_gcstepfor (lua_State *L) {
+  lua_pushboolean(L, lua_gcstepfor(L, (int)luaL_checkinteger(L, 1)));
+  return 1;
+}
+
+
+static int t_setconcurrentmark (lua_State *L) {
+  lua_pushboolean(L, lua_setconcurrentmark(L, lua_toboolean(L, 1)));
+  return 1;
+}
+
+
+static int t_setbulkfree (lua_State *L) {
+  lua_pushboolean(L, lua_setbulkfree(L, lua_toboolean(L, 1)));
+  return 1;
+}
+
+
+/* 'lua_setbulkfree' on a fresh region state, which runs 'code' */
+static int t_regionbulkfree (lua_State *L) {
+  lua_State *R = luaL_newregionstate((size_t)luaL_checkinteger(L, 1));
+  const char *code = luaL_checkstring(L, 2);
+  int res;
+  if (R == NULL)
+    return luaL_error(L, "cannot create region state");
+  res = lua_setbulkfree(R, 1);
+  luaL_openlibs(R);
+  if (luaL_dostring(R, code) != LUA_OK)
+    lua_pushstring(L, lua_tostring(R, -1));
+  else
+    lua_pushboolean(L, res);
+  lua_close(R);
+  return 1;
+}
+
+
+/*
+** Pools and regions driven by hand: 'T.poolalloc(pool, block, osize,
+** nsize)' and 'T.regionalloc(region, ...)' call the allocator directly.
+** Blocks are filled with the low byte of their size and the bytes a
+** resize keeps are checked against the old one, so a move between
+** classes that loses data fails the call.
+*/
+static int pushblock (lua_State *L, unsigned char *block, size_t keep,
+                      size_t osize, size_t nsize) {
+  size_t i;
+  if (block == NULL) {
+    lua_pushnil(L);
+    return 1;
+  }
+  for (i = 0; i < keep; i++) {
+    if (block[i] != (unsigned char)osize)
+      return luaL_error(L, "byte %d lost in resize", (int)i);
+  }
+  memset(block, (unsigned char)nsize, nsize);
+  lua_pushlightuserdata(L, block);
+  return 1;
+}
+
+
+#define keptbytes(b,o,n)	((b) == NULL ? 0 : (o) < (n) ? (o) : (n))
+
+
+static luaL_Pool *checkpool (lua_State *L) {
+  luaL_Pool **p = (luaL_Pool **)luaL_checkudata(L, 1, "T.pool");
+  luaL_argcheck(L, *p != NULL, 1, "pool is freed");
+  return *p;
+}
+
+
+static int t_freepool (lua_State *L) {
+  luaL_Pool **p = (luaL_Pool **)luaL_checkudata(L, 1, "T.pool");
+  luaL_freepool(*p);
+  *p = NULL;
+  return 0;
+}
+
+
+static int t_newpool (lua_State *L) {
+  luaL_Pool **p = (luaL_Pool **)lua_newuserdata(L, sizeof(luaL_Pool *));
+  *p = NULL;
+  if (luaL_newmetatable(L, "T.pool")) {
+    lua_pushcfunction(L, t_freepool);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_setmetatable(L, -2);
+  if ((*p = luaL_newpool()) == NULL)
+    return luaL_error(L, "cannot create pool");
+  return 1;
+}
+
+
+static int t_poolalloc (lua_State *L) {
+  luaL_Pool *p = checkpool(L);
+  void *block = lua_touserdata(L, 2);
+  size_t osize = (size_t)luaL_checkinteger(L, 3);
+  size_t nsize = (size_t)luaL_checkinteger(L, 4);
+  size_t keep = keptbytes(block, osize, nsize);
+  block = luaL_poolalloc(p, block, osize, nsize);
+  return pushblock(L, (unsigned char *)block, keep, osize, nsize);
+}
+
+
+/* a region is the allocator of a region state that runs no code */
+static lua_State *checkregion (lua_State *L) {
+  lua_State **R = (lua_State **)luaL_checkudata(L, 1, "T.region");
+  luaL_argcheck(L, *R != NULL, 1, "region is freed");
+  return *R;
+}
+
+
+static int t_freeregion (lua_State *L) {
+  lua_State **R = (lua_State **)luaL_checkudata(L, 1, "T.region");
+  if (*R != NULL)
+    lua_close(*R);
+  *R = NULL;
+  return 0;
+}
+
+
+static int t_newregion (lua_State *L) {
+  size_t quota = (size_t)luaL_checkinteger(L, 1);
+  lua_State **R = (lua_State **)lua_newuserdata(L, sizeof(lua_State *));
+  *R = NULL;
+  if (luaL_newmetatable(L, "T.region")) {
+    lua_pushcfunction(L, t_freeregion);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_setmetatable(L, -2);
+  if ((*R = luaL_newregionstate(quota)) == NULL)
+    return luaL_error(L, "cannot create region state");
+  return 1;
+}
+
+
+static int t_regionalloc (lua_State *L) {
+  void *ud;
+  lua_Alloc f = lua_getallocf(checkregion(L), &ud);
+  void *block = lua_touserdata(L, 2);
+  size_t osize = (size_t)luaL_checkinteger(L, 3);
+  size_t nsize = (size_t)luaL_checkinteger(L, 4);
+  size_t keep = keptbytes(block, osize, nsize);
+  block = (*f)(ud, block, osize, nsize);
+  return pushblock(L, (unsigned char *)block, keep, osize, nsize);
+}
+
+
+static void setsize (lua_State *L, const char *k, size_t v) {
+  lua_pushinteger(L, (lua_Integer)v);
+  lua_setfield(L, -2, k);
+}
+
+
+/* the stats of a 'T.newpool' pool, or of this state's if none given */
+static int t_poolstats (lua_State *L) {
+  const luaL_PoolStats *st;
+  int c;
+  if (lua_isnoneornil(L, 1))
+    st = luaL_poolstats(L);
+  else
+    st = luaL_getpoolstats(checkpool(L));
+  if (st == NULL)
+    return 0;
+  lua_createtable(L, 0, 7);
+  setsize(L, "live", st->live);
+  setsize(L, "peak", st->peak);
+  setsize(L, "reserved", st->reserved);
+  setsize(L, "large_live", st->large_live);
+  setsize(L, "large_count", st->large_count);
+  setsize(L, "large_allocs", st->large_allocs);
+  lua_createtable(L, LUAL_POOL_NCLASSES, 0);
+  for (c = 0; c < LUAL_POOL_NCLASSES; c++) {
+    lua_createtable(L, 0, 4);
+    setsize(L, "size", st->classes[c].size);
+    setsize(L, "live", st->classes[c].live);
+    setsize(L, "allocs", st->classes[c].allocs);
+    setsize(L, "slabs", st->classes[c].slabs);
+    lua_rawseti(L, -2, c + 1);
+  }
+  lua_setfield(L, -2, "classes");
+  return 1;
+}
+
+
+/* the stats of a 'T.newregion' region, or of this state's if none given */
+static int t_regionstats (lua_State *L) {
+  const luaL_RegionStats *st;
+  if (lua_isnoneornil(L, 1))
+    st = luaL_regionstats(L);
+  else
+    st = luaL_regionstats(checkregion(L));
+  if (st == NULL)
+    return 0;
+  lua_createtable(L, 0, 5);
+  setsize(L, "live", st->live);
+  setsize(L, "peak", st->peak);
+  setsize(L, "used", st->used);
+  setsize(L, "committed", st->committed);
+  setsize(L, "quota", st->quota);
+  return 1;
+}
+
+
+static int t_freestats (lua_State *L) {
+  lua_FreeStats st;
+  if (!lua_getfreestats(L, &st))
+    return 0;
+  lua_createtable(L, 0, 6);
+  lua_pushinteger(L, (lua_Integer)st.blocks);
+  lua_setfield(L, -2, "blocks");
+  lua_pushinteger(L, (lua_Integer)st.batches);
+  lua_setfield(L, -2, "batches");
+  lua_pushinteger(L, (lua_Integer)st.direct);
+  lua_setfield(L, -2, "direct");
+  lua_pushinteger(L, (lua_Integer)st.pending);
+  lua_setfield(L, -2, "pending");
+  return 1;
+}
+
+
+/* an allocator whose frees are slow, so that a free thread lags */
+static void *lagalloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  (void)osize;
+  if (nsize == 0) {
+    volatile int i;
+    for (i = 0; i < *(const int *)ud; i++) ;
+    free(ptr);
+    return NULL;
+  }
+  return realloc(ptr, nsize);
+}
+
+
+/*
+** Runs 'code' in a fresh state with a free thread, whose frees spin
+** 'lag' times first; the state is closed right after, with whatever
+** the thread has not freed yet. The code gets 'T.freestats' only.
+** Returns false if this build has no free thread.
+*/
+static int t_freethread (lua_State *L) {
+  int lag = (int)luaL_checkinteger(L, 1);
+  const char *code = luaL_checkstring(L, 2);
+  lua_State *R = lua_newstate(lagalloc, &lag);
+  if (R == NULL)
+    return luaL_error(L, "cannot create state");
+  if (!lua_setbackgroundfree(R, 1))
+    lua_pushboolean(L, 0);
+  else {
+    luaL_openlibs(R);
+    lua_createtable(R, 0, 1);
+    lua_pushcfunction(R, t_freestats);
+    lua_setfield(R, -2, "freestats");
+    lua_setglobal(R, "T");
+    if (luaL_dostring(R, code) != LUA_OK)
+      lua_pushstring(L, lua_tostring(R, -1));
+    else
+      lua_pushboolean(L, 1);
+  }
+  lua_close(R);
+  return 1;
+}
+
+
+/* busy host work outside the core, for the marker to overlap with */
+static int t_spin (lua_State *L) {
+  clock_t end = clock() + (clock_t)(luaL_checknumber(L, 1) / 1000 *
+                                    CLOCKS_PER_SEC);
+  while (clock() < end) ;
+  return 0;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Light userdata
+** =======================================================
+*/
+
+/* addresses are floats, which hold more bits than a 32-bit integer */
+static int t_lightud (lua_State *L) {
+  lua_pushlightuserdata(L, (void *)(size_t)luaL_checknumber(L, 1));
+  return 1;
+}
+
+
+static int t_udaddr (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TLIGHTUSERDATA);
+  lua_pushnumber(L, (lua_Number)(size_t)lua_touserdata(L, 1));
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Strings
+** =======================================================
+*/
+
+/* size and number of entries of the string table */
+static int t_strtab (lua_State *L) {
+  lua_pushinteger(L, G(L)->strt.size);
+  lua_pushinteger(L, G(L)->strt.nuse);
+  return 2;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Quickening
+** =======================================================
+*/
+
+/* opcode names of a Lua function as they are now, quickened or not */
+static int t_opcodes (lua_State *L) {
+  const Proto *p;
+  int pc;
+  luaL_argcheck(L, lua_isfunction(L, 1) && !lua_iscfunction(L, 1), 1,
+                "Lua function expected");
+  p = ((const LClosure *)lua_topointer(L, 1))->p;
+  lua_createtable(L, p->sizecode, 0);
+  for (pc = 0; pc < p->sizecode; pc++) {
+    lua_pushstring(L, luaP_opnames[GET_OPCODE(p->code[pc])]);
+    lua_rawseti(L, -2, pc + 1);
+  }
+  return 1;
+}
+
+
+/* runs 'code' in a fresh state; returns its first result as a string */
+static int t_freshstate (lua_State *L) {
+  size_t len;
+  const char *code = luaL_checklstring(L, 1, &len);
+  lua_State *R = luaL_newstate();
+  if (R == NULL)
+    return luaL_error(L, "cannot create state");
+  luaL_openlibs(R);
+  if (luaL_loadbufferx(R, code, len, "=fresh", NULL) != LUA_OK ||
+      lua_pcall(R, 0, 1, 0) != LUA_OK) {
+    lua_pushnil(L);
+    lua_pushstring(L, lua_tostring(R, -1));
+    lua_close(R);
+    return 2;
+  }
+  lua_pushstring(L, luaL_tolstring(R, -1, NULL));
+  lua_close(R);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Buffers
+** =======================================================
+*/
+
+/* where the elements of a buffer start, modulo 'm' */
+static int t_bufaddr (lua_State *L) {
+  void *p = luaL_checktypedbuf(L, 1, -1, NULL);
+  lua_pushinteger(L, (lua_Integer)((size_t)p % luaL_checkinteger(L, 2)));
+  return 1;
+}
+
+/* }====================================================== */
+
+
+static const luaL_Reg tests[] = {
+  {"internkey", t_internkey},
+  {"getkey", t_getkey},
+  {"setkey", t_setkey},
+  {"pushkey", t_pushkey},
+  {"setchunkcache", t_setchunkcache},
+  {"chunkcachestats", t_chunkcachestats},
+  {"gcdefer", t_gcdefer},
+  {"gcstepfor", t_gcstepfor},
+  {"setconcurrentmark", t_setconcurrentmark},
+  {"spin", t_spin},
+  {"freethread", t_freethread},
+  {"setbulkfree", t_setbulkfree},
+  {"regionbulkfree", t_regionbulkfree},
+  {"newpool", t_newpool},
+  {"freepool", t_freepool},
+  {"poolalloc", t_poolalloc},
+  {"poolstats", t_poolstats},
+  {"newregion", t_newregion},
+  {"freeregion", t_freeregion},
+  {"regionalloc", t_regionalloc},
+  {"regionstats", t_regionstats},
+  {"lightud", t_lightud},
+  {"udaddr", t_udaddr},
+  {"strtab", t_strtab},
+  {"opcodes", t_opcodes},
+  {"freshstate", t_freshstate},
+  {"bufaddr", t_bufaddr},
+  {NULL, NULL}
+};
+
+
+static int runscript (const char *name) {
+  int status;
+  lua_State *L = luaL_newstate();
+  if (L == NULL) {
+    fprintf(stderr, "%s: cannot create state\n", name);
+    return 0;
+  }
+  luaL_openlibs(L);
+  luaL_newlib(L, tests);
+  lua_setglobal(L, "T");
+  status = luaL_dofile(L, name);
+  if (status != LUA_OK)
+    fprintf(stderr, "%s: %s\n", name, lua_tostring(L, -1));
+  else
+    printf("%s: ok\n", name);
+  lua_close(L);
+  return status == LUA_OK;
+}
+
+
+int main (int argc, char **argv) {
+  int i, failed = 0;
+  for (i = 1; i < argc; i++)
+    failed += !runscript(argv[i]);
+  return failed != 0;
+}
+
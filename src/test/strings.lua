@@ -0,0 +1,69 @@
+-- interning of short strings and sizing of the string table
+-- (MINSTRTABSIZE and STRTABQUICKGROW in llimits.h)
+
+-- short strings (up to LUAI_MAXSHORTLEN, 40) that differ in one byte are
+-- different objects, and equal ones built apart are the same object
+-- (comparing short strings compares the objects, not their bytes)
+local bytes = {0, 1, 0x20, 0x61, 0x62, 0x7f, 0x80, 0xfe, 0xff}
+for len = 0, 40 do
+  local base = string.rep("a", len)
+  local keys, n = {[base] = true}, 1
+  for pos = 1, len do
+    for _, b in ipairs(bytes) do
+      local v = base:sub(1, pos - 1) .. string.char(b) .. base:sub(pos + 1)
+      local w = string.rep("a", pos - 1) .. string.char(b) ..
+                string.rep("a", len - pos)
+      assert(v == w)
+      if b ~= 0x61 then
+        assert(v ~= base and not keys[v])
+        keys[v] = true
+        n = n + 1
+      end
+    end
+  end
+  local count = 0
+  for _ in pairs(keys) do count = count + 1 end
+  assert(count == n and n == 1 + len * (#bytes - 1))
+end
+-- every value of the first and last byte of the lengths hashed as a
+-- whole word
+for len = 1, 8 do
+  local keys = {}
+  for b = 0, 255 do
+    local first = string.char(b) .. string.rep("x", len - 1)
+    local last = string.rep("x", len - 1) .. string.char(b)
+    keys[first] = (keys[first] or 0) + 1
+    keys[last] = (keys[last] or 0) + 1
+  end
+  local count = 0
+  for _, c in pairs(keys) do
+    count = count + 1
+    assert(c == 1 or c == 2)  -- 2 only for all-'x' (or len 1)
+  end
+  assert(count == (len == 1 and 256 or 511))
+end
+
+-- the table never goes below MINSTRTABSIZE, grows 4x up to
+-- STRTABQUICKGROW and 2x after that, and shrinks back once the strings
+-- are gone
+local MIN, QUICK = 1024, 1 << 16
+collectgarbage()
+local size, nuse = T.strtab()
+assert(size >= MIN and nuse <= size)
+local keep, sizes = {}, {size}
+for i = 1, 300000 do
+  keep[i] = "s" .. i
+  local s = T.strtab()
+  if s ~= sizes[#sizes] then sizes[#sizes + 1] = s end
+end
+assert(sizes[#sizes] >= 300000)
+for i = 2, #sizes do
+  local grow = sizes[i] // sizes[i - 1]
+  assert(grow == (sizes[i - 1] < QUICK and 4 or 2))
+end
+local big = sizes[#sizes]
+keep = nil
+for i = 1, 20 do collectgarbage() end
+size, nuse = T.strtab()
+assert(size < big // 64)
+assert(size >= MIN and (size == MIN or nuse >= size // 8))
@@ -0,0 +1,71 @@
+-- vec2 values: arithmetic, fields and use as table keys
+
+if not pcall(vec2, 1) then
+  return  -- not with LUA_NANBOXING
+end
+
+local function eq (v, x, y)
+  return type(v) == "vec2" and v.x == x and v.y == y
+end
+
+-- arithmetic with vectors and scalars (components are single floats,
+-- so every value below is exact)
+local a, b = vec2(1.5, -2), vec2(0.25, 4)
+assert(eq(vec2(3), 3, 3) and eq(vec2(1, 2), 1, 2))
+assert(eq(a + b, 1.75, 2) and eq(a - b, 1.25, -6))
+assert(eq(a * b, 0.375, -8) and eq(a / b, 6, -0.5))
+assert(eq(a * 2, 3, -4) and eq(2 * a, 3, -4) and eq(a * 0.5, 0.75, -1))
+assert(eq(a / 2, 0.75, -1) and eq(1 / b, 4, 0.25))
+assert(eq(-a, -1.5, 2) and eq(- -a, 1.5, -2))
+assert(eq(a * 2 + b / 0.5, 3.5, 4))
+assert(a == vec2(1.5, -2) and a ~= b and a ~= 1.5)
+for _, f in ipairs{
+  function () return a + 1 end, function () return 1 - a end,
+  function () return a % b end, function () return a // 2 end,
+  function () return a ^ 2 end, function () return a * "x" end,
+  function () return a < b end,
+} do
+  assert(not pcall(f))
+end
+local acc = vec2(0)
+for i = 1, 1000 do acc = acc + vec2(i, -i) * 0.5 end  -- hot, quickened
+assert(eq(acc, 250250, -250250))
+
+-- 'x' and 'y' are fields; other keys go to the metatable of vec2s
+assert(a.x == 1.5 and a.y == -2 and math.type(a.x) == "float")
+local k = "y"
+assert(a[k] == -2)
+assert(not pcall(function () return a.z end))
+assert(not pcall(function () return a[1] end))
+assert(not pcall(function () a.x = 0 end))
+local sum = 0
+for i = 1, 1000 do local v = vec2(i, 2 * i); sum = sum + v.x + v.y end
+assert(sum == 3 * 500500)
+debug.setmetatable(a, {__index = {dot = function (u, v)
+  return u.x * v.x + u.y * v.y
+end}})
+assert(a:dot(b) == 0.375 - 8 and a.x == 1.5)  -- 'x' is still a field
+assert(a.nothing == nil)
+debug.setmetatable(a, nil)
+
+-- equal vectors are the same key, NaNs are not keys at all
+local t = {}
+t[vec2(1, 2)] = "a"
+assert(t[vec2(1, 2)] == "a" and t[vec2(2, 1)] == nil)
+t[vec2(0, 1)] = "zero"
+assert(t[vec2(-0.0, 1)] == "zero")  -- -0 == 0, so the same slot
+t[vec2(-0.0, 1)] = "negzero"
+assert(t[vec2(0, 1)] == "negzero")
+for i = 1, 1000 do t[vec2(i, -i)] = i end  -- through a few rehashes
+for i = 1, 1000 do assert(t[vec2(i, -i)] == i and t[vec2(-i, i)] == nil) end
+local n = 0
+for key, v in pairs(t) do
+  assert(type(key) == "vec2")
+  n = n + 1
+end
+assert(n == 1002)
+local ok, err = pcall(function () t[vec2(0/0, 1)] = 1 end)
+assert(not ok and string.find(err, "table index is NaN"))
+ok, err = pcall(rawset, t, vec2(1, 0/0), 1)
+assert(not ok and string.find(err, "table index is NaN"))
+assert(t[vec2(0/0, 1)] == nil)
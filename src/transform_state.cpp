@@ -0,0 +1,98 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_STATE_SSE 1
+#endif
+
+#include "asserts.hpp"
+#include "transform_state.hpp"
+
+namespace game
+{
+	TransformState::TransformState()
+		: size_(0),
+		  prev_x_(),
+		  prev_y_(),
+		  cur_x_(),
+		  cur_y_(),
+		  out_x_(),
+		  out_y_()
+	{
+	}
+
+	void TransformState::resize(size_t n)
+	{
+		if(n <= size_) {
+			return;
+		}
+		size_ = n;
+		const size_t padded = (n + 3) & ~size_t(3);
+		for(auto v : { &prev_x_, &prev_y_, &cur_x_, &cur_y_, &out_x_, &out_y_ }) {
+			v->resize(padded, 0.0f);
+		}
+	}
+
+	void TransformState::reset(uint32_t index, float x, float y)
+	{
+		if(index >= size_) {
+			resize(index + 1);
+		}
+		prev_x_[index] = cur_x_[index] = out_x_[index] = x;
+		prev_y_[index] = cur_y_[index] = out_y_[index] = y;
+	}
+
+	void TransformState::beginStep()
+	{
+		std::copy(cur_x_.cbegin(), cur_x_.cend(), prev_x_.begin());
+		std::copy(cur_y_.cbegin(), cur_y_.cend(), prev_y_.begin());
+	}
+
+	void TransformState::interpolate(float alpha, size_t first, size_t last)
+	{
+		ASSERT_LOG((first & 3) == 0, "Interpolation range must start on a multiple of four: {}", first);
+		const size_t count = std::min((last + 3) & ~size_t(3), cur_x_.size());
+		const float* px = prev_x_.data();
+		const float* py = prev_y_.data();
+		const float* cx = cur_x_.data();
+		const float* cy = cur_y_.data();
+		float* ox = out_x_.data();
+		float* oy = out_y_.data();
+#if defined(TRANSFORM_STATE_SSE)
+		const __m128 a = _mm_set1_ps(alpha);
+		for(size_t n = first; n < count; n += 4) {
+			const __m128 x0 = _mm_loadu_ps(px + n);
+			const __m128 y0 = _mm_loadu_ps(py + n);
+			_mm_storeu_ps(ox + n, _mm_add_ps(x0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(cx + n), x0), a)));
+			_mm_storeu_ps(oy + n, _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(cy + n), y0), a)));
+		}
+#else
+		for(size_t n = first; n < count; ++n) {
+			ox[n] = px[n] + (cx[n] - px[n]) * alpha;
+			oy[n] = py[n] + (cy[n] - py[n]) * alpha;
+		}
+#endif
+	}
+}
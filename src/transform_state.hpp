@@ -0,0 +1,75 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace game
+{
+	// Positions of every simulated object, kept as two snapshots: where things were at the start of
+	// the last fixed simulation step and where they are now. Rendering blends between the two using
+	// the fraction of a step left in the accumulator, so the simulation can tick at a low fixed rate
+	// without motion stuttering at higher refresh rates.
+	//
+	// Stored SoA so that interpolate() is a single streaming pass over flat float arrays. Slots are
+	// indexed the same way as the ObjectPool (ObjectHandle::index), unused slots just get lerped along
+	// with everything else.
+	class TransformState
+	{
+	public:
+		TransformState();
+
+		// Makes sure slots [0, n) exist, new slots start at the origin.
+		void resize(size_t n);
+		size_t size() const { return size_; }
+
+		// Places an object without interpolating from its old position, e.g. on spawn or teleport.
+		// Grows the arrays if 'index' is past the end, so every slot the ObjectPool hands out is
+		// covered once it has been reset.
+		void reset(uint32_t index, float x, float y);
+		void translate(uint32_t index, float dx, float dy) { cur_x_[index] += dx; cur_y_[index] += dy; }
+		float x(uint32_t index) const { return cur_x_[index]; }
+		float y(uint32_t index) const { return cur_y_[index]; }
+
+		// Call at the start of every fixed step, before integrating, current becomes previous.
+		void beginStep();
+
+		// Computes previous + (current - previous) * alpha for every slot.
+		void interpolate(float alpha) { interpolate(alpha, 0, size_); }
+		// The same for slots [first, last) only, so the work can be split between threads. 'first'
+		// must be a multiple of four, 'last' is rounded up to one.
+		void interpolate(float alpha, size_t first, size_t last);
+		float renderX(uint32_t index) const { return out_x_[index]; }
+		float renderY(uint32_t index) const { return out_y_[index]; }
+	private:
+		size_t size_;
+		// Padded up to a multiple of four floats so the vector loop never needs a scalar tail.
+		std::vector<float> prev_x_;
+		std::vector<float> prev_y_;
+		std::vector<float> cur_x_;
+		std::vector<float> cur_y_;
+		std::vector<float> out_x_;
+		std::vector<float> out_y_;
+	};
+}
@@ -0,0 +1,74 @@
+/*
+	Copyright 2017 Kristina Simpson<sweet.kristas@gmail.com>
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the "Software"),
+	to deal in the Software without restriction, including without
+	limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to
+	whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included
+		in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer/single consumer triple buffer. The producer always has a buffer
+// to write into and the consumer always has the most recently completed one to read, neither
+// side ever waits on the other. The third buffer sits in the middle and is swapped with
+// whichever side hands over next; a flag bit records whether it holds data the consumer
+// hasn't seen yet.
+//
+// Buffers are recycled, so the producer gets back whatever was in a buffer two publishes ago
+// and must overwrite all of it.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : buffers_(), middle_(1), back_(0), front_(2) {}
+
+	// Producer side.
+	T& back() { return buffers_[back_]; }
+	// Makes back() visible to the consumer. Returns true if this replaced a buffer that the
+	// consumer never picked up, i.e. a frame was dropped.
+	bool publish() {
+		const uint8_t prev = middle_.exchange(static_cast<uint8_t>(back_ | new_bit), std::memory_order_acq_rel);
+		back_ = prev & index_mask;
+		return (prev & new_bit) != 0;
+	}
+
+	// Consumer side.
+	T& front() { return buffers_[front_]; }
+	// Swaps in the latest published buffer, returns false (leaving front() alone) if nothing new
+	// has been published since the last call.
+	bool acquire() {
+		if((middle_.load(std::memory_order_acquire) & new_bit) == 0) {
+			return false;
+		}
+		const uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+		front_ = prev & index_mask;
+		return true;
+	}
+private:
+	static const uint8_t index_mask = 0x03;
+	static const uint8_t new_bit = 0x04;
+
+	T buffers_[3];
+	std::atomic<uint8_t> middle_;
+	uint8_t back_;			// only touched by the producer
+	uint8_t front_;			// only touched by the consumer
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+};